@@ -2,7 +2,12 @@
 #define ALUMINUM_HPP
 
 #include "SeedGridFCC.hpp"
+#include <algorithm>
+#include <array>
+#include <memory>
 #include <openpfc/openpfc.hpp>
+#include <type_traits>
+#include <variant>
 
 using namespace pfc;
 using namespace pfc::ui;
@@ -14,10 +19,42 @@ using namespace pfc::ui;
 class Aluminum : public Model {
 
 private:
-  std::vector<double> filterMF, opL, opN, opEps, P_F;
-  std::vector<double> psiMF, psi, psiN, P_star_psi, temperature, stress;
-  std::vector<std::complex<double>> psiMF_F, psi_F, psiN_F, P_psi_F, temperature_F, stress_F;
-  size_t mem_allocated = 0;
+  // Spectral operators, grouped by the loop they are used in: the mean-field
+  // filter and the kernel P, and the linear and nonlinear factors of the
+  // exponential integrator. Stored in float with operators_single_precision,
+  // or with one value per shell of k^2 with radial_operators.
+  template <typename T> struct Operators {
+    OperatorTable<T, 2> filterMF_P;
+    OperatorTable<T, 2> opLN;
+    void register_memory(MemoryRegistry &registry) const {
+      registry.set("operators", "filterMF/P", filterMF_P.memory_size());
+      registry.set("operators", "opL/opN", opLN.memory_size());
+    }
+  };
+  struct RadialOperators {
+    std::shared_ptr<const RadialShells> shells;
+    RadialOperatorTable<double, 2> filterMF_P;
+    RadialOperatorTable<double, 2> opLN;
+    void register_memory(MemoryRegistry &registry) const {
+      registry.set("operators", "k^2 shells", shells->memory_size());
+      registry.set("operators", "filterMF/P", filterMF_P.memory_size());
+      registry.set("operators", "opL/opN", opLN.memory_size());
+    }
+  };
+  using OperatorSet = std::variant<Operators<double>, Operators<float>, RadialOperators>;
+  OperatorSet m_operators;
+  // operators of other time steps, with adaptive time stepping
+  OperatorCache<OperatorSet> m_operator_cache;
+  std::shared_ptr<const RadialShells> m_shells;
+  RealField psiMF, psi, psiN, P_star_psi, temperature, stress;
+  ComplexField psi_F, temperature_F, stress_F;
+  // Stages of step. The temporaries psiMF_P_F and psiN_F are work arrays
+  // declared with their lifetimes in these stages, and arrays which are not
+  // used at the same time share memory, see Model::add_complex_work_array.
+  // psiMF_P_F holds the spectra of the mean-field density and the kernel
+  // convolution P * psi packed one after another, so that the batch to psiMF
+  // and P_star_psi is transformed without copying the spectra.
+  enum Stage { MEANFIELD = 1, NONLINEAR, UPDATE };
   bool m_first = true;
 
 public:
@@ -58,6 +95,17 @@ public:
     double q20, q21, q30, q31, q40;
     double q20_bar, q21_bar, q30_bar, q31_bar, q40_bar, q2_bar, q3_bar, q4_bar;
     double q2_bar_L;
+    // Store the spectral operators in single precision. They are applied in
+    // double precision, but their values are rounded to float, which halves
+    // the memory of the operators and their traffic in the spectral update.
+    bool operators_single_precision = false;
+    // All operators depend on k^2 only. Store one value per distinct k^2
+    // instead of per mode, which leaves only a 4 byte shell index per mode.
+    // Takes precedence over operators_single_precision.
+    bool radial_operators = false;
+    // Number of operator sets of other time steps kept with adaptive time
+    // stepping, each takes as much memory as the operators themselves.
+    int operator_cache_size = 4;
   } params;
 
   // setters
@@ -103,17 +151,34 @@ public:
   void set_q4_bar(double q4_bar) { params.q4_bar = q4_bar; }
   void set_q2_bar_L(double q2_bar_L) { params.q2_bar_L = q2_bar_L; }
 
+  void allocate_operators() {
+    auto size_outbox = get_fft().size_outbox();
+
+    // operators are only half size due to the symmetry of fourier space
+    if (params.radial_operators) {
+      // the shells do not depend on dt, all operator sets share them
+      if (!m_shells) m_shells = std::make_shared<const RadialShells>(get_decomposition());
+      auto &ops = m_operators.emplace<RadialOperators>();
+      ops.shells = m_shells;
+      ops.filterMF_P = RadialOperatorTable<double, 2>(ops.shells);
+      ops.opLN = RadialOperatorTable<double, 2>(ops.shells);
+    } else if (params.operators_single_precision) {
+      auto &ops = m_operators.emplace<Operators<float>>();
+      ops.filterMF_P.resize(size_outbox);
+      ops.opLN.resize(size_outbox);
+    } else {
+      auto &ops = m_operators.emplace<Operators<double>>();
+      ops.filterMF_P.resize(size_outbox);
+      ops.opLN.resize(size_outbox);
+    }
+  }
+
   void allocate() {
     FFT &fft = get_fft();
     auto size_inbox = fft.size_inbox();
     auto size_outbox = fft.size_outbox();
 
-    // operators are only half size due to the symmetry of fourier space
-    filterMF.resize(size_outbox);
-    opL.resize(size_outbox);
-    opN.resize(size_outbox);
-    opEps.resize(size_outbox);
-    P_F.resize(size_outbox);
+    allocate_operators();
 
     // psi, psiMF, psiN
     psi.resize(size_inbox);
@@ -123,11 +188,10 @@ public:
     temperature.resize(size_inbox);
     stress.resize(size_inbox);
 
-    // psi_F, psiMF_F, psiN_F, where suffix F means in fourier space
+    // psi_F, psiMF_P_F, psiN_F, where suffix F means in fourier space
     psi_F.resize(size_outbox);
-    psiMF_F.resize(size_outbox);
-    psiN_F.resize(size_outbox);
-    P_psi_F.resize(size_outbox);
+    add_complex_work_array("psiMF_P_F", MEANFIELD, MEANFIELD, 2);
+    add_complex_work_array("psiN_F", UPDATE, UPDATE);
     stress_F.resize(size_outbox);
 
     add_real_field("psi", psi);
@@ -138,98 +202,114 @@ public:
     add_real_field("temperature", temperature);
     add_real_field("stress", stress);
 
-    mem_allocated = 0;
-    mem_allocated += utils::sizeof_vec(filterMF);
-    mem_allocated += utils::sizeof_vec(opL);
-    mem_allocated += utils::sizeof_vec(opN);
-    mem_allocated += utils::sizeof_vec(psi);
-    mem_allocated += utils::sizeof_vec(psiMF);
-    mem_allocated += utils::sizeof_vec(psiN);
-    mem_allocated += utils::sizeof_vec(psi_F);
-    mem_allocated += utils::sizeof_vec(psiMF_F);
-    mem_allocated += utils::sizeof_vec(psiN_F);
-    mem_allocated += utils::sizeof_vec(P_F);
-    mem_allocated += utils::sizeof_vec(P_psi_F);
-    mem_allocated += utils::sizeof_vec(P_star_psi);
-    mem_allocated += utils::sizeof_vec(temperature);
-    mem_allocated += utils::sizeof_vec(stress);
-    mem_allocated += utils::sizeof_vec(stress_F);
+    allocate_work_arrays();
   }
 
-  void prepare_operators(double dt) {
-    World w = get_world();
-    auto dx = w.dx;
-    auto dy = w.dy;
-    auto dz = w.dz;
-    auto Lx = w.Lx;
-    auto Ly = w.Ly;
-    auto Lz = w.Lz;
-
-    const Decomposition &decomp = get_decomposition();
-    std::array<int, 3> low = decomp.outbox.low;
-    std::array<int, 3> high = decomp.outbox.high;
-
-    int idx = 0;
-    const double pi = std::atan(1.0) * 4.0;
-    const double fx = 2.0 * pi / (dx * Lx);
-    const double fy = 2.0 * pi / (dy * Ly);
-    const double fz = 2.0 * pi / (dz * Lz);
-
-    for (int k = low[2]; k <= high[2]; k++) {
-      for (int j = low[1]; j <= high[1]; j++) {
-        for (int i = low[0]; i <= high[0]; i++) {
-
-          // laplacian operator -k^2
-          double ki = (i <= Lx / 2) ? i * fx : (i - Lx) * fx;
-          double kj = (j <= Ly / 2) ? j * fy : (j - Ly) * fy;
-          double kk = (k <= Lz / 2) ? k * fz : (k - Lz) * fz;
-          double kLap = -(ki * ki + kj * kj + kk * kk);
+  void register_memory(MemoryRegistry &registry) const override {
+    Model::register_memory(registry);
+    registry.set("fields", "psi_F", psi_F);
+    registry.set("fields", "stress_F", stress_F);
+    auto register_set = [](const OperatorSet &set, MemoryRegistry &tables) {
+      std::visit([&tables](const auto &ops) { ops.register_memory(tables); }, set);
+    };
+    register_set(m_operators, registry);
+    m_operator_cache.register_memory(registry, register_set, "k^2 shells");
+  }
 
-          // mean-field filtering operator (chi) make a C2 that's quasi-gaussian
-          // on the left, and ken-style on the right
-          double alpha2 = 2.0 * params.alpha * params.alpha;
-          double lambda2 = 2.0 * params.lambda * params.lambda;
-          double fMF = exp(kLap / lambda2);
-          double k = sqrt(-kLap) - 1.0;
-          double k2 = k * k;
+  void prepare_operators(double dt) {
+    std::visit([&](auto &ops) { prepare_operators(ops, dt); }, m_operators);
+  }
 
-          double kp = sqrt(-kLap) - 2.0 / sqrt(3.0);
-          double kp2 = kp * kp;
+  /**
+   * @brief Returns the mean-field filter, the kernel P, opL and opN at a mode
+   * with wavenumber squared kSq, multiplied by scale.
+   */
+  std::array<double, 4> get_operators(double kSq, double dt, double scale) const {
+    // laplacian operator -k^2
+    double kLap = -kSq;
 
-          double g1 = exp(-k2 / alpha2);
-          double gp1 = exp(-kp2 / alpha2);
-          double peak = (g1 > gp1) ? g1 : gp1;
+    // mean-field filtering operator (chi) make a C2 that's quasi-gaussian
+    // on the left, and ken-style on the right
+    double alpha2 = 2.0 * params.alpha * params.alpha;
+    double lambda2 = 2.0 * params.lambda * params.lambda;
+    double fMF = exp(kLap / lambda2);
+    double k = sqrt(-kLap) - 1.0;
+    double k2 = k * k;
 
-          P_F[idx] = params.Bx * exp(-params.tau_const) * peak;
+    double kp = sqrt(-kLap) - 2.0 / sqrt(3.0);
+    double kp2 = kp * kp;
 
-          double opCk = params.stabP + params.p2_bar - P_F[idx] + params.q2_bar_L * fMF;
+    double g1 = exp(-k2 / alpha2);
+    double gp1 = exp(-kp2 / alpha2);
+    double peak = (g1 > gp1) ? g1 : gp1;
 
-          filterMF[idx] = fMF;
-          opL[idx] = exp(kLap * opCk * dt);
-          opN[idx] = (opCk == 0.0) ? kLap * dt : (opL[idx] - 1.0) / opCk;
+    double P = params.Bx * exp(-params.tau_const) * peak;
 
-          double alpha2new = 2.0 * params.alpha * params.alpha / 10.0;
-          double g1new = exp(-k2 / alpha2new);
-          double gp1new = exp(-kp2 / alpha2new);
+    double opCk = params.stabP + params.p2_bar - P + params.q2_bar_L * fMF;
 
-          double peaknew = (g1new > gp1new) ? g1new : gp1new;
+    double L = exp(kLap * opCk * dt);
+    return {scale * fMF, scale * P, scale * L, scale * ((opCk == 0.0) ? kLap * dt : (L - 1.0) / opCk)};
+  }
 
-          opEps[idx] = peaknew;
+  template <typename T> void prepare_operators(Operators<T> &ops, double dt) {
+    // 1 / N if backward transforms are not normalized, see FFT::set_normalize_backward
+    const double scale = get_fft().get_operator_scale();
+    if (std::is_same<T, float>::value) {
+      // opL is close to scale for long wavelengths, store the difference to
+      // keep their slow decay rates accurate in single precision
+      ops.opLN.set_offset(0, scale);
+    }
+    for_each_wavenumber(get_decomposition(), [&](size_t idx, double, double, double, double kSq) {
+      std::array<double, 4> op = get_operators(kSq, dt, scale);
+      ops.filterMF_P.set(idx, op[0], op[1]);
+      ops.opLN.set(idx, op[2], op[3]);
+    });
+  }
 
-          idx += 1;
-        }
-      }
+  void prepare_operators(RadialOperators &ops, double dt) {
+    const double scale = get_fft().get_operator_scale();
+    for (size_t shell = 0; shell < ops.shells->num_shells(); shell++) {
+      std::array<double, 4> op = get_operators(ops.shells->get_k2(shell), dt, scale);
+      ops.filterMF_P.set_shell(shell, op[0], op[1]);
+      ops.opLN.set_shell(shell, op[2], op[3]);
     }
   }
 
   void initialize(double dt) override {
     allocate();
     prepare_operators(dt);
+    m_operator_cache.set_active_dt(dt);
+    m_operator_cache.set_capacity(static_cast<size_t>(std::max(params.operator_cache_size, 0)));
+  }
+
+  /**
+   * @brief Switches the operators to time step dt, from the cache if they
+   * have been calculated before.
+   */
+  void set_dt(double dt) override { switch_operators(dt, false); }
+
+  /**
+   * @brief Calculates the operators of a step shortened to end at a save
+   * time. They are not cached, the operators of the regular time step stay in
+   * the cache.
+   */
+  void set_transient_dt(double dt) override { switch_operators(dt, true); }
+
+  void switch_operators(double dt, bool transient) {
+    m_operator_cache.switch_to(dt, transient, m_operators, [this](double dt) {
+      allocate_operators();
+      prepare_operators(dt);
+    });
   }
 
   void step(double t) override {
+    std::visit([&](const auto &ops) { step(ops, t); }, m_operators);
+  }
 
+  template <typename Ops> void step(const Ops &ops, double t) {
     FFT &fft = get_fft();
+    ComplexField &psiMF_P_F = get_complex_work_array("psiMF_P_F");
+    ComplexField &psiN_F = get_complex_work_array("psiN_F");
     World w = get_world();
     double dx = w.dx;
     double x0 = w.x0;
@@ -238,17 +318,16 @@ public:
     std::array<int, 3> low = decomp.inbox.low;
     std::array<int, 3> high = decomp.inbox.high;
 
-    // Calculate mean-field density n_mf
+    // Calculate mean-field density n_mf and the kernel convolution P * psi.
+    // Both are independent of each other, so they are transformed back to
+    // real space in the same batch.
     fft.forward(psi, psi_F);
-    for (size_t idx = 0, N = psiMF_F.size(); idx < N; idx++) {
-      psiMF_F[idx] = filterMF[idx] * psi_F[idx];
-    }
-    fft.backward(psiMF_F, psiMF);
-
-    for (size_t idx = 0, N = P_psi_F.size(); idx < N; idx++) {
-      P_psi_F[idx] = P_F[idx] * psi_F[idx];
-    }
-    fft.backward(P_psi_F, P_star_psi);
+    const size_t n_F = psi_F.size();
+    parallel_for(n_F, [&](size_t idx) {
+      psiMF_P_F[idx] = ops.filterMF_P.template get<0>(idx) * psi_F[idx];
+      psiMF_P_F[n_F + idx] = ops.filterMF_P.template get<1>(idx) * psi_F[idx];
+    });
+    fft.backward_batch({{psiMF_P_F.data(), n_F}, {psiMF_P_F.data() + n_F, n_F}}, {psiMF, P_star_psi});
 
     double l = Lx * dx;
     // double xpos = fmod(params.m_xpos, l);
@@ -256,46 +335,53 @@ public:
     double steppoint = fmod(params.m_xpos, l);
     double local_FE = 0;
 
-    size_t idx = 0;
+    // Parameters and data pointers are copied to locals, so that the compiler
+    // does not have to reload them after every store, and the loop over x is
+    // an explicitly vectorized kernel (see simd.hpp).
+    const double p2 = params.p2_bar, p3 = params.p3_bar, p4 = params.p4_bar;
+    const double q2 = params.q2_bar, q4 = params.q4_bar, q21 = params.q21_bar;
+    const double q30 = params.q30_bar, q31 = params.q31_bar;
+    const double T0 = params.T0, T_const = params.T_const, stabP = params.stabP;
+    const double x_initial = params.x_initial, V_t = params.V_grid * t, G_grid = params.G_grid;
+    const double *u_ptr = psi.data(), *v_ptr = psiMF.data(), *P_ptr = P_star_psi.data();
+    double *N_ptr = psiN.data(), *T_ptr = temperature.data();
+    const int nx = high[0] - low[0] + 1;
+
+    size_t row = 0;
     for (int k = low[2]; k <= high[2]; k++) {
       for (int j = low[1]; j <= high[1]; j++) {
-        for (int i = low[0]; i <= high[0]; i++) {
-          double x = x0 + i * dx;
-          double dist = x + fullruns - (x > steppoint) * l;
-          double T_var = params.G_grid * (dist - params.x_initial - params.V_grid * t);
-          temperature[idx] = T_var;
-          double q2_bar_N = params.q21_bar * T_var / params.T0;
-          double q3_bar = params.q31_bar * (params.T_const + T_var) / params.T0 + params.q30_bar;
-          double u = psi[idx];
-          double v = psiMF[idx];
-          double kernel_term_N = -(1.0 - exp(-T_var / params.T0)) * P_star_psi[idx];
-          psiN[idx] = params.p3_bar * u * u + params.p4_bar * u * u * u + q2_bar_N * v + q3_bar * v * v +
-                      params.q4_bar * v * v * v - kernel_term_N;
-          local_FE += params.p3_bar * u * u * u / 3. + params.p4_bar * u * u * u * u / 4. + q2_bar_N * u * v / 2. +
-                      q3_bar * u * v * v / 3. + params.q4_bar * u * v * v * v / 4. + -u * kernel_term_N * u / 2. +
-                      -u * P_star_psi[idx] / 2. + params.p2_bar * u * u / 2. + params.q2_bar * u * v / 2.;
-          idx++;
+        PFC_SIMD_REDUCTION(+, local_FE)
+        for (int i = 0; i < nx; i++) {
+          const size_t idx = row + i;
+          double x = x0 + (low[0] + i) * dx;
+          double dist = x + fullruns - (x > steppoint ? l : 0.0);
+          double T_var = G_grid * (dist - x_initial - V_t);
+          T_ptr[idx] = T_var;
+          double q2_bar_N = q21 * T_var / T0;
+          double q3_bar = q31 * (T_const + T_var) / T0 + q30;
+          double u = u_ptr[idx];
+          double v = v_ptr[idx];
+          double kernel_term_N = -(1.0 - simd::exp(-T_var / T0)) * P_ptr[idx];
+          N_ptr[idx] = p3 * u * u + p4 * u * u * u + q2_bar_N * v + q3_bar * v * v + q4 * v * v * v - kernel_term_N -
+                       stabP * u;
+          local_FE += p3 * u * u * u / 3. + p4 * u * u * u * u / 4. + q2_bar_N * u * v / 2. + q3_bar * u * v * v / 3. +
+                      q4 * u * v * v * v / 4. + -u * kernel_term_N * u / 2. + -u * P_ptr[idx] / 2. + p2 * u * u / 2. +
+                      q2 * u * v / 2.;
         }
-      }
-    }
-
-    // Apply stabilization factor if given in parameters
-    if (params.stabP != 0.0) {
-      for (size_t idx = 0, N = psiN.size(); idx < N; idx++) {
-        psiN[idx] = psiN[idx] - params.stabP * psi[idx];
+        row += nx;
       }
     }
 
     // Fourier transform of the nonlinear part of the evolution equation
     fft.forward(psiN, psiN_F);
 
-    // Apply one step of the evolution equation
-    for (size_t idx = 0, N = psi_F.size(); idx < N; idx++) {
-      psi_F[idx] = opL[idx] * psi_F[idx] + opN[idx] * psiN_F[idx];
-    }
-
-    // Inverse Fourier transform result back to real space
-    fft.backward(psi_F, psi);
+    // Apply one step of the evolution equation and inverse Fourier transform
+    // result back to real space
+    fft.backward(
+        psi, [&](size_t idx) {
+          return ops.opLN.template get<0>(idx) * psi_F[idx] + ops.opLN.template get<1>(idx) * psiN_F[idx];
+        },
+        psi_F);
   }
 
 }; // end of class
@@ -439,6 +525,15 @@ void from_json(const json &j, Aluminum &m) {
   p.q2_bar_L = p.q2_bar;
   p.q3_bar = p.q31_bar * p.tau_const + p.q30_bar;
   p.q4_bar = p.q40_bar;
+  if (j.contains("operators_single_precision")) {
+    j.at("operators_single_precision").get_to(p.operators_single_precision);
+  }
+  if (j.contains("radial_operators")) {
+    j.at("radial_operators").get_to(p.radial_operators);
+  }
+  if (j.contains("operator_cache_size")) {
+    j.at("operator_cache_size").get_to(p.operator_cache_size);
+  }
 }
 
 #endif // ALUMINUM_HPP
@@ -1,8 +1,14 @@
+#include <openpfc/ensemble.hpp>
 #include <openpfc/openpfc.hpp>
 #include <openpfc/ui.hpp>
 #include <openpfc/utils/nancheck.hpp>
 
+#include <algorithm>
+#include <array>
+#include <memory>
 #include <nlohmann/json.hpp>
+#include <type_traits>
+#include <variant>
 
 using json = nlohmann::json;
 using namespace pfc;
@@ -14,16 +20,41 @@ class Tungsten : public Model {
   using Model::Model;
 
 private:
-  std::vector<double> filterMF, opL, opN;
-#ifdef MAHTI_HACK
-  // in principle, we can reuse some of the arrays ...
-  std::vector<double> psiMF, psi, &psiN = psiMF;
-  std::vector<std::complex<double>> psiMF_F, psi_F, &psiN_F = psiMF_F;
-#else
-  std::vector<double> psiMF, psi, psiN;
-  std::vector<std::complex<double>> psiMF_F, psi_F, psiN_F;
-#endif
-  size_t mem_allocated = 0;
+  // Spectral operators: the mean-field filter, and the linear and nonlinear
+  // factors of the exponential integrator, which are used in the same loop
+  // and share one table. Stored in float with operators_single_precision, or
+  // with one value per shell of k^2 with radial_operators.
+  template <typename T> struct Operators {
+    OperatorTable<T> filterMF;
+    OperatorTable<T, 2> opLN;
+    void register_memory(MemoryRegistry &registry) const {
+      registry.set("operators", "filterMF", filterMF.memory_size());
+      registry.set("operators", "opL/opN", opLN.memory_size());
+    }
+  };
+  struct RadialOperators {
+    std::shared_ptr<const RadialShells> shells;
+    RadialOperatorTable<double> filterMF;
+    RadialOperatorTable<double, 2> opLN;
+    void register_memory(MemoryRegistry &registry) const {
+      registry.set("operators", "k^2 shells", shells->memory_size());
+      registry.set("operators", "filterMF", filterMF.memory_size());
+      registry.set("operators", "opL/opN", opLN.memory_size());
+    }
+  };
+  using OperatorSet = std::variant<Operators<double>, Operators<float>, RadialOperators>;
+  OperatorSet m_operators;
+  // operators of other time steps, with adaptive time stepping
+  OperatorCache<OperatorSet> m_operator_cache;
+  std::shared_ptr<const RadialShells> m_shells;
+  RealField psiMF, psi;
+  ComplexField psi_F;
+  // Stages of step. The temporaries psiN and psiN_F are work arrays
+  // declared with their lifetimes in these stages, and arrays which are not
+  // used at the same time share memory, see Model::add_real_work_array.
+  enum Stage { MEANFIELD = 1, NONLINEAR, UPDATE };
+  // optional single precision transforms for the mean-field filter
+  std::unique_ptr<FFTf> m_fft_mf;
 
 public:
   /**
@@ -60,155 +91,217 @@ public:
     double p2, p3, p4, p2_bar, p3_bar, p4_bar;
     double q20, q21, q30, q31, q40;
     double q20_bar, q21_bar, q30_bar, q31_bar, q40_bar, q2_bar, q3_bar, q4_bar;
+    // Calculate mean-field density with single precision transforms. The
+    // mean-field is already smoothed by the filter, so the lost precision does
+    // not matter, and the reshapes move half the bytes.
+    bool meanfield_single_precision = false;
+    // Store the spectral operators in single precision. They are applied in
+    // double precision, but their values are rounded to float, which halves
+    // the memory of the operators and their traffic in the spectral update.
+    bool operators_single_precision = false;
+    // All operators depend on k^2 only. Store one value per distinct k^2
+    // instead of per mode, which leaves only a 4 byte shell index per mode.
+    // Takes precedence over operators_single_precision.
+    bool radial_operators = false;
+    // Number of operator sets of other time steps kept with adaptive time
+    // stepping, each takes as much memory as the operators themselves.
+    int operator_cache_size = 4;
   } params;
 
+  void allocate_operators() {
+    auto size_outbox = get_fft().size_outbox();
+
+    // operators are only half size due to the symmetry of fourier space
+    if (params.radial_operators) {
+      // the shells do not depend on dt, all operator sets share them
+      if (!m_shells) m_shells = std::make_shared<const RadialShells>(get_decomposition());
+      auto &ops = m_operators.emplace<RadialOperators>();
+      ops.shells = m_shells;
+      ops.filterMF = RadialOperatorTable<double>(ops.shells);
+      ops.opLN = RadialOperatorTable<double, 2>(ops.shells);
+    } else if (params.operators_single_precision) {
+      auto &ops = m_operators.emplace<Operators<float>>();
+      ops.filterMF.resize(size_outbox);
+      ops.opLN.resize(size_outbox);
+    } else {
+      auto &ops = m_operators.emplace<Operators<double>>();
+      ops.filterMF.resize(size_outbox);
+      ops.opLN.resize(size_outbox);
+    }
+  }
+
   void allocate() {
     FFT &fft = get_fft();
     auto size_inbox = fft.size_inbox();
     auto size_outbox = fft.size_outbox();
 
-    // operators are only half size due to the symmetry of fourier space
-    filterMF.resize(size_outbox);
-    opL.resize(size_outbox);
-    opN.resize(size_outbox);
+    allocate_operators();
 
     // psi, psiMF, psiN
     psi.resize(size_inbox);
     psiMF.resize(size_inbox);
-    psiN.resize(size_inbox);
+    add_real_work_array("psiN", NONLINEAR, UPDATE);
 
-    // psi_F, psiMF_F, psiN_F, where suffix F means in fourier space
+    // psi_F, psiN_F, where suffix F means in fourier space
     psi_F.resize(size_outbox);
-    psiMF_F.resize(size_outbox);
-    psiN_F.resize(size_outbox);
+    add_complex_work_array("psiN_F", MEANFIELD, UPDATE);
 
     add_real_field("psi", psi);
     add_real_field("default", psi); // for backward compatibility
     add_real_field("psiMF", psiMF);
 
-    mem_allocated = 0;
-    mem_allocated += utils::sizeof_vec(filterMF);
-    mem_allocated += utils::sizeof_vec(opL);
-    mem_allocated += utils::sizeof_vec(opN);
-    mem_allocated += utils::sizeof_vec(psi);
-    mem_allocated += utils::sizeof_vec(psiMF);
-    mem_allocated += utils::sizeof_vec(psiN);
-    mem_allocated += utils::sizeof_vec(psi_F);
-    mem_allocated += utils::sizeof_vec(psiMF_F);
-    mem_allocated += utils::sizeof_vec(psiN_F);
+    allocate_work_arrays();
+  }
+
+  void register_memory(MemoryRegistry &registry) const override {
+    Model::register_memory(registry);
+    registry.set("fields", "psi_F", psi_F);
+    auto register_set = [](const OperatorSet &set, MemoryRegistry &tables) {
+      std::visit([&tables](const auto &ops) { ops.register_memory(tables); }, set);
+    };
+    register_set(m_operators, registry);
+    m_operator_cache.register_memory(registry, register_set, "k^2 shells");
   }
 
   void prepare_operators(double dt) {
-    World w = get_world();
-    auto dx = w.dx;
-    auto dy = w.dy;
-    auto dz = w.dz;
-    auto Lx = w.Lx;
-    auto Ly = w.Ly;
-    auto Lz = w.Lz;
-
-    const Decomposition &decomp = get_decomposition();
-    std::array<int, 3> low = decomp.outbox.low;
-    std::array<int, 3> high = decomp.outbox.high;
-
-    int idx = 0;
-    const double pi = std::atan(1.0) * 4.0;
-    const double fx = 2.0 * pi / (dx * Lx);
-    const double fy = 2.0 * pi / (dy * Ly);
-    const double fz = 2.0 * pi / (dz * Lz);
-
-    for (int k = low[2]; k <= high[2]; k++) {
-      for (int j = low[1]; j <= high[1]; j++) {
-        for (int i = low[0]; i <= high[0]; i++) {
-
-          // laplacian operator -k^2
-          double ki = (i <= Lx / 2) ? i * fx : (i - Lx) * fx;
-          double kj = (j <= Ly / 2) ? j * fy : (j - Ly) * fy;
-          double kk = (k <= Lz / 2) ? k * fz : (k - Lz) * fz;
-          double kLap = -(ki * ki + kj * kj + kk * kk);
-
-          // mean-field filtering operator (chi) make a C2 that's quasi-gaussian
-          // on the left, and ken-style on the right
-          double alpha2 = 2.0 * params.alpha * params.alpha;
-          double lambda2 = 2.0 * params.lambda * params.lambda;
-          double fMF = exp(kLap / lambda2);
-          double k = sqrt(-kLap) - 1.0;
-          double k2 = k * k;
-
-          double rTol = -alpha2 * log(params.alpha_farTol) - 1.0;
-          double g1 = 0;
-          if (params.alpha_highOrd == 0) { // gaussian peak
-            g1 = exp(-k2 / alpha2);
-          } else { // quasi-gaussian peak with higher order component to make it
-                   // decay faster towards k=0
-            g1 = exp(-(k2 + rTol * pow(k, params.alpha_highOrd)) / alpha2);
-          }
-
-          // taylor expansion of gaussian peak to order 2
-          double g2 = 1.0 - 1.0 / alpha2 * k2;
-          // splice the two sides of the peak
-          double gf = (k < 0.0) ? g1 : g2;
-          // we separate this out because it is needed in the nonlinear
-          // calculation when T is not constant in space
-          double opPeak = params.Bx * exp(-params.T / params.T0) * gf;
-          // includes the lowest order n_mf term since it is a linear term
-          double opCk = params.stabP + params.p2_bar - opPeak + params.q2_bar * fMF;
-
-          filterMF[idx] = fMF;
-          opL[idx] = exp(kLap * opCk * dt);
-          opN[idx] = (opCk == 0.0) ? kLap * dt : (opL[idx] - 1.0) / opCk;
-          idx += 1;
-        }
-      }
+    std::visit([&](auto &ops) { prepare_operators(ops, dt); }, m_operators);
+  }
+
+  /**
+   * @brief Returns the mean-field filter, opL and opN at a mode with
+   * wavenumber squared kSq, multiplied by scale.
+   */
+  std::array<double, 3> get_operators(double kSq, double dt, double scale) const {
+    // laplacian operator -k^2
+    double kLap = -kSq;
+
+    // mean-field filtering operator (chi) make a C2 that's quasi-gaussian
+    // on the left, and ken-style on the right
+    double alpha2 = 2.0 * params.alpha * params.alpha;
+    double lambda2 = 2.0 * params.lambda * params.lambda;
+    double fMF = exp(kLap / lambda2);
+    double k = sqrt(-kLap) - 1.0;
+    double k2 = k * k;
+
+    double rTol = -alpha2 * log(params.alpha_farTol) - 1.0;
+    double g1 = 0;
+    if (params.alpha_highOrd == 0) { // gaussian peak
+      g1 = exp(-k2 / alpha2);
+    } else { // quasi-gaussian peak with higher order component to make it
+             // decay faster towards k=0
+      g1 = exp(-(k2 + rTol * pow(k, params.alpha_highOrd)) / alpha2);
+    }
+
+    // taylor expansion of gaussian peak to order 2
+    double g2 = 1.0 - 1.0 / alpha2 * k2;
+    // splice the two sides of the peak
+    double gf = (k < 0.0) ? g1 : g2;
+    // we separate this out because it is needed in the nonlinear
+    // calculation when T is not constant in space
+    double opPeak = params.Bx * exp(-params.T / params.T0) * gf;
+    // includes the lowest order n_mf term since it is a linear term
+    double opCk = params.stabP + params.p2_bar - opPeak + params.q2_bar * fMF;
+
+    double L = exp(kLap * opCk * dt);
+    return {scale * fMF, scale * L, scale * ((opCk == 0.0) ? kLap * dt : (L - 1.0) / opCk)};
+  }
+
+  template <typename T> void prepare_operators(Operators<T> &ops, double dt) {
+    // 1 / N if backward transforms are not normalized, see FFT::set_normalize_backward
+    const double scale = get_fft().get_operator_scale();
+    if (std::is_same<T, float>::value) {
+      // opL is close to scale for long wavelengths, store the difference to
+      // keep their slow decay rates accurate in single precision
+      ops.opLN.set_offset(0, scale);
+    }
+    for_each_wavenumber(get_decomposition(), [&](size_t idx, double, double, double, double kSq) {
+      std::array<double, 3> op = get_operators(kSq, dt, scale);
+      ops.filterMF.set(idx, op[0]);
+      ops.opLN.set(idx, op[1], op[2]);
+    });
+
+    CHECK_AND_ABORT_IF_NANS_COMM(ops.opLN.get_data(), get_comm());
+  }
+
+  void prepare_operators(RadialOperators &ops, double dt) {
+    const double scale = get_fft().get_operator_scale();
+    for (size_t shell = 0; shell < ops.shells->num_shells(); shell++) {
+      std::array<double, 3> op = get_operators(ops.shells->get_k2(shell), dt, scale);
+      ops.filterMF.set_shell(shell, op[0]);
+      ops.opLN.set_shell(shell, op[1], op[2]);
     }
 
-    CHECK_AND_ABORT_IF_NANS(opL);
-    CHECK_AND_ABORT_IF_NANS(opN);
+    CHECK_AND_ABORT_IF_NANS_COMM(ops.opLN.get_data(), get_comm());
   }
 
   void initialize(double dt) override {
     allocate();
     prepare_operators(dt);
+    m_operator_cache.set_active_dt(dt);
+    m_operator_cache.set_capacity(static_cast<size_t>(std::max(params.operator_cache_size, 0)));
+    if (params.meanfield_single_precision) {
+      // same backend and options as the primary FFT, and counted in its time and stats
+      m_fft_mf = get_fft().make_companion<float>();
+    }
   }
 
-  void step(double t) override {
+  /**
+   * @brief Switches the operators to time step dt, from the cache if they
+   * have been calculated before.
+   */
+  void set_dt(double dt) override { switch_operators(dt, false); }
+
+  /**
+   * @brief Calculates the operators of a step shortened to end at a save
+   * time. They are not cached, the operators of the regular time step stay in
+   * the cache.
+   */
+  void set_transient_dt(double dt) override { switch_operators(dt, true); }
+
+  void switch_operators(double dt, bool transient) {
+    m_operator_cache.switch_to(dt, transient, m_operators, [this](double dt) {
+      allocate_operators();
+      prepare_operators(dt);
+    });
+  }
 
+  void step(double t) override {
     (void)t; // suppress compiler warning about unused parameter
+    std::visit([&](const auto &ops) { step(ops); }, m_operators);
+  }
 
+  template <typename Ops> void step(const Ops &ops) {
     FFT &fft = get_fft();
+    RealField &psiN = get_real_work_array("psiN");
+    ComplexField &psiN_F = get_complex_work_array("psiN_F");
 
-    // Calculate mean-field density n_mf
+    // Calculate mean-field density n_mf. psiN_F is not used yet and takes the
+    // filtered density, in single precision it goes to a scratch buffer
     fft.forward(psi, psi_F);
-    for (size_t idx = 0, N = psiMF_F.size(); idx < N; idx++) {
-      psiMF_F[idx] = filterMF[idx] * psi_F[idx];
-    }
-    fft.backward(psiMF_F, psiMF);
-
-    // Calculate the nonlinear part of the evolution equation in a real space
-    for (size_t idx = 0, N = psiN.size(); idx < N; idx++) {
-      double u = psi[idx], v = psiMF[idx];
-      double u2 = u * u, u3 = u * u * u, v2 = v * v, v3 = v * v * v;
-      double p3 = params.p3_bar, p4 = params.p4_bar;
-      double q3 = params.q3_bar, q4 = params.q4_bar;
-      psiN[idx] = p3 * u2 + p4 * u3 + q3 * v2 + q4 * v3;
+    auto filter = [&](size_t idx) { return ops.filterMF[idx] * psi_F[idx]; };
+    if (m_fft_mf) {
+      m_fft_mf->backward(psiMF, filter);
+    } else {
+      fft.backward(psiMF, filter, psiN_F);
     }
 
-    // Apply stabilization factor if given in parameters
-    if (params.stabP != 0.0)
-      for (size_t idx = 0, N = psiN.size(); idx < N; idx++) {
-        psiN[idx] = psiN[idx] - params.stabP * psi[idx];
-      }
+    // Calculate the nonlinear part of the evolution equation in a real space,
+    // including the stabilization factor, in one sweep
+    auto u = expr::ref(psi), v = expr::ref(psiMF);
+    double p3 = params.p3_bar, p4 = params.p4_bar;
+    double q3 = params.q3_bar, q4 = params.q4_bar;
+    expr::assign(psiN, p3 * u * u + p4 * u * u * u + q3 * v * v + q4 * v * v * v - params.stabP * u);
 
     // Fourier transform of the nonlinear part of the evolution equation
     fft.forward(psiN, psiN_F);
 
-    // Apply one step of the evolution equation
-    for (size_t idx = 0, N = psi_F.size(); idx < N; idx++) {
-      psi_F[idx] = opL[idx] * psi_F[idx] + opN[idx] * psiN_F[idx];
-    }
-
-    // Inverse Fourier transform result back to real space
-    fft.backward(psi_F, psi);
+    // Apply one step of the evolution equation and inverse Fourier transform
+    // result back to real space
+    fft.backward(
+        psi, [&](size_t idx) {
+          return ops.opLN.template get<0>(idx) * psi_F[idx] + ops.opLN.template get<1>(idx) * psiN_F[idx];
+        },
+        psi_F);
 
     // Check does psi has any NaNs and abort the calculation if NaNs are
     // detected. This macro is enabled with compile option 'NAN_CHECK_ENABLED',
@@ -217,7 +310,7 @@ public:
     // -DCMAKE_BUILD_TYPE=Release, which turns on all the optimizations and
     // disables NaN checks and other debug mode checks which may cause any
     // overhead to the actual simulation.
-    CHECK_AND_ABORT_IF_NANS(psi);
+    CHECK_AND_ABORT_IF_NANS_COMM(psi, get_comm());
   }
 
 }; // end of class
@@ -263,11 +356,23 @@ void from_json(const json &j, Tungsten &m) {
   p.q2_bar = p.q21_bar * p.tau + p.q20_bar;
   p.q3_bar = p.q31_bar * p.tau + p.q30_bar;
   p.q4_bar = p.q40_bar;
+  if (j.contains("meanfield_single_precision")) {
+    j.at("meanfield_single_precision").get_to(p.meanfield_single_precision);
+  }
+  if (j.contains("operators_single_precision")) {
+    j.at("operators_single_precision").get_to(p.operators_single_precision);
+  }
+  if (j.contains("radial_operators")) {
+    j.at("radial_operators").get_to(p.radial_operators);
+  }
+  if (j.contains("operator_cache_size")) {
+    j.at("operator_cache_size").get_to(p.operator_cache_size);
+  }
 }
 
 int main(int argc, char *argv[]) {
   cout << std::fixed;
   cout.precision(3);
-  App<Tungsten> app(argc, argv);
+  Ensemble<Tungsten> app(argc, argv);
   return app.main();
 }
@@ -29,29 +29,13 @@ public:
     add_real_field("concentration", c);
 
     // prepare operators
-    World w = get_world();
-    std::array<int, 3> o_low = decomp.outbox.low;
-    std::array<int, 3> o_high = decomp.outbox.high;
-    size_t idx = 0;
-    double pi = std::atan(1.0) * 4.0;
-    double fx = 2.0 * pi / (w.dx * w.Lx);
-    double fy = 2.0 * pi / (w.dy * w.Ly);
-    double fz = 2.0 * pi / (w.dz * w.Lz);
-    for (int k = o_low[2]; k <= o_high[2]; k++) {
-      for (int j = o_low[1]; j <= o_high[1]; j++) {
-        for (int i = o_low[0]; i <= o_high[0]; i++) {
-          // Laplacian operator -k^2
-          double ki = (i <= w.Lx / 2) ? i * fx : (i - w.Lx) * fx;
-          double kj = (j <= w.Ly / 2) ? j * fy : (j - w.Ly) * fy;
-          double kk = (k <= w.Lz / 2) ? k * fz : (k - w.Lz) * fz;
-          double kLap = -(ki * ki + kj * kj + kk * kk);
-          double L = kLap * (-D - D * gamma * kLap);
-          opL[idx] = std::exp(L * dt);
-          opN[idx] = (L != 0.0) ? (opL[idx] - 1.0) / L * kLap : 0.0;
-          idx++;
-        }
-      }
-    }
+    for_each_wavenumber(decomp, [&](size_t idx, double, double, double, double k2) {
+      // Laplacian operator -k^2
+      double kLap = -k2;
+      double L = kLap * (-D - D * gamma * kLap);
+      opL[idx] = std::exp(L * dt);
+      opN[idx] = (L != 0.0) ? (opL[idx] - 1.0) / L * kLap : 0.0;
+    });
   }
 
   void step(double) override {
@@ -59,8 +43,7 @@ public:
     fft.forward(c, c_F);
     for (auto &elem : c) elem = D * elem * elem * elem;
     fft.forward(c, c_NF);
-    for (size_t i = 0; i < c_F.size(); i++) c_F[i] = opL[i] * c_F[i] + opN[i] * c_NF[i];
-    fft.backward(c_F, c);
+    fft.backward(c, [&](size_t i) { return opL[i] * c_F[i] + opN[i] * c_NF[i]; }, c_F);
   }
 };
 
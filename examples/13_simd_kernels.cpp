@@ -0,0 +1,151 @@
+#include <openpfc/field_expression.hpp>
+#include <openpfc/parallel.hpp>
+#include <openpfc/simd.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+/*
+Microbenchmark of the pointwise nonlinear kernels of the tungsten and aluminum
+models: the previous scalar loops against the vectorized versions (expression
+templates for tungsten, PFC_SIMD_REDUCTION and simd::exp for aluminum). Run
+with the grid size as argument, e.g. `./13_simd_kernels 128`. Build with
+OpenPFC_ENABLE_OPENMP_SIMD=ON (the default) to get the SIMD directives.
+*/
+
+using namespace pfc;
+
+struct Params {
+  double p2 = -0.1, p3 = -0.5, p4 = 0.3, q2 = 0.05, q4 = 0.1, q21 = 0.02, q30 = -0.3, q31 = 0.01;
+  double T0 = 1000.0, T_const = 800.0, stabP = 0.2, G_grid = 5.0, x_initial = 10.0, V_grid = 0.1;
+};
+
+// tungsten: nonlinear term and stabilization in two passes, as before
+void tungsten_scalar(const Params &p, const std::vector<double> &psi, const std::vector<double> &psiMF,
+                     std::vector<double> &psiN) {
+  parallel_for(psiN.size(), [&](size_t idx) {
+    double u = psi[idx], v = psiMF[idx];
+    psiN[idx] = p.p3 * u * u + p.p4 * u * u * u + p.q2 * v * v + p.q4 * v * v * v;
+  });
+  parallel_for(psiN.size(), [&](size_t idx) { psiN[idx] = psiN[idx] - p.stabP * psi[idx]; });
+}
+
+void tungsten_simd(const Params &p, const std::vector<double> &psi, const std::vector<double> &psiMF,
+                   std::vector<double> &psiN) {
+  auto u = expr::ref(psi), v = expr::ref(psiMF);
+  expr::assign(psiN, p.p3 * u * u + p.p4 * u * u * u + p.q2 * v * v + p.q4 * v * v * v - p.stabP * u);
+}
+
+// aluminum: temperature dependent nonlinear term and free energy, as before
+double aluminum_scalar(const Params &p, int n, double t, const std::vector<double> &psi,
+                       const std::vector<double> &psiMF, const std::vector<double> &P, std::vector<double> &T,
+                       std::vector<double> &psiN) {
+  double l = n, x0 = 0.0, dx = 1.0, fullruns = 0.0, steppoint = 0.5 * n;
+  double FE = 0.0;
+  size_t idx = 0;
+  for (int k = 0; k < n; k++) {
+    for (int j = 0; j < n; j++) {
+      for (int i = 0; i < n; i++) {
+        double x = x0 + i * dx;
+        double dist = x + fullruns - (x > steppoint) * l;
+        double T_var = p.G_grid * (dist - p.x_initial - p.V_grid * t);
+        T[idx] = T_var;
+        double q2_bar_N = p.q21 * T_var / p.T0;
+        double q3_bar = p.q31 * (p.T_const + T_var) / p.T0 + p.q30;
+        double u = psi[idx], v = psiMF[idx];
+        double kernel_term_N = -(1.0 - std::exp(-T_var / p.T0)) * P[idx];
+        psiN[idx] = p.p3 * u * u + p.p4 * u * u * u + q2_bar_N * v + q3_bar * v * v + p.q4 * v * v * v - kernel_term_N;
+        FE += p.p3 * u * u * u / 3. + p.p4 * u * u * u * u / 4. + q2_bar_N * u * v / 2. + q3_bar * u * v * v / 3. +
+              p.q4 * u * v * v * v / 4. + -u * kernel_term_N * u / 2. + -u * P[idx] / 2. + p.p2 * u * u / 2. +
+              p.q2 * u * v / 2.;
+        idx++;
+      }
+    }
+  }
+  parallel_for(psiN.size(), [&](size_t idx) { psiN[idx] = psiN[idx] - p.stabP * psi[idx]; });
+  return FE;
+}
+
+double aluminum_simd(const Params &p, int n, double t, const std::vector<double> &psi,
+                     const std::vector<double> &psiMF, const std::vector<double> &P, std::vector<double> &T,
+                     std::vector<double> &psiN) {
+  double l = n, x0 = 0.0, dx = 1.0, fullruns = 0.0, steppoint = 0.5 * n;
+  const double p2 = p.p2, p3 = p.p3, p4 = p.p4, q2 = p.q2, q4 = p.q4, q21 = p.q21, q30 = p.q30, q31 = p.q31;
+  const double T0 = p.T0, T_const = p.T_const, stabP = p.stabP;
+  const double x_initial = p.x_initial, V_t = p.V_grid * t, G_grid = p.G_grid;
+  const double *u_ptr = psi.data(), *v_ptr = psiMF.data(), *P_ptr = P.data();
+  double *N_ptr = psiN.data(), *T_ptr = T.data();
+  double FE = 0.0;
+  size_t row = 0;
+  for (int k = 0; k < n; k++) {
+    for (int j = 0; j < n; j++) {
+      PFC_SIMD_REDUCTION(+, FE)
+      for (int i = 0; i < n; i++) {
+        const size_t idx = row + i;
+        double x = x0 + i * dx;
+        double dist = x + fullruns - (x > steppoint ? l : 0.0);
+        double T_var = G_grid * (dist - x_initial - V_t);
+        T_ptr[idx] = T_var;
+        double q2_bar_N = q21 * T_var / T0;
+        double q3_bar = q31 * (T_const + T_var) / T0 + q30;
+        double u = u_ptr[idx], v = v_ptr[idx];
+        double kernel_term_N = -(1.0 - simd::exp(-T_var / T0)) * P_ptr[idx];
+        N_ptr[idx] =
+            p3 * u * u + p4 * u * u * u + q2_bar_N * v + q3_bar * v * v + q4 * v * v * v - kernel_term_N - stabP * u;
+        FE += p3 * u * u * u / 3. + p4 * u * u * u * u / 4. + q2_bar_N * u * v / 2. + q3_bar * u * v * v / 3. +
+              q4 * u * v * v * v / 4. + -u * kernel_term_N * u / 2. + -u * P_ptr[idx] / 2. + p2 * u * u / 2. +
+              q2 * u * v / 2.;
+      }
+      row += n;
+    }
+  }
+  return FE;
+}
+
+template <typename Func> double best_time(int repetitions, Func &&func) {
+  double best = 1e300;
+  for (int r = 0; r < repetitions; r++) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  }
+  return best;
+}
+
+double max_difference(const std::vector<double> &a, const std::vector<double> &b) {
+  double diff = 0.0;
+  for (size_t i = 0; i < a.size(); i++) diff = std::max(diff, std::abs(a[i] - b[i]));
+  return diff;
+}
+
+int main(int argc, char *argv[]) {
+  const int n = (argc > 1) ? std::atoi(argv[1]) : 128;
+  const size_t size = static_cast<size_t>(n) * n * n;
+  const int repetitions = 10;
+  Params p;
+  std::vector<double> psi(size), psiMF(size), P(size), T1(size), T2(size), N1(size), N2(size);
+  for (size_t i = 0; i < size; i++) {
+    psi[i] = 0.5 * std::sin(0.01 * i);
+    psiMF[i] = 0.1 * std::cos(0.02 * i);
+    P[i] = 0.05 * std::sin(0.03 * i);
+  }
+
+  std::cout << "Grid " << n << "^3, SIMD directives " << (simd::is_enabled() ? "enabled" : "disabled")
+            << ", best of " << repetitions << " runs" << std::endl;
+
+  double t_scalar = best_time(repetitions, [&] { tungsten_scalar(p, psi, psiMF, N1); });
+  double t_simd = best_time(repetitions, [&] { tungsten_simd(p, psi, psiMF, N2); });
+  std::cout << "Tungsten nonlinear term: " << t_scalar << " s -> " << t_simd << " s, speedup " << t_scalar / t_simd
+            << ", max difference " << max_difference(N1, N2) << std::endl;
+
+  double FE1 = 0.0, FE2 = 0.0;
+  t_scalar = best_time(repetitions, [&] { FE1 = aluminum_scalar(p, n, 1.0, psi, psiMF, P, T1, N1); });
+  t_simd = best_time(repetitions, [&] { FE2 = aluminum_simd(p, n, 1.0, psi, psiMF, P, T2, N2); });
+  std::cout << "Aluminum nonlinear term: " << t_scalar << " s -> " << t_simd << " s, speedup " << t_scalar / t_simd
+            << ", max difference " << max_difference(N1, N2) << ", free energy " << FE1 << " / " << FE2 << std::endl;
+
+  return 0;
+}
@@ -27,8 +27,6 @@ public:
 
     Vec3<int> i_low = decomp.inbox.low;
     Vec3<int> i_high = decomp.inbox.high;
-    Vec3<int> o_low = decomp.outbox.low;
-    Vec3<int> o_high = decomp.outbox.high;
 
     int idx = 0;
     double D = 1.0;
@@ -48,31 +46,13 @@ public:
       }
     }
 
-    idx = 0;
-    const double pi = std::atan(1.0) * 4.0;
-    const double fx = 2.0 * pi / (w.dx * w.Lx);
-    const double fy = 2.0 * pi / (w.dy * w.Ly);
-    const double fz = 2.0 * pi / (w.dz * w.Lz);
-    for (int k = o_low[2]; k <= o_high[2]; k++) {
-      for (int j = o_low[1]; j <= o_high[1]; j++) {
-        for (int i = o_low[0]; i <= o_high[0]; i++) {
-          const double ki = (i <= w.Lx / 2) ? i * fx : (i - w.Lx) * fx;
-          const double kj = (j <= w.Ly / 2) ? j * fy : (j - w.Ly) * fy;
-          const double kk = (k <= w.Lz / 2) ? k * fz : (k - w.Lz) * fz;
-          const double kLap = -(ki * ki + kj * kj + kk * kk);
-          opL[idx++] = 1.0 / (1.0 - dt * kLap);
-        }
-      }
-    }
+    fill_operator(opL, [&](double, double, double, double k2) { return 1.0 / (1.0 + dt * k2); });
   }
 
   void step(double) override {
     FFT &fft = get_fft();
     fft.forward(psi, psi_F);
-    for (int k = 0, N = psi_F.size(); k < N; k++) {
-      psi_F[k] = opL[k] * psi_F[k];
-    }
-    fft.backward(psi_F, psi);
+    fft.backward(psi, [&](size_t k) { return opL[k] * psi_F[k]; }, psi_F);
   }
 
   Field &get_field() override { return psi; }
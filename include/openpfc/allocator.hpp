@@ -0,0 +1,186 @@
+#ifndef PFC_ALLOCATOR_HPP
+#define PFC_ALLOCATOR_HPP
+
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace pfc {
+
+/**
+ * @brief Memory settings of the field allocator, see FieldAllocator.
+ */
+namespace memory {
+
+/**
+ * @brief Alignment of all field data, one cache line and a full AVX-512
+ * vector.
+ */
+constexpr size_t alignment = 64;
+
+/**
+ * @brief Size of a transparent huge page. Allocations of at least this size
+ * are aligned to it, so that they can be backed by huge pages.
+ */
+constexpr size_t huge_page_size = 2 * 1024 * 1024;
+
+/**
+ * @brief Size of a normal page, the granularity of first touch placement.
+ */
+constexpr size_t page_size = 4096;
+
+namespace detail {
+struct Settings {
+  bool huge_pages = false;
+  bool first_touch = true;
+};
+
+inline Settings &settings() {
+  static Settings s;
+  return s;
+}
+
+struct Counters {
+  std::atomic<size_t> allocated{0};
+  std::atomic<size_t> peak{0};
+};
+
+inline Counters &counters() {
+  static Counters c;
+  return c;
+}
+
+inline void count_allocation(size_t bytes) {
+  Counters &c = counters();
+  const size_t allocated = c.allocated.fetch_add(bytes) + bytes;
+  size_t peak = c.peak.load();
+  while (allocated > peak && !c.peak.compare_exchange_weak(peak, allocated)) {
+  }
+}
+
+inline void count_deallocation(size_t bytes) { counters().allocated.fetch_sub(bytes); }
+} // namespace detail
+
+/**
+ * @brief Requests transparent huge pages (madvise MADV_HUGEPAGE) for field
+ * allocations of at least huge_page_size. Reduces TLB misses in the sweeps
+ * over large fields. Off by default, and only available on Linux.
+ */
+inline void set_huge_pages(bool enabled) { detail::settings().huge_pages = enabled; }
+
+inline bool get_huge_pages() { return detail::settings().huge_pages; }
+
+/**
+ * @brief Touches the pages of new field memory with parallel_for(), so that
+ * every page is placed on the NUMA node of the thread which processes it in
+ * the pointwise loops. On by default.
+ */
+inline void set_first_touch(bool enabled) { detail::settings().first_touch = enabled; }
+
+inline bool get_first_touch() { return detail::settings().first_touch; }
+
+/**
+ * @brief Returns the bytes currently allocated with FieldAllocator on this
+ * process.
+ */
+inline size_t get_allocated_bytes() { return detail::counters().allocated.load(); }
+
+/**
+ * @brief Returns the largest number of bytes allocated with FieldAllocator at
+ * the same time on this process.
+ */
+inline size_t get_peak_allocated_bytes() { return detail::counters().peak.load(); }
+
+/**
+ * @brief Returns the alignment of an allocation of the given size.
+ */
+constexpr size_t get_alignment(size_t bytes) { return bytes >= huge_page_size ? huge_page_size : alignment; }
+
+} // namespace memory
+
+/**
+ * @brief Allocator of field data: aligned, optionally backed by transparent
+ * huge pages and initialized in parallel.
+ *
+ * Memory is aligned to memory::alignment (64 bytes), and allocations of at
+ * least 2 MiB to 2 MiB, so the vectorized loops do not straddle cache lines
+ * and the fields can be backed by huge pages, see memory::set_huge_pages().
+ *
+ * With the default allocator, a field is first touched when it is
+ * value-initialized in resize(), by the single thread calling it, so on a
+ * multi-socket node all of its pages end up on one NUMA node. Here, one
+ * byte of every page of new memory is first written with parallel_for(),
+ * which partitions the pages between threads in the same way as the pointwise
+ * loops of the models partition the elements, see memory::set_first_touch().
+ * The element-wise initialization of std::vector runs after that, but the
+ * pages are already placed, and the data itself is written only once.
+ *
+ * The allocator is stateless and all instances compare equal, so containers
+ * with it can be moved and swapped freely. The bytes allocated with it are
+ * counted, see memory::get_allocated_bytes().
+ *
+ * @tparam T Element type.
+ */
+template <typename T> class FieldAllocator {
+public:
+  using value_type = T;
+  using propagate_on_container_move_assignment = std::true_type;
+  using is_always_equal = std::true_type;
+
+  FieldAllocator() noexcept = default;
+  template <typename U> FieldAllocator(const FieldAllocator<U> &) noexcept {}
+
+  T *allocate(size_t n) {
+    if (n == 0) return nullptr;
+    if (n > static_cast<size_t>(-1) / sizeof(T)) throw std::bad_array_new_length();
+    const size_t bytes = n * sizeof(T);
+    T *p = static_cast<T *>(::operator new(bytes, std::align_val_t(memory::get_alignment(bytes))));
+    memory::detail::count_allocation(bytes);
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    // only a hint, if the kernel does not support it the memory just stays
+    // on normal pages
+    if (memory::get_huge_pages() && bytes >= memory::huge_page_size) madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+    // writes one byte of every page, the memory is still raw and the
+    // container constructs the elements later
+    if (memory::get_first_touch() && bytes > memory::page_size) {
+      const std::uintptr_t first = reinterpret_cast<std::uintptr_t>(p);
+      const std::uintptr_t base = first / memory::page_size * memory::page_size;
+      const size_t pages = (first + bytes - base + memory::page_size - 1) / memory::page_size;
+      parallel_for(pages, [first, base](size_t page) {
+        *reinterpret_cast<char *>(std::max(first, base + page * memory::page_size)) = 0;
+      });
+    }
+    return p;
+  }
+
+  void deallocate(T *p, size_t n) noexcept {
+    if (p == nullptr) return;
+    memory::detail::count_deallocation(n * sizeof(T));
+    ::operator delete(p, std::align_val_t(memory::get_alignment(n * sizeof(T))));
+  }
+
+  template <typename U> bool operator==(const FieldAllocator<U> &) const noexcept { return true; }
+  template <typename U> bool operator!=(const FieldAllocator<U> &) const noexcept { return false; }
+};
+
+/**
+ * @brief Vector of field data, allocated with FieldAllocator.
+ */
+template <typename T> using FieldVector = std::vector<T, FieldAllocator<T>>;
+
+} // namespace pfc
+
+#endif
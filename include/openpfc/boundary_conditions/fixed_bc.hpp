@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../field_modifier.hpp"
+#include "../parallel.hpp"
 
 namespace pfc {
 
@@ -27,19 +28,15 @@ public:
     Vec3<int> high = decomp.inbox.high;
 
     double xpos = w.Lx * w.dx - xwidth;
-    long int idx = 0;
-    for (int k = low[2]; k <= high[2]; k++) {
-      for (int j = low[1]; j <= high[1]; j++) {
-        for (int i = low[0]; i <= high[0]; i++) {
-          double x = w.x0 + i * w.dx;
-          if (std::abs(x - xpos) < xwidth) {
-            double S = 1.0 / (1.0 + exp(-alpha * (x - xpos)));
-            field[idx] = m_rho_low * S + m_rho_high * (1.0 - S);
-          }
-          idx += 1;
-        }
+    const size_t nx = high[0] - low[0] + 1;
+    // the profile depends on x only, so every point is independent
+    parallel_for(field.size(), [&](size_t idx) {
+      double x = w.x0 + (low[0] + static_cast<int>(idx % nx)) * w.dx;
+      if (std::abs(x - xpos) < xwidth) {
+        double S = 1.0 / (1.0 + exp(-alpha * (x - xpos)));
+        field[idx] = m_rho_low * S + m_rho_high * (1.0 - S);
       }
-    }
+    });
   }
 };
 
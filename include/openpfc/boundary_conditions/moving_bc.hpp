@@ -20,9 +20,6 @@ private:
   double m_disp = 40.0;
   bool m_first = true;
   std::vector<double> xline, global_xline;
-  MPI_Comm comm = MPI_COMM_WORLD;
-  int rank = mpi::get_comm_rank(comm);
-  int size = mpi::get_comm_size(comm);
 
 public:
   MovingBC() = default;
@@ -46,6 +43,8 @@ public:
     const World &w = m.get_world();
     Vec3<int> low = decomp.inbox.low;
     Vec3<int> high = decomp.inbox.high;
+    MPI_Comm comm = m.get_comm();
+    int rank = mpi::get_comm_rank(comm);
 
     auto Lx = w.Lx;
 
@@ -0,0 +1,189 @@
+#ifndef PFC_BUFFER_PLAN_HPP
+#define PFC_BUFFER_PLAN_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace pfc {
+
+/**
+ * @brief Assigns the temporary arrays of a model to a minimal set of buffers,
+ * based on when the arrays are used during a step.
+ *
+ * The step of a model is divided into stages numbered by the model, e.g. 1 =
+ * mean-field filtering, 2 = nonlinear term, 3 = update. Every temporary array
+ * is declared with the first stage where it is written and the last stage
+ * where it is read. Arrays whose lifetimes do not overlap, and which have the
+ * same size, are then placed in the same buffer:
+ *
+ * @code
+ * BufferPlan<std::complex<double>> plan;
+ * plan.declare("psiMF_F", n, 1, 1); // filtered density, only inside stage 1
+ * plan.declare("psiN_F", n, 3, 3);  // nonlinear term, only inside stage 3
+ * plan.allocate();                  // one buffer of n elements
+ * auto &psiMF_F = plan.get("psiMF_F");
+ * @endcode
+ *
+ * Lifetimes are inclusive, so two arrays used in the same stage never share
+ * a buffer. Arrays must not be used outside of their declared lifetime, and
+ * their contents are not preserved from one step to the next. Fields which
+ * are written to results files must stay valid between steps and are not
+ * temporaries.
+ *
+ * @tparam T Element type of the arrays.
+ * @tparam Allocator Allocator of the buffers, e.g. FieldAllocator<T>.
+ */
+template <typename T, typename Allocator = std::allocator<T>> class BufferPlan {
+public:
+  using vector_type = std::vector<T, Allocator>; ///< Type of the buffers.
+
+
+private:
+  struct Array {
+    std::string name;
+    size_t size;
+    int first, last;
+    size_t buffer;
+  };
+
+  std::vector<Array> m_arrays;
+  std::vector<vector_type> m_buffers;
+  bool m_allocated = false;
+
+  const Array &find(const std::string &name) const {
+    for (const Array &array : m_arrays) {
+      if (array.name == name) return array;
+    }
+    throw std::invalid_argument("BufferPlan: array '" + name + "' has not been declared.");
+  }
+
+public:
+  /**
+   * @brief Declares a temporary array.
+   *
+   * @param name Name of the array.
+   * @param size Number of elements.
+   * @param first First stage where the array is used.
+   * @param last Last stage where the array is used.
+   * @throws std::invalid_argument if the name is already declared or first >
+   * last.
+   * @throws std::runtime_error if the buffers have already been allocated.
+   */
+  void declare(const std::string &name, size_t size, int first, int last) {
+    if (m_allocated) {
+      throw std::runtime_error("BufferPlan: cannot declare '" + name + "', buffers have already been allocated.");
+    }
+    if (first > last) {
+      throw std::invalid_argument("BufferPlan: lifetime of '" + name + "' ends before it begins.");
+    }
+    if (has(name)) throw std::invalid_argument("BufferPlan: array '" + name + "' declared twice.");
+    m_arrays.push_back({name, size, first, last, 0});
+  }
+
+  bool has(const std::string &name) const {
+    return std::any_of(m_arrays.begin(), m_arrays.end(), [&name](const Array &a) { return a.name == name; });
+  }
+
+  /**
+   * @brief Assigns the arrays to buffers and allocates the buffers.
+   *
+   * Arrays are assigned in the order of their first stage, each to any buffer
+   * of the same size which is free by then, or to a new buffer. For intervals
+   * this greedy assignment uses the smallest possible number of buffers.
+   */
+  void allocate() {
+    if (m_allocated) return;
+    std::vector<size_t> order(m_arrays.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [this](size_t a, size_t b) { return m_arrays[a].first < m_arrays[b].first; });
+    std::vector<size_t> size; // size of each buffer
+    std::vector<int> busy;    // last stage each buffer is in use
+    for (size_t i : order) {
+      Array &array = m_arrays[i];
+      size_t b = 0;
+      while (b < size.size() && (size[b] != array.size || busy[b] >= array.first)) b++;
+      if (b == size.size()) {
+        size.push_back(array.size);
+        busy.push_back(array.last);
+      } else {
+        busy[b] = std::max(busy[b], array.last);
+      }
+      array.buffer = b;
+    }
+    m_buffers.resize(size.size());
+    for (size_t b = 0; b < size.size(); b++) m_buffers[b].resize(size[b]);
+    m_allocated = true;
+  }
+
+  bool is_allocated() const { return m_allocated; }
+
+  /**
+   * @brief Returns the buffer of an array.
+   *
+   * @throws std::invalid_argument if the array has not been declared.
+   * @throws std::runtime_error if the buffers have not been allocated.
+   */
+  vector_type &get(const std::string &name) {
+    const Array &array = find(name);
+    if (!m_allocated) {
+      throw std::runtime_error("BufferPlan: buffers have not been allocated, cannot get '" + name + "'.");
+    }
+    return m_buffers[array.buffer];
+  }
+
+  /**
+   * @brief Returns the index of the buffer an array is assigned to.
+   */
+  size_t get_buffer_index(const std::string &name) const { return find(name).buffer; }
+
+  size_t num_arrays() const { return m_arrays.size(); }
+
+  size_t num_buffers() const { return m_buffers.size(); }
+
+  /**
+   * @brief Returns the names of the arrays assigned to a buffer, separated by
+   * '/', in the order of declaration.
+   */
+  std::string get_buffer_name(size_t buffer) const {
+    std::string name;
+    for (const Array &array : m_arrays) {
+      if (array.buffer != buffer) continue;
+      if (!name.empty()) name += "/";
+      name += array.name;
+    }
+    return name;
+  }
+
+  /**
+   * @brief Returns the size of a buffer in bytes.
+   */
+  size_t get_buffer_bytes(size_t buffer) const { return m_buffers.at(buffer).size() * sizeof(T); }
+
+  /**
+   * @brief Returns the bytes the arrays would take without aliasing.
+   */
+  size_t get_requested_bytes() const {
+    size_t bytes = 0;
+    for (const Array &array : m_arrays) bytes += array.size * sizeof(T);
+    return bytes;
+  }
+
+  /**
+   * @brief Returns the bytes of the allocated buffers.
+   */
+  size_t get_allocated_bytes() const {
+    size_t bytes = 0;
+    for (const vector_type &buffer : m_buffers) bytes += buffer.size() * sizeof(T);
+    return bytes;
+  }
+};
+
+} // namespace pfc
+
+#endif
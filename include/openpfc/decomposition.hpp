@@ -2,9 +2,15 @@
 #define PFC_DECOMPOSITION_HPP
 
 #include "world.hpp"
+#include <array>
+#include <cmath>
 #include <heffte.h>
 #include <iostream>
+#include <map>
 #include <mpi.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace pfc {
 
@@ -21,9 +27,12 @@ class Decomposition {
 private:
   const World m_world;                                             ///< The World object.
   const int m_rank, m_num_domains;                                 ///< Processor ID and total number of processors.
-  const int Lx_c, Ly_c, Lz_c;                                      ///< Dimensions of the complex domain.
   const heffte::box3d<int> real_indexes, complex_indexes;          ///< Index ranges for real and complex domains.
+  const bool m_slab;                                               ///< Slab decomposition instead of minimum surface.
+  const bool m_user_grid;                                          ///< Processor grid given by the user.
   const std::array<int, 3> proc_grid;                              ///< Processor grid dimensions.
+  const bool m_transposed;                                         ///< Complex space in last-transform layout.
+  const std::array<int, 3> out_grid;                               ///< Processor grid in complex space.
   const std::vector<heffte::box3d<int>> real_boxes, complex_boxes; ///< Local domain boxes.
 
   /**
@@ -48,40 +57,288 @@ private:
     return size;
   }
 
+  /**
+   * @brief Calculate the wavenumbers of the local outbox in each direction.
+   * @param world The World object.
+   * @param box The local outbox.
+   * @return Wavenumbers k = 2 pi n / (d L) for indices low..high of each axis,
+   * with n shifted to negative frequencies above the Nyquist index L / 2.
+   */
+  static std::array<std::vector<double>, 3> make_wavenumbers(const World &world, const heffte::box3d<int> &box) {
+    const double pi = std::atan(1.0) * 4.0;
+    const std::array<int, 3> L = {world.Lx, world.Ly, world.Lz};
+    const std::array<double, 3> d = {world.dx, world.dy, world.dz};
+    std::array<std::vector<double>, 3> wavenumbers;
+    for (int axis = 0; axis < 3; axis++) {
+      const double f = 2.0 * pi / (d[axis] * L[axis]);
+      for (int i = box.low[axis]; i <= box.high[axis]; i++) {
+        wavenumbers[axis].push_back((i <= L[axis] / 2) ? i * f : (i - L[axis]) * f);
+      }
+    }
+    return wavenumbers;
+  }
+
+  /**
+   * @brief Check that the real-to-complex direction is a valid axis.
+   * @param r2c_direction Direction (0, 1 or 2).
+   * @return The given direction.
+   * @throws std::invalid_argument if the direction is not 0, 1 or 2.
+   */
+  static int check_r2c_direction(int r2c_direction) {
+    if (r2c_direction < 0 || r2c_direction > 2) {
+      throw std::invalid_argument("Cannot construct domain decomposition: r2c direction must be 0, 1 or 2, got " +
+                                  std::to_string(r2c_direction));
+    }
+    return r2c_direction;
+  }
+
+  /**
+   * @brief Check that a user-defined processor grid splits the domain into
+   * num_domains non-empty boxes, both in real and in complex space.
+   * @param grid Number of domains in each direction.
+   * @param num_domains Number of domains.
+   * @param box Complex space index box of the whole domain, which is never
+   * larger than the real space box.
+   * @return The given grid.
+   * @throws std::invalid_argument if the grid is not valid.
+   */
+  static std::array<int, 3> check_proc_grid(const std::array<int, 3> &grid, int num_domains,
+                                            const heffte::box3d<int> &box) {
+    const std::string msg = "Cannot construct domain decomposition: processor grid [" + std::to_string(grid[0]) +
+                            ", " + std::to_string(grid[1]) + ", " + std::to_string(grid[2]) + "] ";
+    if (grid[0] * grid[1] * grid[2] != num_domains) {
+      throw std::invalid_argument(msg + "does not match the number of domains " + std::to_string(num_domains));
+    }
+    for (int axis = 0; axis < 3; axis++) {
+      if (grid[axis] < 1 || grid[axis] > box.size[axis]) {
+        throw std::invalid_argument(msg + "leaves empty domains in direction " + std::string(1, 'x' + axis));
+      }
+    }
+    return grid;
+  }
+
+  /**
+   * @brief Count the distinct box shapes of the domains.
+   * @param boxes Local domain boxes.
+   * @return Number of boxes of each shape.
+   */
+  static std::map<std::array<int, 3>, int> count_shapes(const std::vector<heffte::box3d<int>> &boxes) {
+    std::map<std::array<int, 3>, int> shapes;
+    for (const auto &box : boxes) shapes[box.size]++;
+    return shapes;
+  }
+
 public:
   const heffte::box3d<int> inbox, outbox; ///< Local communication boxes.
-  const int r2c_direction = 0;            ///< Real-to-complex symmetry direction.
+  const int r2c_direction;                ///< Real-to-complex symmetry direction.
+
+private:
+  const std::array<std::vector<double>, 3> m_wavenumbers; ///< Wavenumbers of the outbox in each direction.
+
+public:
+  /**
+   * @brief Calculate the processor grid.
+   *
+   * In a slab decomposition the domain is split only in y-direction, so that
+   * both the r2c direction x and the z-direction stay local. For 2D problems
+   * (Lz == 1) this avoids splitting a dimension of size one and leaves only a
+   * single reshape between x and y transforms. If there are more domains than
+   * grid points in y, minimum surface grid is used instead.
+   *
+   * @param box Real space index box of the whole domain.
+   * @param num_domains Number of domains.
+   * @param slab Use slab decomposition.
+   * @return Number of domains in each direction.
+   */
+  static std::array<int, 3> make_proc_grid(const heffte::box3d<int> &box, int num_domains, bool slab) {
+    if (slab && num_domains <= box.size[1]) return {1, num_domains, 1};
+    return heffte::proc_setup_min_surface(box, num_domains);
+  }
+
+  /**
+   * @brief Calculate the processor grid.
+   *
+   * A user-defined grid is used as such after validation. Otherwise, in a
+   * slab decomposition the domain is split only in y-direction, and in other
+   * cases using the minimum surface grid of HeFFTe, see the other overload.
+   *
+   * @param real_box Real space index box of the whole domain.
+   * @param complex_box Complex space index box of the whole domain.
+   * @param num_domains Number of domains.
+   * @param slab Use slab decomposition.
+   * @param grid User-defined grid, or {0, 0, 0} to choose automatically.
+   * @return Number of domains in each direction.
+   */
+  static std::array<int, 3> make_proc_grid(const heffte::box3d<int> &real_box, const heffte::box3d<int> &complex_box,
+                                           int num_domains, bool slab, const std::array<int, 3> &grid) {
+    if (grid == std::array<int, 3>{0, 0, 0}) {
+      // with r2c symmetry in y-direction, the complex domain is shorter in y
+      return make_proc_grid(real_box, num_domains, slab && num_domains <= complex_box.size[1]);
+    }
+    return check_proc_grid(grid, num_domains, complex_box);
+  }
+
+  /**
+   * @brief Get the direction of the last 1D transform.
+   *
+   * The transforms start from the r2c direction, and the last one is the last
+   * other direction with more than one point.
+   *
+   * @param box Index box of the whole domain.
+   * @param r2c_direction Real-to-complex symmetry direction.
+   * @return Direction of the last transform.
+   */
+  static int get_last_direction(const heffte::box3d<int> &box, int r2c_direction) {
+    int last = (r2c_direction == 2) ? 1 : 2;
+    if (box.size[last] == 1) last = 3 - r2c_direction - last;
+    return last;
+  }
+
+  /**
+   * @brief Calculate the processor grid of pencils along a direction.
+   *
+   * The two other directions are split so that the cross-section of the
+   * pencils is as square as possible.
+   *
+   * @param box Index box of the whole domain.
+   * @param num_domains Number of domains.
+   * @param direction Direction of the pencils.
+   * @return Number of domains in each direction, 1 in the pencil direction.
+   * @throws std::invalid_argument if the domain cannot be split into
+   * num_domains pencils.
+   */
+  static std::array<int, 3> make_pencil_grid(const heffte::box3d<int> &box, int num_domains, int direction) {
+    const int a = (direction == 0) ? 1 : 0;
+    const int b = 3 - direction - a;
+    std::array<int, 3> best = {0, 0, 0};
+    double best_surface = 0.0;
+    for (int p = 1; p <= num_domains; p++) {
+      const int q = num_domains / p;
+      if (p * q != num_domains || p > box.size[a] || q > box.size[b]) continue;
+      const double surface = static_cast<double>(box.size[a]) / p + static_cast<double>(box.size[b]) / q;
+      if (best[a] == 0 || surface < best_surface) {
+        best[a] = p;
+        best[b] = q;
+        best[direction] = 1;
+        best_surface = surface;
+      }
+    }
+    if (best[a] == 0) {
+      throw std::invalid_argument("Cannot construct domain decomposition: domain cannot be split into " +
+                                  std::to_string(num_domains) + " pencils in direction " +
+                                  std::string(1, 'x' + direction));
+    }
+    return best;
+  }
+
+  /**
+   * @brief Calculate the processor grid of the transposed complex space.
+   *
+   * The boxes are pencils along the direction of the last 1D transform, see
+   * get_last_direction() and make_pencil_grid(). HeFFTe then leaves the result
+   * of the forward transform in these pencils instead of reshaping it back to
+   * the layout of the real space.
+   *
+   * @param box Complex space index box of the whole domain.
+   * @param num_domains Number of domains.
+   * @param r2c_direction Real-to-complex symmetry direction.
+   * @return Number of domains in each direction.
+   * @throws std::invalid_argument if the domain cannot be split into
+   * num_domains pencils.
+   */
+  static std::array<int, 3> make_transposed_grid(const heffte::box3d<int> &box, int num_domains, int r2c_direction) {
+    return make_pencil_grid(box, num_domains, get_last_direction(box, r2c_direction));
+  }
 
   // clang-format off
   /**
    * @brief Construct a new Decomposition object.
    *
    * @param world Reference to the World object.
-   * @param id The id (rank) of the current process.
-   * @param num_procs The total number of domains.
+   * @param rank The id (rank) of the current process.
+   * @param num_domains The total number of domains.
+   * @param slab Use slab decomposition (split only in y-direction) when the
+   * processor grid is chosen automatically.
+   * @param grid Processor grid, or {0, 0, 0} to choose it automatically.
+   * @param r2c_dir Real-to-complex symmetry direction (0, 1 or 2).
+   * @param transposed Keep the complex space in the pencil layout of the last
+   * 1D transform, see make_transposed_grid().
+   * @throws std::invalid_argument if the grid or the direction is not valid.
    *
    * Numbering ranks starts from 0 (MPI convention). For example, if the domain
    * needs to be decomposed into four parts, thouse would be 0/4, 1/4, 2/4, 3/4
    * and NOT 1/4, 2/4, 3/4, 4/4.
    */
-  Decomposition(const World &world, int rank, int num_domains)
+  Decomposition(const World &world, int rank, int num_domains, bool slab, const std::array<int, 3> &grid, int r2c_dir,
+                bool transposed)
       : m_world(world),
         m_rank(rank < num_domains ? rank : throw std::logic_error("Cannot construct domain decomposition: !(rank < nprocs)")),
         m_num_domains(num_domains),
-        Lx_c(floor(m_world.Lx / 2) + 1),
-        Ly_c(m_world.Ly),
-        Lz_c(m_world.Lz),
         real_indexes(m_world),
-        complex_indexes({0, 0, 0}, {Lx_c - 1, Ly_c - 1, Lz_c - 1}),
-        proc_grid(heffte::proc_setup_min_surface(real_indexes, num_domains)),
+        complex_indexes(real_indexes.r2c(check_r2c_direction(r2c_dir))),
+        m_slab(slab),
+        m_user_grid(grid != std::array<int, 3>{0, 0, 0}),
+        proc_grid(make_proc_grid(real_indexes, complex_indexes, num_domains, slab, grid)),
+        m_transposed(transposed),
+        out_grid(transposed ? make_transposed_grid(complex_indexes, num_domains, r2c_dir) : proc_grid),
         real_boxes(heffte::split_world(real_indexes, proc_grid)),
-        complex_boxes(heffte::split_world(complex_indexes, proc_grid)),
+        complex_boxes(heffte::split_world(complex_indexes, out_grid)),
         inbox(real_boxes[rank]),
-        outbox(complex_boxes[rank]) {
-    assert(real_indexes.r2c(r2c_direction) == complex_indexes);
-  };
+        outbox(complex_boxes[rank]),
+        r2c_direction(r2c_dir),
+        m_wavenumbers(make_wavenumbers(m_world, outbox)) {}
   // clang-format on
 
+  /**
+   * @brief Construct a new Decomposition object with r2c symmetry in
+   * x-direction.
+   *
+   * @param world Reference to the World object.
+   * @param rank The id (rank) of the current process.
+   * @param num_domains The total number of domains.
+   * @param slab Use slab decomposition (split only in y-direction), which is
+   * suitable for 2D and quasi-2D problems.
+   */
+  Decomposition(const World &world, int rank, int num_domains, bool slab)
+      : Decomposition(world, rank, num_domains, slab, {0, 0, 0}, 0, false) {}
+
+  /**
+   * @brief Construct a new Decomposition object with a given processor grid
+   * and r2c direction.
+   *
+   * For very anisotropic domains, a slab or a specific pencil grid, or r2c
+   * symmetry along another axis, may need fewer reshapes than the minimum
+   * surface grid. A grid splitting only in y-direction is treated as a slab
+   * decomposition. As models do only pointwise work in Fourier space, the
+   * complex space can also be kept in the layout of the last transform, which
+   * saves one global reshape in both forward and backward transforms.
+   *
+   * @param world Reference to the World object.
+   * @param rank The id (rank) of the current process.
+   * @param num_domains The total number of domains.
+   * @param grid Processor grid, or {0, 0, 0} to choose it automatically.
+   * @param r2c_dir Real-to-complex symmetry direction (0, 1 or 2).
+   * @param transposed Keep the complex space in the pencil layout of the last
+   * 1D transform.
+   * @throws std::invalid_argument if the grid or the direction is not valid.
+   */
+  Decomposition(const World &world, int rank, int num_domains, const std::array<int, 3> &grid, int r2c_dir = 0,
+                bool transposed = false)
+      : Decomposition(world, rank, num_domains,
+                      grid == std::array<int, 3>{0, 0, 0} ? world.is_2d() : (grid[0] == 1 && grid[2] == 1), grid,
+                      r2c_dir, transposed) {}
+
+  /**
+   * @brief Construct a new Decomposition object. 2D worlds (Lz == 1) use slab
+   * decomposition, others minimum surface decomposition.
+   *
+   * @param world Reference to the World object.
+   * @param rank The id (rank) of the current process.
+   * @param num_domains The total number of domains.
+   */
+  Decomposition(const World &world, int rank, int num_domains)
+      : Decomposition(world, rank, num_domains, world.is_2d()) {}
+
   /**
    * @brief Construct a new Decomposition object using MPI communicator. In this
    * case, the total number of domains equals to the communicator size.
@@ -92,6 +349,33 @@ public:
   Decomposition(const World &world, MPI_Comm comm = MPI_COMM_WORLD)
       : Decomposition(world, get_comm_rank(comm), get_comm_size(comm)) {}
 
+  /**
+   * @brief Construct a new Decomposition object using MPI communicator, with
+   * explicitly selected slab or minimum surface decomposition.
+   *
+   * @param world Reference to the World object.
+   * @param comm The MPI communicator.
+   * @param slab Use slab decomposition (split only in y-direction).
+   */
+  Decomposition(const World &world, MPI_Comm comm, bool slab)
+      : Decomposition(world, get_comm_rank(comm), get_comm_size(comm), slab) {}
+
+  /**
+   * @brief Construct a new Decomposition object using MPI communicator, with a
+   * given processor grid and r2c direction.
+   *
+   * @param world Reference to the World object.
+   * @param comm The MPI communicator.
+   * @param grid Processor grid, or {0, 0, 0} to choose it automatically.
+   * @param r2c_dir Real-to-complex symmetry direction (0, 1 or 2).
+   * @param transposed Keep the complex space in the pencil layout of the last
+   * 1D transform.
+   * @throws std::invalid_argument if the grid or the direction is not valid.
+   */
+  Decomposition(const World &world, MPI_Comm comm, const std::array<int, 3> &grid, int r2c_dir = 0,
+                bool transposed = false)
+      : Decomposition(world, get_comm_rank(comm), get_comm_size(comm), grid, r2c_dir, transposed) {}
+
   /**
    * @brief Get the size of the inbox.
    *
@@ -120,6 +404,19 @@ public:
    */
   const auto &get_outbox_offset() const { return outbox.low; }
 
+  /**
+   * @brief Get the wavenumbers of the local outbox in the given direction.
+   *
+   * The i:th element is the wavenumber of global index outbox.low[axis] + i,
+   * so that e.g. the wavenumber in x-direction of a mode is
+   * get_wavenumbers(0)[i - outbox.low[0]]. The tables are calculated once at
+   * construction.
+   *
+   * @param axis Direction (0, 1 or 2).
+   * @return Wavenumbers in the given direction.
+   */
+  const std::vector<double> &get_wavenumbers(int axis) const { return m_wavenumbers.at(axis); }
+
   /**
    * @brief Get the reference to the World object.
    *
@@ -141,17 +438,78 @@ public:
    */
   int get_num_domains() const { return m_num_domains; }
 
+  /**
+   * @brief Check if the domain is split using slab decomposition.
+   *
+   * @return true if the domain is split only in y-direction.
+   */
+  bool is_slab() const { return m_slab && proc_grid[0] == 1 && proc_grid[2] == 1; }
+
+  /**
+   * @brief Get the processor grid used to split the domain.
+   *
+   * @return Number of sub-domains in each direction.
+   */
+  const std::array<int, 3> &get_proc_grid() const { return proc_grid; }
+
+  /**
+   * @brief Check if the processor grid was given by the user.
+   *
+   * @return true if the grid was not chosen automatically.
+   */
+  bool is_user_grid() const { return m_user_grid; }
+
+  /**
+   * @brief Check if the complex space is kept in the layout of the last
+   * transform instead of the layout of the real space.
+   *
+   * @return true if the outbox is a pencil of the last 1D transform.
+   */
+  bool is_transposed() const { return m_transposed; }
+
+  /**
+   * @brief Get the processor grid used to split the complex space.
+   *
+   * @return Number of sub-domains in each direction, same as get_proc_grid()
+   * unless the complex space is transposed.
+   */
+  const std::array<int, 3> &get_out_proc_grid() const { return out_grid; }
+
+  /**
+   * @brief Print the processor grid, r2c direction and the shapes of the
+   * local boxes, without listing every domain.
+   *
+   * @param os Output stream.
+   */
+  void print_summary(std::ostream &os) const {
+    const auto &r = real_indexes.size;
+    const auto &c = complex_indexes.size;
+    os << "Real-to-complex symmetry is used (r2c direction = " << (char)('x' + r2c_direction) << ")\n";
+    os << "Domain is split into " << m_num_domains << " parts ";
+    os << (m_user_grid ? "(user-defined" : is_slab() ? "(slab" : "(minimum surface") << " processor grid: ["
+       << proc_grid[0] << ", " << proc_grid[1] << ", " << proc_grid[2] << "])\n";
+    if (m_transposed) {
+      os << "Complex space is kept in the layout of the last transform (processor grid: [" << out_grid[0] << ", "
+         << out_grid[1] << ", " << out_grid[2] << "])\n";
+    }
+    os << "Domain in real space: [" << r[0] << ", " << r[1] << ", " << r[2] << "] (" << real_indexes.count()
+       << " indexes)\n";
+    os << "Domain in complex space: [" << c[0] << ", " << c[1] << ", " << c[2] << "] (" << complex_indexes.count()
+       << " indexes)\n";
+    os << "Box shapes in real space:";
+    for (const auto &[shape, count] : count_shapes(real_boxes)) {
+      os << " " << count << " x [" << shape[0] << ", " << shape[1] << ", " << shape[2] << "]";
+    }
+    os << "\nBox shapes in complex space:";
+    for (const auto &[shape, count] : count_shapes(complex_boxes)) {
+      os << " " << count << " x [" << shape[0] << ", " << shape[1] << ", " << shape[2] << "]";
+    }
+    os << "\n";
+  }
+
   friend std::ostream &operator<<(std::ostream &os, const Decomposition &d) {
-    const World &w = d.get_world();
     os << "***** DOMAIN DECOMPOSITION STATUS *****\n";
-    os << "Real-to-complex symmetry is used (r2c direction = " << (char)('x' + d.r2c_direction) << ")\n";
-    os << "Domain is split into " << d.get_num_domains() << " parts ";
-    os << "(minimum surface processor grid: [" << d.proc_grid[0] << ", " << d.proc_grid[1] << ", " << d.proc_grid[2]
-       << "])\n";
-    os << "Domain in real space: [" << w.Lx << ", " << w.Ly << ", " << w.Lz << "] (" << d.real_indexes.count()
-       << " indexes)\n";
-    os << "Domain in complex space: [" << d.Lx_c << ", " << d.Ly_c << ", " << d.Lz_c << "] ("
-       << d.complex_indexes.count() << " indexes)\n";
+    d.print_summary(os);
     for (int i = 0; i < d.get_num_domains(); i++) {
       const auto &in = d.real_boxes[i];
       const auto &out = d.complex_boxes[i];
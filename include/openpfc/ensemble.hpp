@@ -0,0 +1,177 @@
+#pragma once
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "mpi.hpp"
+#include "ui.hpp"
+#include "utils.hpp"
+
+namespace pfc {
+namespace ui {
+
+/**
+ * @brief Runs many independent simulations of the same model in one MPI job.
+ *
+ * The world communicator is split into groups of `ranks_per_member`
+ * processes, and each group runs ensemble members, i.e. variants of the base
+ * settings, with an App of its own on the group communicator. If there are
+ * more members than groups, the groups take members in round-robin order.
+ * This packs small runs, e.g. the points of a parameter sweep, which would not
+ * scale on their own, into one allocation.
+ *
+ * The ensemble is described by key "ensemble" in the settings:
+ *
+ *     "ensemble": {
+ *       "ranks_per_member": 4,
+ *       "log_file": "member_%03d.log",
+ *       "members": [
+ *         {"model": {"params": {"T": 1.0}}, "fields": [{"name": "psi", "data": "T1/psi_%d.bin"}]},
+ *         {"model": {"params": {"T": 2.0}}, "fields": [{"name": "psi", "data": "T2/psi_%d.bin"}]}
+ *       ]
+ *     }
+ *
+ * Each member is a JSON merge patch (RFC 7386) applied to the rest of the
+ * settings, so members only need to give what differs. Members writing
+ * results must write them to different files. `ranks_per_member` defaults to
+ * the number of ranks divided by the number of members. With `log_file`, the
+ * output of each member goes to its own file, numbered by member index.
+ *
+ * Without key "ensemble" the settings are run as a single simulation on all
+ * ranks, exactly like App does, so applications can use Ensemble as their
+ * entry point unconditionally.
+ */
+template <class ConcreteModel> class Ensemble {
+private:
+  MPI_Worker m_worker;
+  json m_settings;
+
+public:
+  Ensemble(int argc, char *argv[])
+      : m_worker(MPI_Worker(argc, argv, MPI_COMM_WORLD)), m_settings(read_settings(argc, argv, MPI_COMM_WORLD)) {}
+
+  Ensemble(const json &settings) : m_worker(MPI_Worker(0, nullptr, MPI_COMM_WORLD)), m_settings(settings) {}
+
+  /**
+   * @brief Returns the settings of each ensemble member: the settings without
+   * key "ensemble", patched with the member.
+   *
+   * @throws std::invalid_argument if "ensemble" has no non-empty array of
+   * objects in "members", or if two members write results to the same file.
+   */
+  static std::vector<json> make_member_settings(const json &settings) {
+    const json &ensemble = settings.at("ensemble");
+    if (!ensemble.contains("members") || !ensemble["members"].is_array() || ensemble["members"].empty()) {
+      throw std::invalid_argument("Invalid 'ensemble': expected a non-empty array 'members'.");
+    }
+    json base = settings;
+    base.erase("ensemble");
+    std::vector<json> members;
+    std::map<std::string, int> outputs;
+    for (const json &patch : ensemble["members"]) {
+      if (!patch.is_object()) {
+        throw std::invalid_argument("Invalid 'ensemble': each member must be an object.");
+      }
+      json member = base;
+      member.merge_patch(patch);
+      if (member.contains("saveat") && member.contains("fields") && member["saveat"] > 0) {
+        for (const json &field : member["fields"]) {
+          const std::string data = field["data"];
+          auto [it, inserted] = outputs.insert({data, members.size()});
+          if (!inserted) {
+            throw std::invalid_argument("Invalid 'ensemble': members " + std::to_string(it->second) + " and " +
+                                        std::to_string(members.size()) + " both write to " + data + ".");
+          }
+        }
+      }
+      members.push_back(member);
+    }
+    return members;
+  }
+
+  /**
+   * @brief Returns the number of ranks in each group, from key
+   * "ranks_per_member" or evenly divided among the members.
+   *
+   * @throws std::invalid_argument if the ranks cannot be divided into groups
+   * of that size.
+   */
+  static int get_ranks_per_member(const json &settings, int num_ranks, int num_members) {
+    const json &ensemble = settings.at("ensemble");
+    int ranks_per_member = std::max(1, num_ranks / num_members);
+    if (ensemble.contains("ranks_per_member")) {
+      if (!ensemble["ranks_per_member"].is_number_integer() || ensemble["ranks_per_member"] < 1) {
+        throw std::invalid_argument("Invalid 'ranks_per_member' in 'ensemble': expected a positive integer.");
+      }
+      ranks_per_member = ensemble["ranks_per_member"];
+    }
+    if (num_ranks % ranks_per_member != 0) {
+      throw std::invalid_argument("Invalid 'ensemble': " + std::to_string(num_ranks) +
+                                  " ranks cannot be divided into groups of " + std::to_string(ranks_per_member) +
+                                  " ranks.");
+    }
+    return ranks_per_member;
+  }
+
+  int main() {
+    if (!m_settings.contains("ensemble")) {
+      App<ConcreteModel> app(m_settings, MPI_COMM_WORLD);
+      return app.main();
+    }
+
+    const std::vector<json> members = make_member_settings(m_settings);
+    const int num_members = members.size();
+    const int num_ranks = m_worker.get_num_ranks();
+    const int ranks_per_member = get_ranks_per_member(m_settings, num_ranks, num_members);
+    const int num_groups = num_ranks / ranks_per_member;
+    const int group = m_worker.get_rank() / ranks_per_member;
+    std::string log_file;
+    if (m_settings["ensemble"].contains("log_file")) log_file = m_settings["ensemble"]["log_file"];
+
+    std::cout << "Ensemble: " << num_members << " members, " << num_groups << " groups of " << ranks_per_member
+              << " ranks" << std::endl;
+
+    MPI_Comm group_comm;
+    MPI_Comm_split(MPI_COMM_WORLD, group, m_worker.get_rank(), &group_comm);
+    int group_rank;
+    MPI_Comm_rank(group_comm, &group_rank);
+    if (group_rank == 0) m_worker.unmute();
+
+    int failed = 0;
+    for (int member = group; member < num_members; member += num_groups) {
+      std::ofstream log;
+      std::streambuf *cout_buf = nullptr;
+      if (!log_file.empty() && group_rank == 0) {
+        log.open(utils::format_with_number(log_file, member));
+        cout_buf = std::cout.rdbuf(log.rdbuf());
+      }
+      std::cout << "Ensemble member " << member << " / " << num_members << " on ranks "
+                << group * ranks_per_member << "-" << (group + 1) * ranks_per_member - 1 << std::endl;
+      try {
+        App<ConcreteModel> app(members[member], group_comm);
+        if (app.main() != 0) failed += 1;
+      } catch (const std::exception &e) {
+        std::cerr << "Ensemble member " << member << " failed: " << e.what() << std::endl;
+        failed += 1;
+      }
+      if (cout_buf) std::cout.rdbuf(cout_buf);
+    }
+
+    if (group_rank == 0 && m_worker.get_rank() != 0) m_worker.mute();
+    MPI_Comm_free(&group_comm);
+    // count each failed member once, on the root of its group
+    int local_failed = (group_rank == 0) ? failed : 0, total_failed;
+    MPI_Allreduce(&local_failed, &total_failed, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    std::cout << "Ensemble done: " << num_members - total_failed << " / " << num_members << " members succeeded"
+              << std::endl;
+    return total_failed == 0 ? 0 : 1;
+  }
+};
+
+} // namespace ui
+} // namespace pfc
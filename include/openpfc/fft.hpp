@@ -1,24 +1,288 @@
 #ifndef PFC_FFT_HPP
 #define PFC_FFT_HPP
 
+#include "allocator.hpp"
 #include "decomposition.hpp"
+#include "fft_backend.hpp"
+#include "memory_registry.hpp"
+#include "parallel.hpp"
+#include "workspace_pool.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <exception>
 #include <heffte.h>
 #include <iostream>
+#include <memory>
 #include <mpi.h>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 namespace pfc {
 
 /**
- * @brief FFT class for performing forward and backward Fast Fourier Transformations.
+ * @brief Cumulative counters of the FFT transformations.
+ *
+ * The split of the transform time into local 1D FFTs and reshapes, and the
+ * bytes sent to other ranks in the reshapes, are measured by the native
+ * backend, which runs the stages itself (phases_measured is true). HeFFTe does
+ * the reshapes and the local transforms inside one call, so with its backends
+ * only the total is measured, and compute_time, reshape_time and
+ * reshape_bytes stay zero. Scaling is done outside the transformations and
+ * measured exactly. For the fused kernel backward, normalization is folded
+ * into the kernel sweep and thus not counted here.
  */
-class FFT {
+struct FFTStats {
+  size_t forward_calls = 0;    /**< Number of forward transformation calls. */
+  size_t backward_calls = 0;   /**< Number of backward transformation calls. */
+  size_t forward_fields = 0;   /**< Number of fields transformed forward (a batch counts each field). */
+  size_t backward_fields = 0;  /**< Number of fields transformed backward. */
+  size_t field_bytes = 0;      /**< Bytes of field data passed in and out of the transformations. */
+  double forward_time = 0.0;   /**< Wall time of forward transformations. */
+  double backward_time = 0.0;  /**< Wall time of backward transformations, without scaling. */
+  double scaling_time = 0.0;   /**< Wall time of normalizing the backward results. */
+  bool phases_measured = true; /**< All transformations measured their phases, see above. */
+  double compute_time = 0.0;   /**< Measured time of local 1D FFTs. */
+  double reshape_time = 0.0;   /**< Measured time of reshapes, including local copies. */
+  size_t reshape_bytes = 0;    /**< Measured bytes sent to other ranks in reshapes. */
 
+  /**
+   * @brief Adds the phase counters of one transformation.
+   */
+  void add_phases(const FFTPhaseCounters &phases) {
+    phases_measured = phases_measured && phases.measured;
+    compute_time += phases.compute_time;
+    reshape_time += phases.reshape_time;
+    reshape_bytes += phases.reshape_bytes;
+  }
+
+  /**
+   * @brief Returns the total measured time.
+   */
+  double total_time() const { return forward_time + backward_time + scaling_time; }
+
+  friend std::ostream &operator<<(std::ostream &os, const FFTStats &s) {
+    os << "forward: " << s.forward_fields << " fields in " << s.forward_calls << " calls, " << s.forward_time
+       << " s; backward: " << s.backward_fields << " fields in " << s.backward_calls << " calls, " << s.backward_time
+       << " s; scaling: " << s.scaling_time << " s; ";
+    if (s.phases_measured) {
+      os << "compute: " << s.compute_time << " s, reshape: " << s.reshape_time << " s, " << s.reshape_bytes
+         << " bytes sent; ";
+    }
+    os << s.field_bytes << " field bytes";
+    return os;
+  }
+};
+
+namespace detail {
+
+/**
+ * @brief Counters of an FFT object, shared with its companions, see
+ * BasicFFT::make_companion().
+ */
+struct FFTCounters {
+  double fft_time = 0.0; /**< Time since the last reset_fft_time(). */
+  FFTStats stats;        /**< Cumulative counters since the last reset_stats(). */
+};
+
+} // namespace detail
+
+/**
+ * @brief Non-owning reference to the data of a vector with any allocator,
+ * used in the field lists of the batched transformations, e.g.
+ * `fft.forward_batch({psi, psiN}, {psi_F, psiN_F})` with any mix of
+ * std::vector and FieldVector.
+ *
+ * @tparam E Element type, const for input fields.
+ */
+template <typename E> class FieldRef {
 private:
-  const Decomposition m_decomposition;                  /**< The Decomposition object. */
-  const heffte::fft3d_r2c<heffte::backend::fftw> m_fft; /**< HeFFTe FFT object. */
-  std::vector<std::complex<double>> m_wrk;              /**< Workspace vector for FFT computations. */
-  double m_fft_time = 0.0;                              /**< Recorded FFT computation time. */
+  E *m_data;
+  size_t m_size;
+
+public:
+  template <typename V, typename = std::enable_if_t<std::is_convertible_v<decltype(std::declval<V &>().data()), E *>>>
+  FieldRef(V &v) : m_data(v.data()), m_size(v.size()) {}
+
+  /// Reference to `size` elements at `data`, e.g. one field of a packed array.
+  FieldRef(E *data, size_t size) : m_data(data), m_size(size) {}
+
+  E *data() const { return m_data; }
+  size_t size() const { return m_size; }
+};
+
+/**
+ * @brief FFT class for performing forward and backward Fast Fourier
+ * Transformations in precision T.
+ *
+ * The transformations are natively done for std::vector<T> and
+ * std::vector<std::complex<T>>, with any allocator, e.g. the fields allocated
+ * with FieldAllocator. Data in other precision is accepted as well, in
+ * which case it is converted to precision T before and back after the
+ * transformation. This makes it possible to keep the state of a model in double
+ * precision while doing selected transforms in single precision, which halves
+ * the bytes moved in every reshape:
+ *
+ * @code
+ * FFT fft(decomp);                 // double precision transforms
+ * BasicFFT<float> fft_sp(decomp);  // single precision transforms
+ * fft_sp.backward(psiMF_F, psiMF); // psiMF_F and psiMF are double
+ * @endcode
+ *
+ * @tparam T Floating point type used in the transformations (float or double).
+ */
+template <typename T> class BasicFFT {
+
+  static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>, "BasicFFT<T>: T must be float or double");
+
+public:
+  using real_type = T;                             /**< Real type of the transformations. */
+  using complex_type = std::complex<T>;            /**< Complex type of the transformations. */
+  using RealVector = std::vector<real_type>;       /**< Real data of precision T. */
+  using ComplexVector = std::vector<complex_type>; /**< Complex data of precision T. */
+
+private:
+  template <typename> friend class BasicFFT;
+
+  const Decomposition m_decomposition;             /**< The Decomposition object. */
+  const MPI_Comm m_comm;                           /**< The MPI communicator. */
+  const heffte::plan_options m_plan_options;       /**< Plan options of the heFFTe backends. */
+  const FFTBackend m_backend;                      /**< Backend of the local transformations. */
+  const TransposeOptions m_transpose_options;      /**< Options of the native backend. */
+  const std::unique_ptr<FFTExecutor<T>> m_fft;     /**< HeFFTe FFT object. */
+  WorkspacePool *m_pool;                           /**< Pool of workspace and other scratch buffers. */
+  bool m_normalize_backward = true;                /**< Scale results of backward transformations by 1 / N. */
+  std::shared_ptr<detail::FFTCounters> m_counters; /**< Recorded time and counters, shared with companions. */
+
+  /**
+   * @brief Forward transformation of a batch of packed fields, with timing.
+   */
+  void transform_forward(size_t batch_size, const real_type *in, complex_type *out) {
+    double t = -MPI_Wtime();
+    auto wrk = m_pool->borrow<complex_type>(batch_size * size_workspace());
+    m_fft->forward(static_cast<int>(batch_size), in, out, wrk.data());
+    t += MPI_Wtime();
+    m_counters->fft_time += t;
+    m_counters->stats.forward_time += t;
+    m_counters->stats.forward_calls += 1;
+    m_counters->stats.forward_fields += batch_size;
+    m_counters->stats.field_bytes +=
+        batch_size * (size_inbox() * sizeof(real_type) + size_outbox() * sizeof(complex_type));
+    m_counters->stats.add_phases(m_fft->take_phase_counters());
+  }
+
+  /**
+   * @brief Backward transformation of a batch of packed fields, with timing.
+   * If normalize is true, the result is scaled by normalization().
+   */
+  void transform_backward(size_t batch_size, const complex_type *in, real_type *out, bool normalize) {
+    double t = -MPI_Wtime();
+    auto wrk = m_pool->borrow<complex_type>(batch_size * size_workspace());
+    m_fft->backward(static_cast<int>(batch_size), in, out, wrk.data(), heffte::scale::none);
+    t += MPI_Wtime();
+    m_counters->fft_time += t;
+    m_counters->stats.backward_time += t;
+    m_counters->stats.backward_calls += 1;
+    m_counters->stats.backward_fields += batch_size;
+    m_counters->stats.field_bytes +=
+        batch_size * (size_inbox() * sizeof(real_type) + size_outbox() * sizeof(complex_type));
+    m_counters->stats.add_phases(m_fft->take_phase_counters());
+    if (normalize) {
+      t = -MPI_Wtime();
+      const T scale = normalization();
+      parallel_for(batch_size * size_inbox(), [out, scale](size_t i) { out[i] *= scale; });
+      t += MPI_Wtime();
+      m_counters->fft_time += t;
+      m_counters->stats.scaling_time += t;
+    }
+  }
+
+  /**
+   * @brief Checks if the fields follow each other in memory, each of n
+   * elements, so that they can be passed to HeFFTe as one batch.
+   */
+  template <typename E> static bool is_packed(const std::vector<FieldRef<E>> &fields, size_t n) {
+    for (size_t b = 1; b < fields.size(); b++) {
+      if (fields[b].data() != fields[0].data() + b * n) return false;
+    }
+    return true;
+  }
+
+  /**
+   * @brief Transforms the fields in sub-batches and runs the callbacks of the
+   * finished fields on a helper thread while the next sub-batch is
+   * transformed.
+   *
+   * One helper thread is started per call. It runs the callbacks in order, as
+   * the transformed fields are handed to it. An exception of a callback stops
+   * the transformations and is rethrown after the helper thread has finished.
+   */
+  template <typename In, typename Out, typename Callback, typename Transform>
+  void pipeline(const std::vector<In> &in, const std::vector<Out> &out, Callback &on_ready, size_t chunk_size,
+                Transform &&transform) {
+    if (chunk_size == 0) throw std::invalid_argument("pipeline: chunk size must be positive.");
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t ready = 0;      // number of transformed fields
+    bool finished = false; // no more fields will be transformed
+    std::exception_ptr error;
+    std::thread helper([&]() {
+      std::unique_lock<std::mutex> lock(mutex);
+      for (size_t i = 0;;) {
+        cv.wait(lock, [&]() { return i < ready || finished; });
+        if (i == ready) return;
+        const size_t last = ready;
+        lock.unlock();
+        try {
+          for (; i < last; i++) on_ready(i);
+        } catch (...) {
+          lock.lock();
+          error = std::current_exception();
+          return;
+        }
+        lock.lock();
+      }
+    });
+    auto finish = [&]() {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+      }
+      cv.notify_one();
+      helper.join();
+    };
+    try {
+      for (size_t first = 0; first < in.size(); first += chunk_size) {
+        const size_t last = std::min(first + chunk_size, in.size());
+        transform(std::vector<In>(in.begin() + first, in.begin() + last),
+                  std::vector<Out>(out.begin() + first, out.begin() + last));
+        std::lock_guard<std::mutex> lock(mutex);
+        if (error) break;
+        ready = last;
+        cv.notify_one();
+      }
+    } catch (...) {
+      finish();
+      throw;
+    }
+    finish();
+    if (error) std::rethrow_exception(error);
+  }
+
+  /**
+   * @brief Adjusts plan options to the decomposition. With slab decomposition
+   * (e.g. 2D problems) the intermediate reshapes are done with slabs as well,
+   * so that a 2D transform needs only one reshape between x and y transforms.
+   */
+  static heffte::plan_options adjust_options(const Decomposition &decomposition, heffte::plan_options options) {
+    if (decomposition.is_slab()) options.use_pencils = false;
+    return options;
+  }
 
 public:
   /**
@@ -27,12 +291,45 @@ public:
    * @param decomposition The Decomposition object defining the domain decomposition.
    * @param comm The MPI communicator for parallel computations (default: MPI_COMM_WORLD).
    * @param plan_options Optional plan options for configuring the FFT behavior (default: HeFFTe default options).
+   * @param backend Backend of the local transformations (default: FFTW).
+   * @param transpose_options Options of the OpenPFC transposes, used with
+   * FFTBackend::native only.
+   * @throws std::invalid_argument if HeFFTe was built without the backend.
    */
-  FFT(const Decomposition &decomposition, MPI_Comm comm = MPI_COMM_WORLD,
-      heffte::plan_options plan_options = heffte::default_options<heffte::backend::fftw>())
-      : m_decomposition(decomposition),
-        m_fft({m_decomposition.inbox, m_decomposition.outbox, m_decomposition.r2c_direction, comm, plan_options}),
-        m_wrk(std::vector<std::complex<double>>(m_fft.size_workspace())){};
+  BasicFFT(const Decomposition &decomposition, MPI_Comm comm = MPI_COMM_WORLD,
+           heffte::plan_options plan_options = heffte::default_options<heffte::backend::fftw>(),
+           FFTBackend backend = FFTBackend::fftw, const TransposeOptions &transpose_options = TransposeOptions())
+      : m_decomposition(decomposition), m_comm(comm), m_plan_options(plan_options), m_backend(backend),
+        m_transpose_options(transpose_options),
+        m_fft(make_fft_executor<T>(backend, m_decomposition.inbox, m_decomposition.outbox,
+                                   m_decomposition.r2c_direction, comm, adjust_options(decomposition, plan_options),
+                                   transpose_options)),
+        m_pool(&WorkspacePool::get_default()), m_counters(std::make_shared<detail::FFTCounters>()){};
+
+  /**
+   * @brief Constructs an FFT object of precision U for the same setup.
+   *
+   * The companion uses the same decomposition, communicator, backend, plan
+   * and transpose options, workspace pool and backward normalization as this
+   * object. Its transformations are added to the time and counters of this
+   * object, see get_fft_time() and get_stats(), so that e.g. the single
+   * precision transforms of a mixed precision model show up in the FFT time
+   * reported for the run:
+   *
+   * @code
+   * std::unique_ptr<FFTf> fft_mf = get_fft().make_companion<float>();
+   * @endcode
+   *
+   * @tparam U Floating point type of the companion.
+   * @return The companion FFT object.
+   */
+  template <typename U> std::unique_ptr<BasicFFT<U>> make_companion() const {
+    auto fft = std::make_unique<BasicFFT<U>>(m_decomposition, m_comm, m_plan_options, m_backend, m_transpose_options);
+    fft->m_pool = m_pool;
+    fft->m_normalize_backward = m_normalize_backward;
+    fft->m_counters = m_counters;
+    return fft;
+  }
 
   /**
    * @brief Performs the forward FFT transformation.
@@ -40,10 +337,37 @@ public:
    * @param in Input vector of real values.
    * @param out Output vector of complex values.
    */
-  void forward(const std::vector<double> &in, std::vector<std::complex<double>> &out) {
-    m_fft_time -= MPI_Wtime();
-    m_fft.forward(in.data(), out.data(), m_wrk.data());
-    m_fft_time += MPI_Wtime();
+  void forward(const RealVector &in, ComplexVector &out) { transform_forward(1, in.data(), out.data()); };
+
+  /**
+   * @brief Performs the forward FFT transformation for vectors with other
+   * allocators, e.g. FieldVector.
+   *
+   * @param in Input vector of real values.
+   * @param out Output vector of complex values.
+   */
+  template <typename AI, typename AO>
+  void forward(const std::vector<real_type, AI> &in, std::vector<complex_type, AO> &out) {
+    transform_forward(1, in.data(), out.data());
+  };
+
+  /**
+   * @brief Performs the forward FFT transformation for data of other
+   * precision than T.
+   *
+   * The data is converted to precision T for the transformation and the result
+   * is converted back to precision U.
+   *
+   * @param in Input vector of real values.
+   * @param out Output vector of complex values.
+   */
+  template <typename U, typename AI, typename AO, std::enable_if_t<!std::is_same_v<U, T>, int> = 0>
+  void forward(const std::vector<U, AI> &in, std::vector<std::complex<U>, AO> &out) {
+    auto real = m_pool->borrow<real_type>(size_inbox());
+    auto complex = m_pool->borrow<complex_type>(size_outbox());
+    std::copy_n(in.data(), size_inbox(), real.data());
+    transform_forward(1, real.data(), complex.data());
+    std::copy_n(complex.data(), size_outbox(), out.data());
   };
 
   /**
@@ -52,23 +376,328 @@ public:
    * @param in Input vector of complex values.
    * @param out Output vector of real values.
    */
-  void backward(const std::vector<std::complex<double>> &in, std::vector<double> &out) {
-    m_fft_time -= MPI_Wtime();
-    m_fft.backward(in.data(), out.data(), m_wrk.data(), heffte::scale::full);
-    m_fft_time += MPI_Wtime();
+  void backward(const ComplexVector &in, RealVector &out) {
+    transform_backward(1, in.data(), out.data(), m_normalize_backward);
+  };
+
+  /**
+   * @brief Performs the backward (inverse) FFT transformation for vectors with
+   * other allocators, e.g. FieldVector.
+   *
+   * @param in Input vector of complex values.
+   * @param out Output vector of real values.
+   */
+  template <typename AI, typename AO>
+  void backward(const std::vector<complex_type, AI> &in, std::vector<real_type, AO> &out) {
+    transform_backward(1, in.data(), out.data(), m_normalize_backward);
+  };
+
+  /**
+   * @brief Performs the backward (inverse) FFT transformation for data of
+   * other precision than T.
+   *
+   * The data is converted to precision T for the transformation and the result
+   * is converted back to precision U.
+   *
+   * @param in Input vector of complex values.
+   * @param out Output vector of real values.
+   */
+  template <typename U, typename AI, typename AO, std::enable_if_t<!std::is_same_v<U, T>, int> = 0>
+  void backward(const std::vector<std::complex<U>, AI> &in, std::vector<U, AO> &out) {
+    auto complex = m_pool->borrow<complex_type>(size_outbox());
+    auto real = m_pool->borrow<real_type>(size_inbox());
+    std::copy_n(in.data(), size_outbox(), complex.data());
+    transform_backward(1, complex.data(), real.data(), m_normalize_backward);
+    std::copy_n(real.data(), size_inbox(), out.data());
   };
 
+  /**
+   * @brief Applies a per-mode kernel to the spectral data and performs the
+   * backward (inverse) FFT transformation.
+   *
+   * The spectral update that every model does right before the inverse
+   * transform, e.g. `psi_F[k] = opL[k] * psi_F[k] + opN[k] * psiN_F[k]`, is
+   * evaluated here in the same sweep as the normalization of the inverse
+   * transform. The transformation itself is then done without scaling, which
+   * saves one full pass over the real space data compared to a separate
+   * update loop followed by backward().
+   *
+   * @code
+   * fft.backward(psi, [&](size_t k) { return opL[k] * psi_F[k] + opN[k] * psiN_F[k]; }, psi_F);
+   * @endcode
+   *
+   * The kernel is evaluated in parallel when threads are enabled, see
+   * parallel_for(). The kernel values, multiplied by the normalization factor
+   * 1 / (Lx * Ly * Lz) unless backward normalization is turned off (see
+   * set_normalize_backward()), are written to `spectral`, which is then
+   * transformed. `spectral` may be data the kernel reads, like psi_F above, as
+   * long as the kernel reads it only at the index it is evaluated for.
+   *
+   * @param out Output vector of real values.
+   * @param kernel Callable taking the linear index k of the outbox and
+   * returning the complex value of mode k.
+   * @param spectral Vector of size_outbox() complex values, overwritten by the
+   * (normalized) kernel values.
+   */
+  template <typename AO, typename Kernel, typename AS>
+  void backward(std::vector<real_type, AO> &out, Kernel &&kernel, std::vector<complex_type, AS> &spectral) {
+    const T scale = m_normalize_backward ? normalization() : T(1);
+    parallel_for(size_outbox(), [&](size_t k) { spectral[k] = static_cast<complex_type>(kernel(k)) * scale; });
+    transform_backward(1, spectral.data(), out.data(), false);
+  }
+
+  /**
+   * @brief Applies a per-mode kernel to the spectral data and performs the
+   * backward (inverse) FFT transformation, without overwriting any spectral
+   * data of the caller.
+   *
+   * Like above, but the kernel values are written to a scratch buffer of the
+   * workspace pool, so the kernel may read its inputs at any index. The
+   * scratch buffer is one spectral array of precision T on top of the heFFTe
+   * workspace, so it raises the peak of the pool, which is reported as the
+   * "workspace pool" entry of register_memory(). Pass a spectral array which
+   * can be overwritten to the overload above to avoid that.
+   *
+   * The precision of the data is that of `out`. With data of other precision
+   * than T, only the result is converted back to precision U.
+   *
+   * @param out Output vector of real values.
+   * @param kernel Callable taking the linear index k of the outbox and
+   * returning the complex value of mode k.
+   */
+  template <typename U, typename AO, typename Kernel,
+            std::enable_if_t<std::is_floating_point_v<U> && std::is_invocable_v<Kernel &, size_t>, int> = 0>
+  void backward(std::vector<U, AO> &out, Kernel &&kernel) {
+    auto complex = m_pool->borrow<complex_type>(size_outbox());
+    const T scale = m_normalize_backward ? normalization() : T(1);
+    parallel_for(size_outbox(), [&](size_t k) { complex[k] = static_cast<complex_type>(kernel(k)) * scale; });
+    if constexpr (std::is_same_v<U, T>) {
+      transform_backward(1, complex.data(), out.data(), false);
+    } else {
+      auto real = m_pool->borrow<real_type>(size_inbox());
+      transform_backward(1, complex.data(), real.data(), false);
+      std::copy_n(real.data(), size_inbox(), out.data());
+    }
+  }
+
+  /**
+   * @brief Performs the forward FFT transformation for several fields at once.
+   *
+   * The fields are transformed as one batch with a single HeFFTe call, so the
+   * reshapes of all fields are done in the same communication phase with fewer
+   * but larger messages. This is useful when the fields are independent of
+   * each other, e.g.
+   *
+   * @code
+   * fft.forward_batch({psi, psiN}, {psi_F, psiN_F});
+   * @endcode
+   *
+   * HeFFTe needs the batch in one contiguous block. Fields which are already
+   * packed one after another, e.g. parts of one work array declared with a
+   * count, see Model::add_real_work_array(), are transformed in place, others
+   * are copied to and from a scratch buffer. Use the packed overload
+   * forward_batch(batch_size, in, out) to transform a packed array directly.
+   *
+   * The fields can be std::vector or FieldVector, see FieldRef.
+   *
+   * @param in Input vectors of real values, each of size size_inbox().
+   * @param out Output vectors of complex values, each of size size_outbox().
+   * @throws std::invalid_argument if the number of inputs and outputs differ.
+   */
+  void forward_batch(const std::vector<FieldRef<const real_type>> &in,
+                     const std::vector<FieldRef<complex_type>> &out) {
+    if (in.size() != out.size()) {
+      throw std::invalid_argument("forward_batch: number of input and output fields differ.");
+    }
+    const size_t batch_size = in.size(), n_in = size_inbox(), n_out = size_outbox();
+    if (batch_size == 0) return;
+    const bool packed_in = is_packed(in, n_in), packed_out = is_packed(out, n_out);
+    auto batch_real = m_pool->borrow<real_type>(packed_in ? 0 : batch_size * n_in);
+    auto batch_complex = m_pool->borrow<complex_type>(packed_out ? 0 : batch_size * n_out);
+    const real_type *real = packed_in ? in[0].data() : batch_real.data();
+    complex_type *complex = packed_out ? out[0].data() : batch_complex.data();
+    if (!packed_in) {
+      for (size_t b = 0; b < batch_size; b++) std::copy_n(in[b].data(), n_in, batch_real.data() + b * n_in);
+    }
+    transform_forward(batch_size, real, complex);
+    if (!packed_out) {
+      for (size_t b = 0; b < batch_size; b++) std::copy_n(complex + b * n_out, n_out, out[b].data());
+    }
+  }
+
+  /**
+   * @brief Performs the forward FFT transformation for a batch of fields
+   * packed one after another in one array, without copies.
+   *
+   * @code
+   * add_real_work_array("u", 1, 2, 3);    // three fields in one array
+   * add_complex_work_array("U", 1, 2, 3);
+   * ...
+   * fft.forward_batch(3, u, U);
+   * @endcode
+   *
+   * @param batch_size Number of fields.
+   * @param in Input array of real values, of size batch_size * size_inbox().
+   * @param out Output array of complex values, of size batch_size *
+   * size_outbox().
+   * @throws std::invalid_argument if the arrays are too small.
+   */
+  template <typename AI, typename AO>
+  void forward_batch(size_t batch_size, const std::vector<real_type, AI> &in, std::vector<complex_type, AO> &out) {
+    if (in.size() < batch_size * size_inbox() || out.size() < batch_size * size_outbox()) {
+      throw std::invalid_argument("forward_batch: arrays are too small for a batch of " +
+                                  std::to_string(batch_size) + " fields.");
+    }
+    if (batch_size > 0) transform_forward(batch_size, in.data(), out.data());
+  }
+
+  /**
+   * @brief Performs the backward (inverse) FFT transformation for several
+   * fields at once.
+   *
+   * See forward_batch() for details.
+   *
+   * @param in Input vectors of complex values, each of size size_outbox().
+   * @param out Output vectors of real values, each of size size_inbox().
+   * @throws std::invalid_argument if the number of inputs and outputs differ.
+   */
+  void backward_batch(const std::vector<FieldRef<const complex_type>> &in,
+                      const std::vector<FieldRef<real_type>> &out) {
+    if (in.size() != out.size()) {
+      throw std::invalid_argument("backward_batch: number of input and output fields differ.");
+    }
+    const size_t batch_size = in.size(), n_in = size_inbox(), n_out = size_outbox();
+    if (batch_size == 0) return;
+    const bool packed_in = is_packed(in, n_out), packed_out = is_packed(out, n_in);
+    auto batch_complex = m_pool->borrow<complex_type>(packed_in ? 0 : batch_size * n_out);
+    auto batch_real = m_pool->borrow<real_type>(packed_out ? 0 : batch_size * n_in);
+    const complex_type *complex = packed_in ? in[0].data() : batch_complex.data();
+    real_type *real = packed_out ? out[0].data() : batch_real.data();
+    if (!packed_in) {
+      for (size_t b = 0; b < batch_size; b++) std::copy_n(in[b].data(), n_out, batch_complex.data() + b * n_out);
+    }
+    transform_backward(batch_size, complex, real, m_normalize_backward);
+    if (!packed_out) {
+      for (size_t b = 0; b < batch_size; b++) std::copy_n(real + b * n_in, n_in, out[b].data());
+    }
+  }
+
+  /**
+   * @brief Performs the backward (inverse) FFT transformation for a batch of
+   * fields packed one after another in one array, without copies, see
+   * forward_batch(batch_size, in, out).
+   *
+   * @param batch_size Number of fields.
+   * @param in Input array of complex values, of size batch_size *
+   * size_outbox().
+   * @param out Output array of real values, of size batch_size * size_inbox().
+   * @throws std::invalid_argument if the arrays are too small.
+   */
+  template <typename AI, typename AO>
+  void backward_batch(size_t batch_size, const std::vector<complex_type, AI> &in, std::vector<real_type, AO> &out) {
+    if (in.size() < batch_size * size_outbox() || out.size() < batch_size * size_inbox()) {
+      throw std::invalid_argument("backward_batch: arrays are too small for a batch of " +
+                                  std::to_string(batch_size) + " fields.");
+    }
+    if (batch_size > 0) transform_backward(batch_size, in.data(), out.data(), m_normalize_backward);
+  }
+
+  /**
+   * @brief Performs forward FFT transformations in pipelined sub-batches,
+   * overlapping the transformations with pointwise work on finished fields.
+   *
+   * The fields are transformed in sub-batches of `chunk_size` fields. As soon
+   * as a sub-batch is finished, `on_ready(i)` is called on the helper thread
+   * for each field i of it, while the next sub-batch is being transformed and
+   * reshaped. This hides part of the all-to-all latency behind useful work:
+   *
+   * @code
+   * fft.forward_pipelined({u, v, w}, {U, V, W}, [&](size_t i) {
+   *   // pointwise work on field i, e.g. apply operator
+   * });
+   * @endcode
+   *
+   * The callbacks are run in order on one helper thread, which is started once
+   * per call, and must not do MPI communication or use this FFT object. The
+   * WorkspacePool is not thread-safe, so the callbacks must not borrow from
+   * the pool of this FFT either, nor use any other FFT sharing it, which by
+   * default are all of them (see set_workspace_pool()). All callbacks have
+   * finished when the function returns, and an exception thrown by a callback
+   * is rethrown here. Combining this with the `p2p_plined` reshape algorithm
+   * overlaps also the messages inside each reshape.
+   *
+   * @param in Input vectors of real values, each of size size_inbox().
+   * @param out Output vectors of complex values, each of size size_outbox().
+   * @param on_ready Callback called with the index of a finished field.
+   * @param chunk_size Number of fields transformed together.
+   * @throws std::invalid_argument if the number of inputs and outputs differ or
+   * chunk_size is zero.
+   */
+  template <typename Callback>
+  void forward_pipelined(const std::vector<FieldRef<const real_type>> &in,
+                         const std::vector<FieldRef<complex_type>> &out, Callback &&on_ready,
+                         size_t chunk_size = 1) {
+    if (in.size() != out.size()) {
+      throw std::invalid_argument("forward_pipelined: number of input and output fields differ.");
+    }
+    pipeline(in, out, on_ready, chunk_size, [this](const auto &sub_in, const auto &sub_out) {
+      forward_batch(sub_in, sub_out);
+    });
+  }
+
+  /**
+   * @brief Performs backward FFT transformations in pipelined sub-batches,
+   * overlapping the transformations with pointwise work on finished fields.
+   *
+   * See forward_pipelined() for details.
+   *
+   * @param in Input vectors of complex values, each of size size_outbox().
+   * @param out Output vectors of real values, each of size size_inbox().
+   * @param on_ready Callback called with the index of a finished field.
+   * @param chunk_size Number of fields transformed together.
+   * @throws std::invalid_argument if the number of inputs and outputs differ or
+   * chunk_size is zero.
+   */
+  template <typename Callback>
+  void backward_pipelined(const std::vector<FieldRef<const complex_type>> &in,
+                          const std::vector<FieldRef<real_type>> &out, Callback &&on_ready,
+                          size_t chunk_size = 1) {
+    if (in.size() != out.size()) {
+      throw std::invalid_argument("backward_pipelined: number of input and output fields differ.");
+    }
+    pipeline(in, out, on_ready, chunk_size, [this](const auto &sub_in, const auto &sub_out) {
+      backward_batch(sub_in, sub_out);
+    });
+  }
+
   /**
    * @brief Resets the recorded FFT computation time to zero.
+   *
+   * Only the time returned by get_fft_time() is reset, the cumulative counters
+   * returned by get_stats() are reset with reset_stats().
    */
-  void reset_fft_time() { m_fft_time = 0.0; }
+  void reset_fft_time() { m_counters->fft_time = 0.0; }
 
   /**
-   * @brief Returns the recorded FFT computation time.
+   * @brief Returns the recorded FFT computation time, i.e. the time spent in
+   * transformations and scaling since the last reset_fft_time().
    *
    * @return The FFT computation time in seconds.
    */
-  double get_fft_time() const { return m_fft_time; }
+  double get_fft_time() const { return m_counters->fft_time; }
+
+  /**
+   * @brief Returns the cumulative counters of the transformations, including
+   * those of the companions, see make_companion().
+   *
+   * @return Counters since construction or last reset_stats().
+   */
+  FFTStats get_stats() const { return m_counters->stats; }
+
+  /**
+   * @brief Resets the cumulative counters returned by get_stats().
+   */
+  void reset_stats() { m_counters->stats = FFTStats(); }
 
   /**
    * @brief Returns the associated Decomposition object.
@@ -77,28 +706,133 @@ public:
    */
   const Decomposition &get_decomposition() { return m_decomposition; }
 
+  /**
+   * @brief Sets the pool the workspace and other scratch buffers are borrowed
+   * from. By default, all FFT objects share WorkspacePool::get_default().
+   *
+   * @param pool The pool, must outlive this object.
+   */
+  void set_workspace_pool(WorkspacePool &pool) { m_pool = &pool; }
+
+  /**
+   * @brief Returns the pool the scratch buffers are borrowed from.
+   */
+  WorkspacePool &get_workspace_pool() const { return *m_pool; }
+
+  /**
+   * @brief Registers the FFT workspace under category "fft": the arena of the
+   * workspace pool, or one transform's workspace if nothing has been borrowed
+   * yet. The internal buffers of heFFTe are not included.
+   *
+   * @param registry Registry to add the buffer to.
+   */
+  void register_memory(MemoryRegistry &registry) const {
+    registry.set("fft", "workspace pool",
+                 std::max(m_pool->get_capacity(), size_workspace() * sizeof(complex_type)));
+  }
+
+  /**
+   * @brief Returns the backend of the local transformations.
+   */
+  FFTBackend get_backend() const { return m_backend; }
+
+  /**
+   * @brief Returns the plan options the FFT was constructed with.
+   */
+  const heffte::plan_options &get_plan_options() const { return m_plan_options; }
+
+  /**
+   * @brief Returns the options of the native backend the FFT was constructed
+   * with.
+   */
+  const TransposeOptions &get_transpose_options() const { return m_transpose_options; }
+
+  /**
+   * @brief Returns the MPI communicator used in the transformations.
+   *
+   * @return The MPI communicator.
+   */
+  MPI_Comm get_comm() const { return m_comm; }
+
+  /**
+   * @brief Returns the normalization factor of the inverse transform, i.e.
+   * 1 / (Lx * Ly * Lz).
+   *
+   * @return The normalization factor.
+   */
+  T normalization() const {
+    const World &w = m_decomposition.get_world();
+    return static_cast<T>(1.0 / (static_cast<double>(w.Lx) * w.Ly * w.Lz));
+  }
+
+  /**
+   * @brief Turns normalization of backward transformations on or off.
+   *
+   * By default, results of backward transformations are scaled by
+   * normalization() so that backward(forward(u)) == u. The scaling is a full
+   * pass over the real space data. When it is turned off, backward
+   * transformations return N times the inverse, and the factor 1 / N must be
+   * folded into the spectral operators instead, which is free when done once
+   * at construction:
+   *
+   * @code
+   * fft.set_normalize_backward(false);
+   * const double s = fft.get_operator_scale(); // 1 / N
+   * fill_operator(decomp, opL, [&](double, double, double, double k2) { return s * std::exp(-k2 * dt); });
+   * @endcode
+   *
+   * This applies to all backward transformations of this object, so every
+   * user of it must take the operator scale into account.
+   *
+   * @param normalize Scale the results of backward transformations.
+   */
+  void set_normalize_backward(bool normalize) { m_normalize_backward = normalize; }
+
+  /**
+   * @brief Returns true if the results of backward transformations are
+   * normalized.
+   */
+  bool is_backward_normalized() const { return m_normalize_backward; }
+
+  /**
+   * @brief Returns the factor spectral operators feeding backward
+   * transformations must include: 1 if backward transformations are
+   * normalized, normalization() otherwise.
+   */
+  T get_operator_scale() const { return m_normalize_backward ? T(1) : normalization(); }
+
   /**
    * @brief Returns the size of the inbox used for FFT computations.
    *
    * @return Size of the inbox.
    */
-  size_t size_inbox() const { return m_fft.size_inbox(); }
+  size_t size_inbox() const { return m_fft->size_inbox(); }
 
   /**
    * @brief Returns the size of the outbox used for FFT computations.
    *
    * @return Size of the outbox.
    */
-  size_t size_outbox() const { return m_fft.size_outbox(); }
+  size_t size_outbox() const { return m_fft->size_outbox(); }
 
   /**
    * @brief Returns the size of the workspace used for FFT computations.
    *
    * @return Size of the workspace.
    */
-  size_t size_workspace() const { return m_fft.size_workspace(); }
+  size_t size_workspace() const { return m_fft->size_workspace(); }
 };
 
+/**
+ * @brief Double precision FFT, used by models and the rest of the framework.
+ */
+using FFT = BasicFFT<double>;
+
+/**
+ * @brief Single precision FFT.
+ */
+using FFTf = BasicFFT<float>;
+
 } // namespace pfc
 
 #endif
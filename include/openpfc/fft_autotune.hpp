@@ -0,0 +1,280 @@
+#ifndef PFC_FFT_AUTOTUNE_HPP
+#define PFC_FFT_AUTOTUNE_HPP
+
+#include "decomposition.hpp"
+#include "fft.hpp"
+
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <heffte.h>
+#include <iostream>
+#include <limits>
+#include <mpi.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace pfc {
+
+/**
+ * @brief Finds the fastest heFFTe plan options for a given domain
+ * decomposition.
+ *
+ * The best combination of reshape algorithm, pencil/slab reshapes and reorder
+ * depends on the grid shape, the number of ranks and the machine. The
+ * autotuner builds an FFT for each candidate, times a few forward/backward
+ * pairs and returns the fastest one. Optionally, the result is stored in a
+ * plain text cache file keyed by (Lx, Ly, Lz, nprocs, proc grid, r2c
+ * direction, transposed layout, backend, precision), so that later runs with
+ * the same setup skip the search:
+ *
+ * @code
+ * FFTAutotuner tuner(decomp, comm);
+ * tuner.set_cache_file("fft_autotune.txt");
+ * FFT fft(decomp, comm, tuner.tune());
+ * @endcode
+ *
+ * The cache file has one line per setup, `Lx Ly Lz nprocs px py pz r2c
+ * transposed backend precision algorithm use_pencils use_reorder time`. It is
+ * read and written by rank 0 only.
+ *
+ * The plan options only configure the heFFTe reshapes, so nothing is tuned
+ * for FFTBackend::native, and with a slab decomposition the candidates with
+ * pencil reshapes are skipped, as BasicFFT turns them off anyway.
+ *
+ * @tparam T Floating point type of the FFT to tune.
+ */
+template <typename T> class BasicFFTAutotuner {
+private:
+  const Decomposition &m_decomposition;    /**< Decomposition to tune for. */
+  const MPI_Comm m_comm;                   /**< The MPI communicator. */
+  std::string m_cache_file;                /**< Cache file, empty to disable caching. */
+  int m_repetitions = 3;                   /**< Timed forward/backward pairs per candidate. */
+  bool m_verbose = true;                   /**< Print timings of the candidates. */
+  FFTBackend m_backend = FFTBackend::fftw; /**< Backend of the local transformations. */
+
+  int get_rank() const {
+    int rank;
+    MPI_Comm_rank(m_comm, &rank);
+    return rank;
+  }
+
+  /**
+   * @brief Times forward/backward pairs with the given plan options.
+   *
+   * @return Maximum time over all ranks for one forward/backward pair.
+   */
+  double measure(const heffte::plan_options &options) const {
+    BasicFFT<T> fft(m_decomposition, m_comm, options, m_backend);
+    typename BasicFFT<T>::RealVector u(fft.size_inbox());
+    typename BasicFFT<T>::ComplexVector U(fft.size_outbox());
+    for (size_t i = 0; i < u.size(); i++) u[i] = static_cast<T>(std::sin(0.1 * static_cast<double>(i)));
+    fft.forward(u, U); // warm-up, first transform touches all buffers
+    fft.backward(U, u);
+    MPI_Barrier(m_comm);
+    double t0 = MPI_Wtime();
+    for (int n = 0; n < m_repetitions; n++) {
+      fft.forward(u, U);
+      fft.backward(U, u);
+    }
+    double local_time = (MPI_Wtime() - t0) / m_repetitions;
+    double time;
+    MPI_Allreduce(&local_time, &time, 1, MPI_DOUBLE, MPI_MAX, m_comm);
+    return time;
+  }
+
+  /**
+   * @brief Looks up the key from the cache file. Called on rank 0 only.
+   */
+  bool read_cache(heffte::plan_options &options) const {
+    std::ifstream file(m_cache_file);
+    if (!file.is_open()) return false;
+    const std::string key = get_key() + " ";
+    bool found = false;
+    std::string line;
+    while (std::getline(file, line)) {
+      // lines of other setups, and of older cache formats, are skipped
+      if (line.compare(0, key.size(), key) != 0) continue;
+      std::istringstream iss(line.substr(key.size()));
+      std::string algorithm;
+      bool use_pencils, use_reorder;
+      if (!(iss >> algorithm >> use_pencils >> use_reorder)) continue;
+      // the last matching line wins, so a re-tuned result overrides an old one
+      options.algorithm = algorithm_from_string(algorithm);
+      options.use_pencils = use_pencils;
+      options.use_reorder = use_reorder;
+      found = true;
+    }
+    return found;
+  }
+
+  /**
+   * @brief Appends the result to the cache file. Called on rank 0 only.
+   */
+  void write_cache(const heffte::plan_options &options, double time) const {
+    std::ofstream file(m_cache_file, std::ios::app);
+    if (!file.is_open()) {
+      std::cerr << "Unable to write FFT autotune cache " << m_cache_file << std::endl;
+      return;
+    }
+    file << get_key() << " " << algorithm_to_string(options.algorithm) << " " << options.use_pencils << " "
+         << options.use_reorder << " " << time << "\n";
+  }
+
+public:
+  /**
+   * @brief Constructs an autotuner for the given decomposition.
+   *
+   * @param decomposition Domain decomposition the FFT is built for.
+   * @param comm The MPI communicator.
+   */
+  BasicFFTAutotuner(const Decomposition &decomposition, MPI_Comm comm = MPI_COMM_WORLD)
+      : m_decomposition(decomposition), m_comm(comm) {}
+
+  /**
+   * @brief Sets the cache file. Empty string disables caching.
+   */
+  void set_cache_file(const std::string &filename) { m_cache_file = filename; }
+
+  /**
+   * @brief Sets the number of timed forward/backward pairs per candidate.
+   */
+  void set_repetitions(int repetitions) {
+    if (repetitions < 1) throw std::invalid_argument("FFTAutotuner: number of repetitions must be positive");
+    m_repetitions = repetitions;
+  }
+
+  /**
+   * @brief Sets the backend of the local transformations used in timing.
+   */
+  void set_backend(FFTBackend backend) { m_backend = backend; }
+
+  /**
+   * @brief Enables or disables printing of the candidate timings.
+   */
+  void set_verbose(bool verbose) { m_verbose = verbose; }
+
+  /**
+   * @brief Returns the key identifying the setup in the cache file.
+   *
+   * @return String "Lx Ly Lz nprocs px py pz r2c transposed backend precision",
+   * e.g. "64 64 64 4 1 2 2 0 0 fftw double".
+   */
+  std::string get_key() const {
+    const World &w = m_decomposition.get_world();
+    const std::array<int, 3> &grid = m_decomposition.get_proc_grid();
+    std::ostringstream key;
+    key << w.Lx << " " << w.Ly << " " << w.Lz << " " << m_decomposition.get_num_domains() << " " << grid[0] << " "
+        << grid[1] << " " << grid[2] << " " << m_decomposition.r2c_direction << " "
+        << m_decomposition.is_transposed() << " " << to_string(m_backend) << " "
+        << (std::is_same_v<T, float> ? "float" : "double");
+    return key.str();
+  }
+
+  /**
+   * @brief Returns the plan options tried during the search.
+   *
+   * @param slab Decomposition is a slab decomposition, for which the
+   * candidates with pencil reshapes are left out.
+   */
+  static std::vector<heffte::plan_options> get_candidates(bool slab = false) {
+    std::vector<heffte::plan_options> candidates;
+    for (auto algorithm : {heffte::reshape_algorithm::alltoallv, heffte::reshape_algorithm::alltoall,
+                           heffte::reshape_algorithm::p2p, heffte::reshape_algorithm::p2p_plined}) {
+      for (bool use_pencils : {true, false}) {
+        if (slab && use_pencils) continue;
+        for (bool use_reorder : {true, false}) {
+          heffte::plan_options options = heffte::default_options<heffte::backend::fftw>();
+          options.algorithm = algorithm;
+          options.use_pencils = use_pencils;
+          options.use_reorder = use_reorder;
+          candidates.push_back(options);
+        }
+      }
+    }
+    return candidates;
+  }
+
+  static std::string algorithm_to_string(heffte::reshape_algorithm algorithm) {
+    switch (algorithm) {
+    case heffte::reshape_algorithm::alltoallv: return "alltoallv";
+    case heffte::reshape_algorithm::alltoall: return "alltoall";
+    case heffte::reshape_algorithm::p2p: return "p2p";
+    case heffte::reshape_algorithm::p2p_plined: return "p2p_plined";
+    }
+    throw std::invalid_argument("Unknown reshape algorithm");
+  }
+
+  static heffte::reshape_algorithm algorithm_from_string(const std::string &name) {
+    if (name == "alltoallv") return heffte::reshape_algorithm::alltoallv;
+    if (name == "alltoall") return heffte::reshape_algorithm::alltoall;
+    if (name == "p2p") return heffte::reshape_algorithm::p2p;
+    if (name == "p2p_plined") return heffte::reshape_algorithm::p2p_plined;
+    throw std::invalid_argument("Unknown reshape algorithm " + name);
+  }
+
+  /**
+   * @brief Returns the fastest plan options, either from the cache file or by
+   * timing all candidates.
+   *
+   * Must be called collectively on all ranks of the communicator. With
+   * FFTBackend::native, base is returned as is.
+   *
+   * @param base Options not subject to tuning (e.g. use_gpu_aware) are taken
+   * from here.
+   * @return The fastest plan options.
+   */
+  heffte::plan_options tune(heffte::plan_options base = heffte::default_options<heffte::backend::fftw>()) const {
+    if (m_backend == FFTBackend::native) return base;
+    const bool rank0 = get_rank() == 0;
+
+    // rank 0 reads the cache and broadcasts the result: {found, algorithm, pencils, reorder}
+    std::array<int, 4> cached = {0, 0, 0, 0};
+    if (rank0 && !m_cache_file.empty()) {
+      heffte::plan_options options = base;
+      if (read_cache(options)) {
+        cached = {1, static_cast<int>(options.algorithm), options.use_pencils, options.use_reorder};
+      }
+    }
+    MPI_Bcast(cached.data(), 4, MPI_INT, 0, m_comm);
+    if (cached[0]) {
+      base.algorithm = static_cast<heffte::reshape_algorithm>(cached[1]);
+      base.use_pencils = cached[2];
+      base.use_reorder = cached[3];
+      if (m_verbose && rank0) {
+        std::cout << "FFT autotune: using cached plan options for key [" << get_key() << "]: " << base << "\n";
+      }
+      return base;
+    }
+
+    heffte::plan_options best = base;
+    double best_time = std::numeric_limits<double>::max();
+    for (heffte::plan_options candidate : get_candidates(m_decomposition.is_slab())) {
+      candidate.use_gpu_aware = base.use_gpu_aware;
+      double time = measure(candidate);
+      if (m_verbose && rank0) {
+        std::cout << "FFT autotune: " << algorithm_to_string(candidate.algorithm)
+                  << ", pencils: " << candidate.use_pencils << ", reorder: " << candidate.use_reorder << ": " << time
+                  << " s\n";
+      }
+      // every rank sees the same reduced time, so the choice is consistent
+      if (time < best_time) {
+        best_time = time;
+        best = candidate;
+      }
+    }
+    if (m_verbose && rank0) std::cout << "FFT autotune: fastest " << best << "\n";
+    if (rank0 && !m_cache_file.empty()) write_cache(best, best_time);
+    return best;
+  }
+};
+
+using FFTAutotuner = BasicFFTAutotuner<double>;
+using FFTAutotunerf = BasicFFTAutotuner<float>;
+
+} // namespace pfc
+
+#endif
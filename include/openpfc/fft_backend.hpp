@@ -0,0 +1,542 @@
+#ifndef PFC_FFT_BACKEND_HPP
+#define PFC_FFT_BACKEND_HPP
+
+#include "decomposition.hpp"
+#include "parallel.hpp"
+#include "transpose.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <complex>
+#include <heffte.h>
+#include <memory>
+#include <mpi.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef Heffte_ENABLE_FFTW
+#include <fftw3.h>
+#endif
+
+namespace pfc {
+
+/**
+ * @brief Backends of HeFFTe used for the local 1D transformations.
+ *
+ * Which ones are available depends on how HeFFTe was built, see
+ * is_enabled(FFTBackend). The native backend does not use HeFFTe for the
+ * transforms, but OpenPFC's own Transpose with local FFTW transforms.
+ */
+enum class FFTBackend {
+  fftw,  /**< FFTW3. */
+  stock, /**< HeFFTe's own stock implementation. */
+  mkl,   /**< Intel MKL. */
+  native /**< OpenPFC transposes with local FFTW transforms, see NativeExecutor. */
+};
+
+/**
+ * @brief Returns the name of the backend.
+ */
+inline std::string to_string(FFTBackend backend) {
+  switch (backend) {
+  case FFTBackend::fftw: return "fftw";
+  case FFTBackend::stock: return "stock";
+  case FFTBackend::mkl: return "mkl";
+  case FFTBackend::native: return "native";
+  }
+  throw std::invalid_argument("Unknown FFT backend");
+}
+
+/**
+ * @brief Returns the backend with the given name.
+ *
+ * @throws std::invalid_argument if the name is not one of "fftw", "stock",
+ * "mkl" or "native".
+ */
+inline FFTBackend fft_backend_from_string(const std::string &name) {
+  if (name == "fftw") return FFTBackend::fftw;
+  if (name == "stock") return FFTBackend::stock;
+  if (name == "mkl") return FFTBackend::mkl;
+  if (name == "native") return FFTBackend::native;
+  throw std::invalid_argument("Unknown FFT backend " + name);
+}
+
+/**
+ * @brief Returns true if HeFFTe was built with the backend.
+ */
+inline bool is_enabled(FFTBackend backend) {
+  switch (backend) {
+  case FFTBackend::fftw: return heffte::backend::is_enabled<heffte::backend::fftw>::value;
+  case FFTBackend::stock: return heffte::backend::is_enabled<heffte::backend::stock>::value;
+  case FFTBackend::mkl: return heffte::backend::is_enabled<heffte::backend::mkl>::value;
+  case FFTBackend::native: return heffte::backend::is_enabled<heffte::backend::fftw>::value;
+  }
+  return false;
+}
+
+/**
+ * @brief Time and traffic of the phases of the transformations, as measured
+ * by an executor.
+ */
+struct FFTPhaseCounters {
+  bool measured = false;     /**< The executor measures its phases, false for the HeFFTe backends. */
+  double compute_time = 0.0; /**< Wall time of the local 1D FFTs. */
+  double reshape_time = 0.0; /**< Wall time of the reshapes, including local copies. */
+  size_t reshape_bytes = 0;  /**< Bytes sent to other ranks in the reshapes. */
+};
+
+/**
+ * @brief Type-erased HeFFTe real-to-complex transformation, so that the
+ * backend can be selected at runtime.
+ *
+ * @tparam T Floating point type used in the transformations.
+ */
+template <typename T> class FFTExecutor {
+public:
+  using complex_type = std::complex<T>;
+
+  virtual ~FFTExecutor() = default;
+
+  /**
+   * @brief Forward transformation of a batch of fields packed one after
+   * another.
+   */
+  virtual void forward(int batch_size, const T *in, complex_type *out, complex_type *workspace) const = 0;
+
+  /**
+   * @brief Backward transformation of a batch of fields packed one after
+   * another.
+   */
+  virtual void backward(int batch_size, const complex_type *in, T *out, complex_type *workspace,
+                        heffte::scale scaling) const = 0;
+
+  /**
+   * @brief Returns the phase counters accumulated since the last call and
+   * resets them. HeFFTe does the reshapes and the local transforms inside one
+   * call, so its backends return counters that are not measured.
+   */
+  virtual FFTPhaseCounters take_phase_counters() const { return FFTPhaseCounters(); }
+
+  virtual size_t size_inbox() const = 0;
+  virtual size_t size_outbox() const = 0;
+  virtual size_t size_workspace() const = 0;
+};
+
+/**
+ * @brief FFTExecutor implemented with heffte::fft3d_r2c using the backend
+ * given by Tag.
+ */
+template <typename T, typename Tag> class HeffteExecutor : public FFTExecutor<T> {
+private:
+  const heffte::fft3d_r2c<Tag> m_fft;
+
+public:
+  using complex_type = std::complex<T>;
+
+  HeffteExecutor(const heffte::box3d<int> &inbox, const heffte::box3d<int> &outbox, int r2c_direction, MPI_Comm comm,
+                 const heffte::plan_options &options)
+      : m_fft(inbox, outbox, r2c_direction, comm, options) {}
+
+  void forward(int batch_size, const T *in, complex_type *out, complex_type *workspace) const override {
+    if (batch_size == 1) {
+      m_fft.forward(in, out, workspace);
+    } else {
+      m_fft.forward(batch_size, in, out, workspace);
+    }
+  }
+
+  void backward(int batch_size, const complex_type *in, T *out, complex_type *workspace,
+                heffte::scale scaling) const override {
+    if (batch_size == 1) {
+      m_fft.backward(in, out, workspace, scaling);
+    } else {
+      m_fft.backward(batch_size, in, out, workspace, scaling);
+    }
+  }
+
+  size_t size_inbox() const override { return m_fft.size_inbox(); }
+  size_t size_outbox() const override { return m_fft.size_outbox(); }
+  size_t size_workspace() const override { return m_fft.size_workspace(); }
+};
+
+#ifdef Heffte_ENABLE_FFTW
+namespace detail {
+
+/**
+ * @brief FFTW guru interface of precision T.
+ */
+template <typename T> struct fftw_api;
+
+template <> struct fftw_api<double> {
+  using plan_type = fftw_plan;
+  static plan_type r2c(const fftw_iodim &dim, const fftw_iodim *howmany, double *in, std::complex<double> *out,
+                       unsigned flags) {
+    return fftw_plan_guru_dft_r2c(1, &dim, 2, howmany, in, reinterpret_cast<fftw_complex *>(out), flags);
+  }
+  static plan_type c2r(const fftw_iodim &dim, const fftw_iodim *howmany, std::complex<double> *in, double *out,
+                       unsigned flags) {
+    return fftw_plan_guru_dft_c2r(1, &dim, 2, howmany, reinterpret_cast<fftw_complex *>(in), out, flags);
+  }
+  static plan_type c2c(const fftw_iodim &dim, const fftw_iodim *howmany, std::complex<double> *data, int sign,
+                       unsigned flags) {
+    auto ptr = reinterpret_cast<fftw_complex *>(data);
+    return fftw_plan_guru_dft(1, &dim, 2, howmany, ptr, ptr, sign, flags);
+  }
+  static void execute_r2c(plan_type p, const double *in, std::complex<double> *out) {
+    fftw_execute_dft_r2c(p, const_cast<double *>(in), reinterpret_cast<fftw_complex *>(out));
+  }
+  static void execute_c2r(plan_type p, std::complex<double> *in, double *out) {
+    fftw_execute_dft_c2r(p, reinterpret_cast<fftw_complex *>(in), out);
+  }
+  static void execute_c2c(plan_type p, std::complex<double> *data) {
+    auto ptr = reinterpret_cast<fftw_complex *>(data);
+    fftw_execute_dft(p, ptr, ptr);
+  }
+  static void destroy(plan_type p) { fftw_destroy_plan(p); }
+};
+
+template <> struct fftw_api<float> {
+  using plan_type = fftwf_plan;
+  static plan_type r2c(const fftw_iodim &dim, const fftw_iodim *howmany, float *in, std::complex<float> *out,
+                       unsigned flags) {
+    return fftwf_plan_guru_dft_r2c(1, &dim, 2, howmany, in, reinterpret_cast<fftwf_complex *>(out), flags);
+  }
+  static plan_type c2r(const fftw_iodim &dim, const fftw_iodim *howmany, std::complex<float> *in, float *out,
+                       unsigned flags) {
+    return fftwf_plan_guru_dft_c2r(1, &dim, 2, howmany, reinterpret_cast<fftwf_complex *>(in), out, flags);
+  }
+  static plan_type c2c(const fftw_iodim &dim, const fftw_iodim *howmany, std::complex<float> *data, int sign,
+                       unsigned flags) {
+    auto ptr = reinterpret_cast<fftwf_complex *>(data);
+    return fftwf_plan_guru_dft(1, &dim, 2, howmany, ptr, ptr, sign, flags);
+  }
+  static void execute_r2c(plan_type p, const float *in, std::complex<float> *out) {
+    fftwf_execute_dft_r2c(p, const_cast<float *>(in), reinterpret_cast<fftwf_complex *>(out));
+  }
+  static void execute_c2r(plan_type p, std::complex<float> *in, float *out) {
+    fftwf_execute_dft_c2r(p, reinterpret_cast<fftwf_complex *>(in), out);
+  }
+  static void execute_c2c(plan_type p, std::complex<float> *data) {
+    auto ptr = reinterpret_cast<fftwf_complex *>(data);
+    fftwf_execute_dft(p, ptr, ptr);
+  }
+  static void destroy(plan_type p) { fftwf_destroy_plan(p); }
+};
+
+} // namespace detail
+
+/**
+ * @brief FFTExecutor implemented with OpenPFC's Transpose and local FFTW
+ * transforms, without HeFFTe reshapes.
+ *
+ * The forward transform moves the data from the inbox to pencils along the
+ * r2c direction, does the r2c transforms, and then for each other direction
+ * with more than one point transposes to pencils along that direction and
+ * does the c2c transforms, finally moving the result to the outbox. Pencil
+ * grids are those of Decomposition::make_pencil_grid(), so transposes that
+ * would not move any data (e.g. to a transposed outbox, from a slab inbox, or
+ * between pencils that are split in the same direction) are skipped. All
+ * transposes, FFTW plans and buffer sizes are set up once at construction;
+ * the 1D transforms are done in place with strided FFTW guru plans, so the
+ * local data is never reordered.
+ *
+ * @tparam T Floating point type used in the transformations.
+ */
+template <typename T> class NativeExecutor : public FFTExecutor<T> {
+public:
+  using complex_type = std::complex<T>;
+
+private:
+  using api = detail::fftw_api<T>;
+  using plan_type = typename api::plan_type;
+  using box_type = heffte::box3d<int>;
+
+  const box_type m_inbox, m_outbox;                                      ///< Local boxes.
+  size_t m_size_real = 0;                                                ///< Size of the local real pencil.
+  std::vector<size_t> m_size_complex;                                    ///< Sizes of the local complex pencils.
+  size_t m_buffer_size = 0;                                              ///< Size of one buffer, per field.
+  double m_num_points = 1.0;                                             ///< Number of points of the whole domain.
+  std::unique_ptr<Transpose<T>> m_to_pencils, m_from_pencils;            ///< Inbox <-> real r2c pencils.
+  std::vector<std::unique_ptr<Transpose<complex_type>>> m_forward, m_backward; ///< Between complex pencils.
+  std::unique_ptr<Transpose<complex_type>> m_to_outbox, m_from_outbox;   ///< Last pencils <-> outbox.
+  plan_type m_r2c = nullptr, m_c2r = nullptr;                            ///< Transforms in r2c direction.
+  std::vector<plan_type> m_c2c_forward, m_c2c_backward;                  ///< Transforms in the other directions.
+  mutable FFTPhaseCounters m_phases;                                     ///< Counters since take_phase_counters().
+
+  /**
+   * @brief Runs a transpose of a batch and adds it to the phase counters.
+   */
+  template <typename E>
+  void run_transpose(const Transpose<E> &transpose, int batch_size, const E *in, E *out) const {
+    double t = -MPI_Wtime();
+    transpose.execute(batch_size, in, out);
+    m_phases.reshape_time += t + MPI_Wtime();
+    m_phases.reshape_bytes += batch_size * transpose.get_send_bytes();
+  }
+
+  /**
+   * @brief Copies a batch of data locally and adds it to the reshape time.
+   */
+  template <typename E> void copy(const E *in, size_t count, E *out) const {
+    double t = -MPI_Wtime();
+    std::copy_n(in, count, out);
+    m_phases.reshape_time += t + MPI_Wtime();
+  }
+
+  static std::vector<box_type> gather_boxes(const box_type &box, MPI_Comm comm) {
+    int size;
+    MPI_Comm_size(comm, &size);
+    std::array<int, 6> local = {box.low[0], box.low[1], box.low[2], box.high[0], box.high[1], box.high[2]};
+    std::vector<int> all(6 * size);
+    MPI_Allgather(local.data(), 6, MPI_INT, all.data(), 6, MPI_INT, comm);
+    std::vector<box_type> boxes;
+    for (int r = 0; r < size; r++) {
+      boxes.emplace_back(std::array<int, 3>{all[6 * r], all[6 * r + 1], all[6 * r + 2]},
+                         std::array<int, 3>{all[6 * r + 3], all[6 * r + 4], all[6 * r + 5]});
+    }
+    return boxes;
+  }
+
+  static box_type bounding_box(const std::vector<box_type> &boxes) {
+    std::array<int, 3> low = boxes[0].low, high = boxes[0].high;
+    for (const auto &box : boxes) {
+      for (int axis = 0; axis < 3; axis++) {
+        low[axis] = std::min(low[axis], box.low[axis]);
+        high[axis] = std::max(high[axis], box.high[axis]);
+      }
+    }
+    return box_type(low, high);
+  }
+
+  /**
+   * @brief Returns the FFTW description of axis of a box: size, and strides
+   * in the input and output boxes, which are x fastest.
+   */
+  static fftw_iodim make_iodim(const box_type &in, const box_type &out, int axis) {
+    const std::array<int, 3> is = {1, in.size[0], in.size[0] * in.size[1]};
+    const std::array<int, 3> os = {1, out.size[0], out.size[0] * out.size[1]};
+    return fftw_iodim{in.size[axis], is[axis], os[axis]};
+  }
+
+  template <typename Transposes>
+  static void make_transpose(std::unique_ptr<Transposes> &transpose, const std::vector<box_type> &in,
+                             const std::vector<box_type> &out, MPI_Comm comm, const TransposeOptions &options) {
+    if (!Transposes::is_identity(in, out)) transpose = std::make_unique<Transposes>(in, out, comm, options);
+  }
+
+public:
+  /**
+   * @brief Constructs the transforms. Collective over comm.
+   *
+   * @param inbox Local real space box.
+   * @param outbox Local complex space box.
+   * @param r2c_direction Real-to-complex symmetry direction.
+   * @param comm The MPI communicator.
+   * @param options Transpose method and wire precision.
+   */
+  NativeExecutor(const box_type &inbox, const box_type &outbox, int r2c_direction, MPI_Comm comm,
+                 const TransposeOptions &options)
+      : m_inbox(inbox), m_outbox(outbox) {
+    m_phases.measured = true;
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    const std::vector<box_type> inboxes = gather_boxes(inbox, comm), outboxes = gather_boxes(outbox, comm);
+    const box_type real_world = bounding_box(inboxes), complex_world = real_world.r2c(r2c_direction);
+    m_num_points = static_cast<double>(real_world.count());
+
+    // directions of the transforms: r2c first, then the others with more than one point
+    std::vector<int> directions = {r2c_direction};
+    const int last = Decomposition::get_last_direction(real_world, r2c_direction);
+    const int middle = 3 - r2c_direction - last;
+    if (real_world.size[middle] > 1) directions.push_back(middle);
+    if (real_world.size[last] > 1) directions.push_back(last);
+
+    // pencils of each direction, with the same grid in real and complex space for r2c
+    std::vector<std::vector<box_type>> pencils;
+    for (int d : directions) {
+      pencils.push_back(heffte::split_world(complex_world, Decomposition::make_pencil_grid(complex_world, size, d)));
+      m_size_complex.push_back(static_cast<size_t>(pencils.back()[rank].count()));
+    }
+    const std::vector<box_type> real_pencils =
+        heffte::split_world(real_world, Decomposition::make_pencil_grid(complex_world, size, r2c_direction));
+    m_size_real = static_cast<size_t>(real_pencils[rank].count());
+    m_buffer_size = std::max((m_size_real + 1) / 2, *std::max_element(m_size_complex.begin(), m_size_complex.end()));
+
+    make_transpose(m_to_pencils, inboxes, real_pencils, comm, options);
+    make_transpose(m_from_pencils, real_pencils, inboxes, comm, options);
+    m_forward.resize(pencils.size() - 1);
+    m_backward.resize(pencils.size() - 1);
+    for (size_t k = 1; k < pencils.size(); k++) {
+      make_transpose(m_forward[k - 1], pencils[k - 1], pencils[k], comm, options);
+      make_transpose(m_backward[k - 1], pencils[k], pencils[k - 1], comm, options);
+    }
+    make_transpose(m_to_outbox, pencils.back(), outboxes, comm, options);
+    make_transpose(m_from_outbox, outboxes, pencils.back(), comm, options);
+
+    // plans are measured on scratch buffers and executed with new arrays
+    const unsigned flags = FFTW_MEASURE | FFTW_UNALIGNED;
+    std::vector<T> real(m_size_real);
+    std::vector<complex_type> complex(m_size_complex[0]);
+    {
+      const box_type &rb = real_pencils[rank], &cb = pencils[0][rank];
+      const int r = r2c_direction, a = (r == 0) ? 1 : 0, b = 3 - r - a;
+      fftw_iodim dim = make_iodim(rb, cb, r);
+      fftw_iodim howmany[2] = {make_iodim(rb, cb, a), make_iodim(rb, cb, b)};
+      m_r2c = api::r2c(dim, howmany, real.data(), complex.data(), flags);
+      dim = make_iodim(cb, rb, r);
+      dim.n = rb.size[r]; // logical size of the c2r transform
+      howmany[0] = make_iodim(cb, rb, a);
+      howmany[1] = make_iodim(cb, rb, b);
+      m_c2r = api::c2r(dim, howmany, complex.data(), real.data(), flags);
+    }
+    for (size_t k = 1; k < pencils.size(); k++) {
+      const box_type &cb = pencils[k][rank];
+      const int d = directions[k], a = (d == 0) ? 1 : 0, b = 3 - d - a;
+      const fftw_iodim dim = make_iodim(cb, cb, d);
+      const fftw_iodim howmany[2] = {make_iodim(cb, cb, a), make_iodim(cb, cb, b)};
+      complex.resize(m_size_complex[k]);
+      m_c2c_forward.push_back(api::c2c(dim, howmany, complex.data(), FFTW_FORWARD, flags));
+      m_c2c_backward.push_back(api::c2c(dim, howmany, complex.data(), FFTW_BACKWARD, flags));
+    }
+  }
+
+  NativeExecutor(const NativeExecutor &) = delete;
+  NativeExecutor &operator=(const NativeExecutor &) = delete;
+
+  ~NativeExecutor() override {
+    api::destroy(m_r2c);
+    api::destroy(m_c2r);
+    for (plan_type p : m_c2c_forward) api::destroy(p);
+    for (plan_type p : m_c2c_backward) api::destroy(p);
+  }
+
+  void forward(int batch_size, const T *in, complex_type *out, complex_type *workspace) const override {
+    complex_type *a = workspace, *b = workspace + batch_size * m_buffer_size;
+    const size_t last = m_size_complex.size() - 1;
+    const T *real = in;
+    if (m_to_pencils) {
+      run_transpose(*m_to_pencils, batch_size, in, reinterpret_cast<T *>(b));
+      real = reinterpret_cast<T *>(b);
+    }
+    // the last stage writes directly to out if there is no transpose to the outbox
+    complex_type *current = (last == 0 && !m_to_outbox) ? out : a;
+    double t = -MPI_Wtime();
+    for (int f = 0; f < batch_size; f++) {
+      api::execute_r2c(m_r2c, real + f * m_size_real, current + f * m_size_complex[0]);
+    }
+    m_phases.compute_time += t + MPI_Wtime();
+    for (size_t k = 1; k <= last; k++) {
+      complex_type *next = (k == last && !m_to_outbox) ? out : (current == a ? b : a);
+      if (m_forward[k - 1]) {
+        run_transpose(*m_forward[k - 1], batch_size, current, next);
+      } else if (next == out) {
+        copy(current, batch_size * m_size_complex[k], out);
+      } else {
+        next = current;
+      }
+      t = -MPI_Wtime();
+      for (int f = 0; f < batch_size; f++) api::execute_c2c(m_c2c_forward[k - 1], next + f * m_size_complex[k]);
+      m_phases.compute_time += t + MPI_Wtime();
+      current = next;
+    }
+    if (m_to_outbox) run_transpose(*m_to_outbox, batch_size, current, out);
+  }
+
+  void backward(int batch_size, const complex_type *in, T *out, complex_type *workspace,
+                heffte::scale scaling) const override {
+    complex_type *a = workspace, *b = workspace + batch_size * m_buffer_size;
+    const size_t stages = m_size_complex.size();
+    if (m_from_outbox) {
+      run_transpose(*m_from_outbox, batch_size, in, a);
+    } else {
+      copy(in, batch_size * m_size_complex[stages - 1], a);
+    }
+    double t;
+    for (size_t k = stages - 1; k > 0; k--) {
+      t = -MPI_Wtime();
+      for (int f = 0; f < batch_size; f++) api::execute_c2c(m_c2c_backward[k - 1], a + f * m_size_complex[k]);
+      m_phases.compute_time += t + MPI_Wtime();
+      if (m_backward[k - 1]) {
+        run_transpose(*m_backward[k - 1], batch_size, a, b);
+        std::swap(a, b);
+      }
+    }
+    T *real = m_from_pencils ? reinterpret_cast<T *>(b) : out;
+    t = -MPI_Wtime();
+    for (int f = 0; f < batch_size; f++) {
+      api::execute_c2r(m_c2r, a + f * m_size_complex[0], real + f * m_size_real);
+    }
+    m_phases.compute_time += t + MPI_Wtime();
+    if (m_from_pencils) run_transpose(*m_from_pencils, batch_size, static_cast<const T *>(real), out);
+    if (scaling != heffte::scale::none) {
+      t = -MPI_Wtime();
+      const T factor =
+          static_cast<T>(scaling == heffte::scale::full ? 1.0 / m_num_points : 1.0 / std::sqrt(m_num_points));
+      parallel_for(batch_size * size_inbox(), [out, factor](size_t i) { out[i] *= factor; });
+      m_phases.compute_time += t + MPI_Wtime();
+    }
+  }
+
+  FFTPhaseCounters take_phase_counters() const override {
+    FFTPhaseCounters phases = m_phases;
+    m_phases = FFTPhaseCounters();
+    m_phases.measured = true;
+    return phases;
+  }
+
+  size_t size_inbox() const override { return static_cast<size_t>(m_inbox.count()); }
+  size_t size_outbox() const override { return static_cast<size_t>(m_outbox.count()); }
+  size_t size_workspace() const override { return 2 * m_buffer_size; }
+};
+#endif
+
+/**
+ * @brief Creates the executor of the backend given by Tag, or throws if
+ * HeFFTe was built without it.
+ */
+template <typename T, typename Tag>
+std::unique_ptr<FFTExecutor<T>> make_heffte_executor(const heffte::box3d<int> &inbox, const heffte::box3d<int> &outbox,
+                                                     int r2c_direction, MPI_Comm comm,
+                                                     const heffte::plan_options &options) {
+  if constexpr (heffte::backend::is_enabled<Tag>::value) {
+    return std::make_unique<HeffteExecutor<T, Tag>>(inbox, outbox, r2c_direction, comm, options);
+  } else {
+    throw std::invalid_argument("HeFFTe was built without the requested FFT backend");
+  }
+}
+
+/**
+ * @brief Creates the executor of the given backend.
+ *
+ * @param transpose_options Options of the native backend, ignored by the
+ * HeFFTe backends.
+ * @throws std::invalid_argument if HeFFTe was built without the backend.
+ */
+template <typename T>
+std::unique_ptr<FFTExecutor<T>> make_fft_executor(FFTBackend backend, const heffte::box3d<int> &inbox,
+                                                  const heffte::box3d<int> &outbox, int r2c_direction, MPI_Comm comm,
+                                                  const heffte::plan_options &options,
+                                                  const TransposeOptions &transpose_options = TransposeOptions()) {
+  switch (backend) {
+  case FFTBackend::fftw:
+    return make_heffte_executor<T, heffte::backend::fftw>(inbox, outbox, r2c_direction, comm, options);
+  case FFTBackend::stock:
+    return make_heffte_executor<T, heffte::backend::stock>(inbox, outbox, r2c_direction, comm, options);
+  case FFTBackend::mkl:
+    return make_heffte_executor<T, heffte::backend::mkl>(inbox, outbox, r2c_direction, comm, options);
+  case FFTBackend::native:
+#ifdef Heffte_ENABLE_FFTW
+    return std::make_unique<NativeExecutor<T>>(inbox, outbox, r2c_direction, comm, transpose_options);
+#else
+    throw std::invalid_argument("Native FFT backend requires HeFFTe built with FFTW");
+#endif
+  }
+  throw std::invalid_argument("Unknown FFT backend");
+}
+
+} // namespace pfc
+
+#endif
@@ -0,0 +1,205 @@
+#ifndef PFC_FFTW_WISDOM_HPP
+#define PFC_FFTW_WISDOM_HPP
+
+#include <fstream>
+#include <heffte.h>
+#include <iostream>
+#include <mpi.h>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#ifdef Heffte_ENABLE_FFTW
+#include <fftw3.h>
+#endif
+
+namespace pfc {
+
+/**
+ * @brief Import and export of FFTW wisdom.
+ *
+ * FFTW accumulates the results of plan creation into "wisdom", which can be
+ * saved and loaded later to skip the planning. Loading the wisdom before
+ * constructing FFT objects and saving it afterwards makes restart chains of
+ * short jobs avoid paying the planning cost every time:
+ *
+ * @code
+ * fftw_wisdom::import_wisdom("wisdom.fftw", comm);
+ * FFT fft(decomp, comm);
+ * fftw_wisdom::export_wisdom("wisdom.fftw", comm);
+ * @endcode
+ *
+ * Only rank 0 touches the file system. The wisdom read by rank 0 is broadcast
+ * to all ranks of the communicator, so all functions must be called
+ * collectively. FFTW keeps the wisdom of double and single precision plans
+ * separately; the file holds both, so that mixed precision models (e.g. the
+ * FFTf of the Tungsten mean field) benefit as well.
+ *
+ * Without the FFTW backend of HeFFTe (`Heffte_ENABLE_FFTW`), there is no
+ * wisdom: the functions do nothing and return false or an empty string.
+ */
+namespace fftw_wisdom {
+
+/**
+ * @brief Imports FFTW wisdom of precision T from a string on the calling rank.
+ *
+ * @return True if FFTW accepted the wisdom.
+ */
+template <typename T = double> bool import_from_string(const std::string &wisdom) {
+  static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>, "T must be float or double");
+#ifdef Heffte_ENABLE_FFTW
+  if constexpr (std::is_same_v<T, double>) {
+    return fftw_import_wisdom_from_string(wisdom.c_str()) != 0;
+  } else {
+    return fftwf_import_wisdom_from_string(wisdom.c_str()) != 0;
+  }
+#else
+  (void)wisdom;
+  return false;
+#endif
+}
+
+/**
+ * @brief Exports the FFTW wisdom of precision T of the calling rank to a
+ * string.
+ */
+template <typename T = double> std::string export_to_string() {
+  static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>, "T must be float or double");
+  std::string wisdom;
+#ifdef Heffte_ENABLE_FFTW
+  if constexpr (std::is_same_v<T, double>) {
+    char *str = fftw_export_wisdom_to_string();
+    if (str != nullptr) {
+      wisdom = str;
+      fftw_free(str);
+    }
+  } else {
+    char *str = fftwf_export_wisdom_to_string();
+    if (str != nullptr) {
+      wisdom = str;
+      fftwf_free(str);
+    }
+  }
+#endif
+  return wisdom;
+}
+
+namespace detail {
+
+/**
+ * @brief Splits a wisdom file into its top level parenthesized expressions,
+ * one per precision.
+ */
+inline std::vector<std::string> split_wisdom(const std::string &wisdom) {
+  std::vector<std::string> parts;
+  int depth = 0;
+  size_t begin = 0;
+  for (size_t i = 0; i < wisdom.size(); i++) {
+    if (wisdom[i] == '(') {
+      if (depth == 0) begin = i;
+      depth++;
+    } else if (wisdom[i] == ')' && depth > 0) {
+      depth--;
+      if (depth == 0) parts.push_back(wisdom.substr(begin, i - begin + 1));
+    }
+  }
+  return parts;
+}
+
+} // namespace detail
+
+/**
+ * @brief Reads FFTW wisdom from file on rank 0 and imports it on all ranks.
+ *
+ * A missing file is not an error, as it is the normal situation on the first
+ * run of a restart chain. Both the double and the single precision wisdom in
+ * the file are imported.
+ *
+ * @param filename File to read the wisdom from.
+ * @param comm The MPI communicator.
+ * @return True if the wisdom was imported on all ranks.
+ */
+inline bool import_wisdom(const std::string &filename, MPI_Comm comm = MPI_COMM_WORLD) {
+#ifndef Heffte_ENABLE_FFTW
+  (void)filename;
+  (void)comm;
+  return false;
+#else
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  std::string wisdom;
+  if (rank == 0) {
+    std::ifstream file(filename);
+    if (file.is_open()) {
+      std::ostringstream content;
+      content << file.rdbuf();
+      wisdom = content.str();
+    } else {
+      std::cout << "FFTW wisdom file " << filename << " not found, plans are created from scratch" << std::endl;
+    }
+  }
+  int length = static_cast<int>(wisdom.size());
+  MPI_Bcast(&length, 1, MPI_INT, 0, comm);
+  if (length == 0) return false;
+  wisdom.resize(length);
+  MPI_Bcast(wisdom.data(), length, MPI_CHAR, 0, comm);
+  const std::vector<std::string> parts = detail::split_wisdom(wisdom);
+  int local_ok = !parts.empty();
+  for (const std::string &part : parts) {
+    // FFTW rejects the wisdom of the other precision by its header
+    if (!import_from_string<double>(part) && !import_from_string<float>(part)) local_ok = 0;
+  }
+  int ok;
+  MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_LAND, comm);
+  if (rank == 0) {
+    if (ok) {
+      std::cout << "Imported FFTW wisdom from " << filename << std::endl;
+    } else {
+      std::cerr << "Failed to import FFTW wisdom from " << filename << std::endl;
+    }
+  }
+  return ok;
+#endif
+}
+
+/**
+ * @brief Writes the FFTW wisdom of rank 0 to file.
+ *
+ * Collective call so that all ranks have finished planning before the file is
+ * written. The double precision wisdom is followed by the single precision
+ * wisdom in the same file.
+ *
+ * @param filename File to write the wisdom to.
+ * @param comm The MPI communicator.
+ * @return True if the wisdom was written.
+ */
+inline bool export_wisdom(const std::string &filename, MPI_Comm comm = MPI_COMM_WORLD) {
+#ifndef Heffte_ENABLE_FFTW
+  (void)filename;
+  (void)comm;
+  return false;
+#else
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Barrier(comm);
+  int ok = 1;
+  if (rank == 0) {
+    std::ofstream file(filename);
+    if (file.is_open()) {
+      file << export_to_string<double>() << export_to_string<float>();
+      ok = static_cast<bool>(file);
+    } else {
+      ok = 0;
+    }
+    if (!ok) std::cerr << "Failed to write FFTW wisdom to " << filename << std::endl;
+  }
+  MPI_Bcast(&ok, 1, MPI_INT, 0, comm);
+  return ok;
+#endif
+}
+
+} // namespace fftw_wisdom
+} // namespace pfc
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef PFC_FIELD_EXPRESSION_HPP
+#define PFC_FIELD_EXPRESSION_HPP
+
+#include "array.hpp"
+#include "parallel.hpp"
+
+#include <complex>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace pfc {
+
+/**
+ * @brief Expression templates for pointwise field algebra.
+ *
+ * Arithmetic on field references does not compute anything, it builds an
+ * expression object describing the computation. The expression is evaluated
+ * when it is assigned to a field, in a single pass over the data with
+ * parallel_for(), so the whole right-hand side becomes one loop which the
+ * compiler can inline and vectorize, without temporary fields or extra
+ * memory passes:
+ *
+ * @code
+ * auto u = expr::ref(psi), v = expr::ref(psiMF);
+ * expr::assign(psiN, p3 * u * u + p4 * u * u * u + q3 * v * v + q4 * v * v * v - stabP * u);
+ * @endcode
+ *
+ * Operands are fields wrapped with ref(), scalars (arithmetic or complex) and
+ * other expressions, combined with +, -, * and / and unary minus. Any other
+ * pointwise function can be applied with map(). Fields in one expression must
+ * have the same size, and the output may be one of the inputs.
+ */
+namespace expr {
+
+// Element access of deeply nested expressions must be inlined all the way
+// down for the loop to vectorize, which the default inlining heuristics do not
+// guarantee.
+#if defined(__GNUC__) || defined(__clang__)
+#define PFC_EXPR_INLINE inline __attribute__((always_inline))
+#else
+#define PFC_EXPR_INLINE inline
+#endif
+
+/**
+ * @brief Base class of all expressions (CRTP), used to restrict the
+ * operators to expression types.
+ */
+template <typename E> struct Expression {
+  const E &self() const { return static_cast<const E &>(*this); }
+};
+
+template <typename S> struct is_scalar : std::is_arithmetic<S> {};
+template <typename S> struct is_scalar<std::complex<S>> : std::true_type {};
+template <typename S> constexpr bool is_scalar_v = is_scalar<S>::value;
+
+/**
+ * @brief Read-only view of the data of a field.
+ */
+template <typename T> class Terminal : public Expression<Terminal<T>> {
+private:
+  const T *m_data;
+  size_t m_size;
+
+public:
+  Terminal(const T *data, size_t size) : m_data(data), m_size(size) {}
+  PFC_EXPR_INLINE T operator[](size_t i) const { return m_data[i]; }
+  size_t size() const { return m_size; }
+};
+
+/**
+ * @brief Scalar operand, broadcast to every element. Has size 0, which
+ * matches fields of any size.
+ */
+template <typename S> class Scalar : public Expression<Scalar<S>> {
+private:
+  S m_value;
+
+public:
+  explicit Scalar(S value) : m_value(value) {}
+  PFC_EXPR_INLINE S operator[](size_t) const { return m_value; }
+  size_t size() const { return 0; }
+};
+
+/**
+ * @brief Elementwise binary operation. Operands are stored by value, which is
+ * cheap as terminals are only views.
+ */
+template <typename Op, typename L, typename R> class Binary : public Expression<Binary<Op, L, R>> {
+private:
+  L m_lhs;
+  R m_rhs;
+
+public:
+  Binary(const L &lhs, const R &rhs) : m_lhs(lhs), m_rhs(rhs) {
+    if (m_lhs.size() != 0 && m_rhs.size() != 0 && m_lhs.size() != m_rhs.size()) {
+      throw std::invalid_argument("Field expression: operands have different sizes " + std::to_string(m_lhs.size()) +
+                                  " and " + std::to_string(m_rhs.size()) + ".");
+    }
+  }
+  PFC_EXPR_INLINE auto operator[](size_t i) const { return Op::apply(m_lhs[i], m_rhs[i]); }
+  size_t size() const { return m_lhs.size() != 0 ? m_lhs.size() : m_rhs.size(); }
+};
+
+/**
+ * @brief Elementwise function of an expression, see map().
+ */
+template <typename Func, typename E> class Map : public Expression<Map<Func, E>> {
+private:
+  Func m_func;
+  E m_expr;
+
+public:
+  Map(Func func, const E &expr) : m_func(std::move(func)), m_expr(expr) {}
+  PFC_EXPR_INLINE auto operator[](size_t i) const { return m_func(m_expr[i]); }
+  size_t size() const { return m_expr.size(); }
+};
+
+struct Add {
+  template <typename A, typename B> PFC_EXPR_INLINE static auto apply(const A &a, const B &b) { return a + b; }
+};
+
+struct Subtract {
+  template <typename A, typename B> PFC_EXPR_INLINE static auto apply(const A &a, const B &b) { return a - b; }
+};
+
+struct Multiply {
+  template <typename A, typename B> PFC_EXPR_INLINE static auto apply(const A &a, const B &b) { return a * b; }
+};
+
+struct Divide {
+  template <typename A, typename B> PFC_EXPR_INLINE static auto apply(const A &a, const B &b) { return a / b; }
+};
+
+/**
+ * @brief Wraps a field as an operand of expressions.
+ */
+template <typename T, typename A> Terminal<T> ref(const std::vector<T, A> &field) {
+  return Terminal<T>(field.data(), field.size());
+}
+
+template <typename T, size_t D> Terminal<T> ref(Array<T, D> &array) { return ref(array.get_data()); }
+
+/**
+ * @brief Applies a pointwise function to an expression, e.g.
+ * `map([](double x) { return std::exp(x); }, -k * u)`.
+ */
+template <typename Func, typename E> Map<Func, E> map(Func func, const Expression<E> &e) {
+  return Map<Func, E>(std::move(func), e.self());
+}
+
+template <typename E> auto operator-(const Expression<E> &e) {
+  return map([](const auto &x) { return -x; }, e);
+}
+
+#define PFC_EXPR_BINARY_OPERATOR(OP, NAME)                                                                             \
+  template <typename L, typename R>                                                                                    \
+  Binary<NAME, L, R> operator OP(const Expression<L> &l, const Expression<R> &r) {                                     \
+    return Binary<NAME, L, R>(l.self(), r.self());                                                                     \
+  }                                                                                                                    \
+  template <typename L, typename S, typename = std::enable_if_t<is_scalar_v<S>>>                                       \
+  Binary<NAME, L, Scalar<S>> operator OP(const Expression<L> &l, S s) {                                                \
+    return Binary<NAME, L, Scalar<S>>(l.self(), Scalar<S>(s));                                                         \
+  }                                                                                                                    \
+  template <typename S, typename R, typename = std::enable_if_t<is_scalar_v<S>>>                                       \
+  Binary<NAME, Scalar<S>, R> operator OP(S s, const Expression<R> &r) {                                                \
+    return Binary<NAME, Scalar<S>, R>(Scalar<S>(s), r.self());                                                         \
+  }
+
+PFC_EXPR_BINARY_OPERATOR(+, Add)
+PFC_EXPR_BINARY_OPERATOR(-, Subtract)
+PFC_EXPR_BINARY_OPERATOR(*, Multiply)
+PFC_EXPR_BINARY_OPERATOR(/, Divide)
+
+#undef PFC_EXPR_BINARY_OPERATOR
+
+/**
+ * @brief Evaluates an expression into a field in one loop, distributed over
+ * the threads like parallel_for().
+ *
+ * @param out Output field, may also appear in the expression.
+ * @param e Expression to evaluate.
+ * @throws std::invalid_argument if the size of the expression differs from
+ * the size of the output.
+ */
+template <typename T, typename A, typename E> void assign(std::vector<T, A> &out, const Expression<E> &e) {
+  const E &expr = e.self();
+  if (expr.size() != 0 && expr.size() != out.size()) {
+    throw std::invalid_argument("Field expression: cannot assign expression of size " + std::to_string(expr.size()) +
+                                " to field of size " + std::to_string(out.size()) + ".");
+  }
+  // Every iteration only reads and writes element i, so there are no
+  // dependencies between iterations even if the output is also an input. This
+  // is told to the compiler explicitly: each field operand would otherwise
+  // need a runtime alias check, and larger expressions exceed the number of
+  // checks the compiler is willing to do and are not vectorized.
+  T *data = out.data();
+  const long long n = static_cast<long long>(out.size());
+#if defined(_OPENMP)
+#pragma omp parallel for simd schedule(static)
+#elif defined(__clang__)
+#pragma clang loop vectorize(assume_safety)
+#elif defined(__GNUC__)
+#pragma GCC ivdep
+#endif
+  for (long long i = 0; i < n; i++) data[i] = static_cast<T>(expr[i]);
+}
+
+template <typename T, size_t D, typename E> void assign(Array<T, D> &out, const Expression<E> &e) {
+  assign(out.get_data(), e);
+}
+
+} // namespace expr
+} // namespace pfc
+
+#endif
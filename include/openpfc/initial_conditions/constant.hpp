@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../field_modifier.hpp"
+#include "../parallel.hpp"
 
 namespace pfc {
 
@@ -49,7 +50,7 @@ public:
    */
   void apply(Model &m, double) override {
     Field &field = m.get_real_field(get_field_name());
-    std::fill(field.begin(), field.end(), m_n0);
+    parallel_for(field.size(), [&](size_t idx) { field[idx] = m_n0; });
   }
 };
 
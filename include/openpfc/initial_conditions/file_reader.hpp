@@ -23,7 +23,7 @@ public:
     const Decomposition &d = m.get_decomposition();
     Field &f = m.get_real_field(get_field_name());
     std::cout << "Reading initial condition from file" << get_filename() << std::endl;
-    BinaryReader reader;
+    BinaryReader reader(m.get_comm());
     reader.set_domain(d.get_world().get_size(), d.inbox.size, d.inbox.low);
     reader.read(get_filename(), f);
   }
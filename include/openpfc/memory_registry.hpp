@@ -0,0 +1,223 @@
+#ifndef PFC_MEMORY_REGISTRY_HPP
+#define PFC_MEMORY_REGISTRY_HPP
+
+#include "allocator.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+namespace pfc {
+
+namespace memory {
+
+namespace detail {
+/**
+ * @brief Reads a value in kB from /proc/self/status, e.g. key "VmRSS:", and
+ * returns it in bytes, or 0 if it is not available.
+ */
+inline size_t read_proc_status(const std::string &key) {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, key.size(), key) == 0) {
+      std::istringstream values(line.substr(key.size()));
+      size_t kb = 0;
+      values >> kb;
+      return kb * 1024;
+    }
+  }
+  return 0;
+}
+} // namespace detail
+
+/**
+ * @brief Returns the resident set size of this process in bytes, or 0 if
+ * not available (only Linux provides it).
+ */
+inline size_t get_rss() { return detail::read_proc_status("VmRSS:"); }
+
+/**
+ * @brief Returns the peak resident set size of this process in bytes, or 0
+ * if not available.
+ */
+inline size_t get_peak_rss() { return detail::read_proc_status("VmHWM:"); }
+
+} // namespace memory
+
+/**
+ * @brief Central registry of the large buffers of a process, for reporting
+ * where the memory goes.
+ *
+ * Buffers are registered by category and name, e.g. the fields and operator
+ * tables of a model and the FFT workspace:
+ *
+ * @code
+ * MemoryRegistry registry;
+ * model.register_memory(registry);
+ * fft.register_memory(registry);
+ * registry.print_report(std::cout, comm, "Memory after initialization");
+ * @endcode
+ *
+ * The report shows each entry, the registered total, the bytes allocated with
+ * FieldAllocator and the resident set size of the process, as minimum,
+ * average and maximum over the ranks. Memory not registered anywhere, e.g.
+ * the buffers of MPI and heFFTe, shows up as the difference between the
+ * resident set size and the registered total. App prints the report after
+ * the model is initialized and at exit.
+ */
+class MemoryRegistry {
+public:
+  /**
+   * @brief A registered buffer.
+   */
+  struct Entry {
+    std::string category; /**< Category, e.g. "fields" or "operators". */
+    std::string name;     /**< Name of the buffer within the category. */
+    size_t bytes;         /**< Size of the buffer in bytes. */
+  };
+
+private:
+  std::vector<Entry> m_entries;
+
+  std::vector<Entry>::iterator find(const std::string &category, const std::string &name) {
+    return std::find_if(m_entries.begin(), m_entries.end(),
+                        [&](const Entry &e) { return e.category == category && e.name == name; });
+  }
+
+public:
+  /**
+   * @brief Registers a buffer, or updates its size if it is already
+   * registered.
+   */
+  void set(const std::string &category, const std::string &name, size_t bytes) {
+    auto it = find(category, name);
+    if (it == m_entries.end()) {
+      m_entries.push_back({category, name, bytes});
+    } else {
+      it->bytes = bytes;
+    }
+  }
+
+  /**
+   * @brief Registers the allocated memory of a vector.
+   */
+  template <typename T, typename A>
+  void set(const std::string &category, const std::string &name, const std::vector<T, A> &data) {
+    set(category, name, data.capacity() * sizeof(T));
+  }
+
+  /**
+   * @brief Removes a buffer. Does nothing if it is not registered.
+   */
+  void remove(const std::string &category, const std::string &name) {
+    auto it = find(category, name);
+    if (it != m_entries.end()) m_entries.erase(it);
+  }
+
+  void clear() { m_entries.clear(); }
+
+  const std::vector<Entry> &get_entries() const { return m_entries; }
+
+  /**
+   * @brief Returns the size of a buffer, or 0 if it is not registered.
+   */
+  size_t get_bytes(const std::string &category, const std::string &name) const {
+    for (const Entry &e : m_entries) {
+      if (e.category == category && e.name == name) return e.bytes;
+    }
+    return 0;
+  }
+
+  /**
+   * @brief Returns the total size of the buffers of a category.
+   */
+  size_t get_total(const std::string &category) const {
+    size_t bytes = 0;
+    for (const Entry &e : m_entries) {
+      if (e.category == category) bytes += e.bytes;
+    }
+    return bytes;
+  }
+
+  /**
+   * @brief Returns the total size of all buffers.
+   */
+  size_t get_total() const {
+    size_t bytes = 0;
+    for (const Entry &e : m_entries) bytes += e.bytes;
+    return bytes;
+  }
+
+  /**
+   * @brief Prints the minimum, average and maximum memory usage per rank,
+   * on rank 0 of comm. Collective over comm.
+   *
+   * The entries are listed only if all ranks have the same number of entries,
+   * otherwise only the totals are.
+   *
+   * @param os Output stream, written on rank 0 only.
+   * @param comm Communicator over which the usage is reduced.
+   * @param title First line of the report.
+   */
+  void print_report(std::ostream &os, MPI_Comm comm, const std::string &title) const {
+    std::vector<Entry> entries = m_entries;
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+      return a.category != b.category ? a.category < b.category : a.name < b.name;
+    });
+    int count = static_cast<int>(entries.size()), min_count = 0, max_count = 0;
+    MPI_Allreduce(&count, &min_count, 1, MPI_INT, MPI_MIN, comm);
+    MPI_Allreduce(&count, &max_count, 1, MPI_INT, MPI_MAX, comm);
+    if (min_count != max_count) entries.clear();
+
+    std::vector<std::string> labels;
+    std::vector<double> local;
+    for (const Entry &e : entries) {
+      labels.push_back(e.category + ": " + e.name);
+      local.push_back(static_cast<double>(e.bytes));
+    }
+    labels.insert(labels.end(), {"registered total", "field allocator", "field allocator (peak)", "resident set size",
+                                 "resident set size (peak)"});
+    local.insert(local.end(), {static_cast<double>(get_total()), static_cast<double>(memory::get_allocated_bytes()),
+                               static_cast<double>(memory::get_peak_allocated_bytes()),
+                               static_cast<double>(memory::get_rss()), static_cast<double>(memory::get_peak_rss())});
+
+    const int n = static_cast<int>(local.size());
+    std::vector<double> min(n), max(n), sum(n);
+    MPI_Reduce(local.data(), min.data(), n, MPI_DOUBLE, MPI_MIN, 0, comm);
+    MPI_Reduce(local.data(), max.data(), n, MPI_DOUBLE, MPI_MAX, 0, comm);
+    MPI_Reduce(local.data(), sum.data(), n, MPI_DOUBLE, MPI_SUM, 0, comm);
+    int rank = 0, num_ranks = 1;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_ranks);
+    if (rank != 0) return;
+
+    size_t width = 0;
+    for (const std::string &label : labels) width = std::max(width, label.size());
+    const double MiB = 1024.0 * 1024.0;
+    const auto old_flags = os.flags();
+    const auto old_precision = os.precision(1);
+    os << title << " (MiB per rank):\n";
+    os << "  " << std::left << std::setw(static_cast<int>(width)) << "" << std::right << std::setw(12) << "min"
+       << std::setw(12) << "avg" << std::setw(12) << "max" << "\n";
+    for (int i = 0; i < n; i++) {
+      os << "  " << std::left << std::setw(static_cast<int>(width)) << labels[i] << std::right << std::fixed
+         << std::setw(12) << min[i] / MiB << std::setw(12) << sum[i] / num_ranks / MiB << std::setw(12)
+         << max[i] / MiB << "\n";
+    }
+    if (min_count != max_count) os << "  (ranks have different entries, only totals are shown)\n";
+    os.flags(old_flags);
+    os.precision(old_precision);
+  }
+};
+
+} // namespace pfc
+
+#endif
@@ -1,10 +1,20 @@
 #ifndef PFC_MODEL_HPP
 #define PFC_MODEL_HPP
 
+#include <algorithm>
+#include <complex>
+#include <iostream>
+#include <map>
 #include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
+#include "buffer_plan.hpp"
 #include "decomposition.hpp"
 #include "fft.hpp"
+#include "memory_registry.hpp"
+#include "operators.hpp"
 #include "types.hpp"
 #include "world.hpp"
 
@@ -29,11 +39,27 @@ namespace pfc {
  */
 class Model {
 private:
-  FFT *m_fft = nullptr;             ///< Raw pointer to the FFT object used by the model
-  RealFieldSet m_real_fields;       ///< Collection of real-valued fields associated
-                                    ///< with the model
-  ComplexFieldSet m_complex_fields; ///< Collection of complex-valued fields
-                                    ///< associated with the model
+  FFT *m_fft = nullptr;                            ///< Raw pointer to the FFT object used by the model
+  RealFieldSet m_real_fields;                      ///< Collection of real-valued fields associated
+                                                   ///< with the model
+  ComplexFieldSet m_complex_fields;                ///< Collection of complex-valued fields
+                                                   ///< associated with the model
+  /// Temporary real arrays of step
+  BufferPlan<double, RealField::allocator_type> m_real_work;
+  /// Temporary complex arrays of step
+  BufferPlan<std::complex<double>, ComplexField::allocator_type> m_complex_work;
+
+  template <typename FieldSet> static void register_fields(MemoryRegistry &registry, const FieldSet &fields) {
+    std::map<const void *, std::vector<std::string>> names;
+    for (const auto &field : fields) names[&field.second].push_back(field.first);
+    for (auto &aliases : names) {
+      std::sort(aliases.second.begin(), aliases.second.end());
+      std::string name = aliases.second[0];
+      for (size_t i = 1; i < aliases.second.size(); i++) name += "/" + aliases.second[i];
+      const auto &field = fields.find(aliases.second[0])->second;
+      registry.set("fields", name, field);
+    }
+  }
 
 public:
   bool rank0 = false; ///< Flag indicating if the current MPI rank is 0 (useful
@@ -65,6 +91,104 @@ public:
    */
   const Decomposition &get_decomposition() { return get_fft().get_decomposition(); }
 
+  /**
+   * @brief Get the MPI communicator the model runs on, i.e. the communicator
+   * of the FFT object. Collective operations inside models and field modifiers
+   * should use this instead of MPI_COMM_WORLD.
+   *
+   * @return The MPI communicator
+   */
+  MPI_Comm get_comm() { return get_fft().get_comm(); }
+
+  /**
+   * @brief Fills an operator on the local outbox from a function of the
+   * wavenumbers, see pfc::fill_operator.
+   *
+   * @param op Operator to fill.
+   * @param func Function called as `func(kx, ky, kz, k2)`.
+   */
+  template <typename T, typename A, typename Func> void fill_operator(std::vector<T, A> &op, Func &&func) {
+    pfc::fill_operator(get_decomposition(), op, std::forward<Func>(func));
+  }
+
+  /**
+   * @brief Declares a temporary real array of the size of the inbox, used
+   * from stage first to stage last of step, see BufferPlan. Arrays with
+   * non-overlapping lifetimes share memory after allocate_work_arrays().
+   *
+   * With count > 1, the array holds count fields packed one after another,
+   * which FFT::forward_batch() and FFT::backward_batch() transform as one batch
+   * without copies.
+   *
+   * @param name Name of the array.
+   * @param first First stage where the array is used.
+   * @param last Last stage where the array is used.
+   * @param count Number of fields in the array.
+   */
+  void add_real_work_array(const std::string &name, int first, int last, size_t count = 1) {
+    m_real_work.declare(name, count * get_fft().size_inbox(), first, last);
+  }
+
+  /**
+   * @brief Declares a temporary complex array of the size of the outbox, or
+   * count times that, see add_real_work_array().
+   */
+  void add_complex_work_array(const std::string &name, int first, int last, size_t count = 1) {
+    m_complex_work.declare(name, count * get_fft().size_outbox(), first, last);
+  }
+
+  /**
+   * @brief Assigns the declared work arrays to buffers and allocates them.
+   * Rank 0 reports how much memory the aliasing saves.
+   *
+   * @return Bytes allocated for the work arrays on this rank.
+   */
+  size_t allocate_work_arrays() {
+    m_real_work.allocate();
+    m_complex_work.allocate();
+    size_t requested = m_real_work.get_requested_bytes() + m_complex_work.get_requested_bytes();
+    size_t allocated = m_real_work.get_allocated_bytes() + m_complex_work.get_allocated_bytes();
+    if (rank0 && requested > 0) {
+      std::cout << "Work arrays: " << m_real_work.num_arrays() + m_complex_work.num_arrays() << " arrays in "
+                << m_real_work.num_buffers() + m_complex_work.num_buffers() << " buffers, "
+                << allocated / (1024.0 * 1024.0) << " MB instead of " << requested / (1024.0 * 1024.0)
+                << " MB per rank" << std::endl;
+    }
+    return allocated;
+  }
+
+  /**
+   * @brief Returns a work array declared with add_real_work_array().
+   */
+  RealField &get_real_work_array(const std::string &name) { return m_real_work.get(name); }
+
+  /**
+   * @brief Returns a work array declared with add_complex_work_array().
+   */
+  ComplexField &get_complex_work_array(const std::string &name) { return m_complex_work.get(name); }
+
+  /**
+   * @brief Registers the memory of the model: the fields, under category
+   * "fields", and the buffers of the work arrays, under "work arrays". A field
+   * added under several names is registered once, with the names joined by
+   * '/'.
+   *
+   * Models override this to register their other large buffers, e.g.
+   * operator tables, and call the base class version for the rest.
+   *
+   * @param registry Registry to add the buffers to.
+   */
+  virtual void register_memory(MemoryRegistry &registry) const {
+    register_fields(registry, m_real_fields);
+    register_fields(registry, m_complex_fields);
+    for (size_t b = 0; b < m_real_work.num_buffers(); b++) {
+      registry.set("work arrays", m_real_work.get_buffer_name(b), m_real_work.get_buffer_bytes(b));
+    }
+    for (size_t b = 0; b < m_complex_work.num_buffers(); b++) {
+      registry.set("work arrays", m_complex_work.get_buffer_name(b), m_complex_work.get_buffer_bytes(b));
+    }
+  }
+
   /**
    * @brief Get the world object associated with the model.
    *
@@ -91,7 +215,6 @@ public:
     if (m_fft == nullptr) {
       throw std::runtime_error("FFT object has not been set.");
     }
-    m_fft->reset_fft_time();
     return *m_fft;
   }
 
@@ -117,6 +240,49 @@ public:
    */
   virtual void initialize(double dt) = 0;
 
+  /**
+   * @brief Changes the time step of the following steps.
+   *
+   * Called with variable time steps before every step whose size differs
+   * from the previous one and equals the time step of Time, see
+   * Simulator::advance_time() and set_transient_dt(). Models whose
+   * operators depend on the time step rebuild them here, or select them from
+   * an OperatorCache. The default implementation does not support variable
+   * time steps.
+   *
+   * @param dt Time step size of the following steps
+   * @throws std::runtime_error if the model does not support variable time
+   * steps.
+   */
+  virtual void set_dt(double dt) {
+    throw std::runtime_error("Model does not support variable time steps, cannot change time step to " +
+                             std::to_string(dt) + ".");
+  }
+
+  /**
+   * @brief Changes the time step of the following steps to a transient
+   * value: steps which are shortened to end exactly at a save time or at the
+   * end of the simulation, see Time::get_step_dt(). Their sizes are one-offs,
+   * so models should not cache operators calculated for them. set_dt() is
+   * called again when the steps return to the regular time step.
+   *
+   * The default implementation calls set_dt().
+   *
+   * @param dt Size of the shortened step
+   */
+  virtual void set_transient_dt(double dt) { set_dt(dt); }
+
+  /**
+   * @brief Returns an estimate of the error of the last step, for adaptive
+   * time stepping, see TimeStepController. Must return the same value on all
+   * ranks.
+   *
+   * @throws std::runtime_error if the model does not provide an estimate.
+   */
+  virtual double get_step_error() {
+    throw std::runtime_error("Model does not provide an error estimate of the step.");
+  }
+
   /**
    * @brief Check if the model has a real-valued field with the given name.
    *
@@ -154,16 +320,32 @@ public:
    *
    * @param name Name of the field
    * @return Reference to the RealField object
+   * @throws std::invalid_argument if the model has no real-valued field
+   * with the given name.
    */
-  RealField &get_real_field(const std::string &name) { return m_real_fields.find(name)->second; }
+  RealField &get_real_field(const std::string &name) {
+    auto it = m_real_fields.find(name);
+    if (it == m_real_fields.end()) {
+      throw std::invalid_argument("Model has no real-valued field '" + name + "'.");
+    }
+    return it->second;
+  }
 
   /**
    * @brief Get a reference to the complex-valued field with the given name.
    *
    * @param name Name of the field
    * @return Reference to the ComplexField object
+   * @throws std::invalid_argument if the model has no complex-valued field
+   * with the given name.
    */
-  ComplexField &get_complex_field(const std::string &name) { return m_complex_fields.find(name)->second; }
+  ComplexField &get_complex_field(const std::string &name) {
+    auto it = m_complex_fields.find(name);
+    if (it == m_complex_fields.end()) {
+      throw std::invalid_argument("Model has no complex-valued field '" + name + "'.");
+    }
+    return it->second;
+  }
 
   /**
    * @brief Add a field to the model.
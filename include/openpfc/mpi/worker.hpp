@@ -2,6 +2,8 @@
 
 #include <mpi.h>
 
+#include "../parallel.hpp"
+
 #include <iostream>
 
 namespace pfc {
@@ -14,9 +16,11 @@ namespace pfc {
  * rank and number of processes in the MPI communicator.
  */
 class MPI_Worker {
-  MPI_Comm m_comm; ///< MPI communicator for this worker
-  int m_rank;      ///< Rank of this worker process in the MPI communicator
-  int m_num_procs; ///< Number of processes in the MPI communicator
+  MPI_Comm m_comm;    ///< MPI communicator for this worker
+  int m_rank;         ///< Rank of this worker process in the MPI communicator
+  int m_num_procs;    ///< Number of processes in the MPI communicator
+  int m_thread_level; ///< Thread support level provided by the MPI library
+  bool m_owns_mpi;    ///< MPI was initialized by this worker and is finalized by it
 
 public:
   /**
@@ -26,25 +30,46 @@ public:
    * processes in the given MPI communicator. If the rank is not zero, the
    * standard output is muted to avoid duplicate output.
    *
+   * MPI is initialized with MPI_THREAD_FUNNELED, so that each rank may run
+   * threaded loops (see parallel_for()) as long as only the main thread makes
+   * MPI calls.
+   *
+   * If MPI is already initialized, e.g. by an enclosing ensemble driver that
+   * hands a sub-communicator to each member, the worker only attaches to the
+   * communicator and leaves finalization to whoever initialized MPI.
+   *
    * @param argc Pointer to the number of command-line arguments
    * @param argv Pointer to an array of command-line arguments
    * @param comm MPI communicator to use
    */
   MPI_Worker(int argc, char *argv[], MPI_Comm comm = MPI_COMM_WORLD) : m_comm(comm) {
-    MPI_Init(&argc, &argv);
+    int initialized;
+    MPI_Initialized(&initialized);
+    m_owns_mpi = !initialized;
+    if (m_owns_mpi) {
+      MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &m_thread_level);
+    } else {
+      MPI_Query_thread(&m_thread_level);
+    }
     MPI_Comm_rank(m_comm, &m_rank);
     MPI_Comm_size(m_comm, &m_num_procs);
     if (m_rank != 0) {
       mute();
     }
-    std::cout << "MPI_Init(): initialized " << m_num_procs << " processes" << std::endl;
+    if (m_owns_mpi) std::cout << "MPI_Init(): initialized " << m_num_procs << " processes" << std::endl;
+    if (m_thread_level < MPI_THREAD_FUNNELED) {
+      std::cout << "Warning: MPI library does not support threads, running with one thread per process" << std::endl;
+      parallel::set_num_threads(1);
+    }
   }
   /**
    * @brief Destroys the MPI worker instance and finalizes MPI.
    *
-   * This destructor finalizes MPI.
+   * This destructor finalizes MPI, if it was initialized by this worker.
    */
-  ~MPI_Worker() { MPI_Finalize(); }
+  ~MPI_Worker() {
+    if (m_owns_mpi) MPI_Finalize();
+  }
 
   /**
    * @brief Returns the rank of this worker process in the MPI communicator.
@@ -60,6 +85,14 @@ public:
    */
   int get_num_ranks() const { return m_num_procs; }
 
+  /**
+   * @brief Returns the thread support level provided by the MPI library.
+   *
+   * @return One of MPI_THREAD_SINGLE, MPI_THREAD_FUNNELED,
+   * MPI_THREAD_SERIALIZED or MPI_THREAD_MULTIPLE
+   */
+  int get_thread_level() const { return m_thread_level; }
+
   /**
    * @brief Mutes the standard output.
    *
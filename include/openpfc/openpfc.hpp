@@ -1,5 +1,6 @@
 #pragma once
 
+#include "allocator.hpp"
 #include "array.hpp"
 #include "binary_reader.hpp"
 #include "boundary_conditions/fixed_bc.hpp"
@@ -8,6 +9,10 @@
 #include "decomposition.hpp"
 #include "discrete_field.hpp"
 #include "fft.hpp"
+#include "fft_autotune.hpp"
+#include "fft_backend.hpp"
+#include "fftw_wisdom.hpp"
+#include "field_expression.hpp"
 #include "field_modifier.hpp"
 #include "initial_conditions/constant.hpp"
 #include "initial_conditions/file_reader.hpp"
@@ -15,13 +20,21 @@
 #include "initial_conditions/seed.hpp"
 #include "initial_conditions/seed_grid.hpp"
 #include "initial_conditions/single_seed.hpp"
+#include "memory_registry.hpp"
 #include "model.hpp"
 #include "mpi.hpp"
 #include "multi_index.hpp"
+#include "operator_cache.hpp"
+#include "operator_table.hpp"
+#include "operators.hpp"
+#include "parallel.hpp"
 #include "results_writer.hpp"
+#include "simd.hpp"
 #include "simulator.hpp"
 #include "time.hpp"
+#include "time_step_controller.hpp"
 #include "types.hpp"
 #include "utils.hpp"
 #include "utils/show.hpp"
+#include "workspace_pool.hpp"
 #include "world.hpp"
@@ -0,0 +1,180 @@
+#ifndef PFC_OPERATOR_CACHE_HPP
+#define PFC_OPERATOR_CACHE_HPP
+
+#include "memory_registry.hpp"
+
+#include <cstddef>
+#include <list>
+#include <string>
+#include <utility>
+
+namespace pfc {
+
+/**
+ * @brief Small cache of operator sets which depend on the time step, for
+ * models used with variable time steps.
+ *
+ * Operators like the exponential integrator factors opL and opN are
+ * calculated for one dt. When the time step changes between a few levels,
+ * e.g. with TimeStepController, the sets of the previous levels are kept
+ * here, so switching back to them is a move instead of a recalculation. The
+ * cache also keeps track of the time step of the active set, so a model only
+ * supplies the calculation of a set:
+ *
+ * @code
+ * void initialize(double dt) override {
+ *   prepare_operators(dt);
+ *   m_cache.set_active_dt(dt);
+ * }
+ *
+ * void set_dt(double dt) override {
+ *   m_cache.switch_to(dt, false, m_operators, [this](double dt) { prepare_operators(dt); });
+ * }
+ * @endcode
+ *
+ * Sets are looked up by the exact value of dt. When the cache is full, the
+ * least recently stored set is dropped. Every cached set takes as much memory
+ * as the active one, so the capacity is kept small. The operators of steps
+ * shortened to end at a save time, see Model::set_transient_dt(), have
+ * one-off sizes and are not stored by switch_to().
+ *
+ * @tparam T Type of an operator set.
+ */
+template <typename T> class OperatorCache {
+private:
+  size_t m_capacity;
+  std::list<std::pair<double, T>> m_entries; // most recently stored first
+  double m_dt = 0.0;                          // time step of the active set
+  bool m_transient = false;                   // active set is of a shortened step
+
+public:
+  /**
+   * @brief Constructs a cache of at most capacity operator sets. With zero
+   * capacity nothing is cached.
+   */
+  explicit OperatorCache(size_t capacity = 4) : m_capacity(capacity) {}
+
+  void set_capacity(size_t capacity) {
+    m_capacity = capacity;
+    while (m_entries.size() > m_capacity) m_entries.pop_back();
+  }
+
+  size_t get_capacity() const { return m_capacity; }
+
+  /**
+   * @brief Returns the number of cached sets.
+   */
+  size_t size() const { return m_entries.size(); }
+
+  bool contains(double dt) const {
+    for (const auto &entry : m_entries) {
+      if (entry.first == dt) return true;
+    }
+    return false;
+  }
+
+  /**
+   * @brief Stores the operator set of dt, replacing a set already stored for
+   * it.
+   */
+  void put(double dt, T &&ops) {
+    if (m_capacity == 0) return;
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+      if (it->first == dt) {
+        m_entries.erase(it);
+        break;
+      }
+    }
+    m_entries.emplace_front(dt, std::move(ops));
+    if (m_entries.size() > m_capacity) m_entries.pop_back();
+  }
+
+  /**
+   * @brief Moves the operator set of dt out of the cache.
+   *
+   * @param dt Time step of the set.
+   * @param ops Receives the set if it is cached, left untouched otherwise.
+   * @return True if the set was cached.
+   */
+  bool take(double dt, T &ops) {
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+      if (it->first == dt) {
+        ops = std::move(it->second);
+        m_entries.erase(it);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void clear() { m_entries.clear(); }
+
+  /**
+   * @brief Sets the time step of the active operator set, e.g. after it has
+   * been calculated in Model::initialize().
+   */
+  void set_active_dt(double dt) {
+    m_dt = dt;
+    m_transient = false;
+  }
+
+  double get_active_dt() const { return m_dt; }
+
+  /**
+   * @brief Switches the active operator set to time step dt.
+   *
+   * The active set is stored, unless it is of a transient step. The set of dt
+   * is then taken from the cache, or calculated with rebuild(dt) if it is not
+   * cached or dt is transient.
+   *
+   * @param dt New time step.
+   * @param transient True for a step shortened to end at a save time, see
+   * Model::set_transient_dt().
+   * @param ops The active operator set.
+   * @param rebuild Callable which calculates the set of dt into ops.
+   */
+  template <typename Rebuild> void switch_to(double dt, bool transient, T &ops, Rebuild &&rebuild) {
+    if (dt == m_dt) {
+      m_transient = m_transient && transient;
+      return;
+    }
+    if (!m_transient) put(m_dt, std::move(ops));
+    if (transient || !take(dt, ops)) rebuild(dt);
+    m_dt = dt;
+    m_transient = transient;
+  }
+
+  /**
+   * @brief Registers the memory of the cached sets as the entry "cached time
+   * steps" of category "operators".
+   *
+   * @param registry Registry to add the entry to.
+   * @param register_set Callable register_set(ops, registry) which registers
+   * the tables of one set, the same way as for the active set.
+   * @param shared Name of an entry of category "operators" which is shared by
+   * all sets, e.g. the k^2 shells of radial operators, and is not counted
+   * again.
+   */
+  template <typename Func>
+  void register_memory(MemoryRegistry &registry, Func &&register_set, const std::string &shared = "") const {
+    size_t bytes = 0;
+    for (const auto &entry : m_entries) {
+      MemoryRegistry tables;
+      register_set(entry.second, tables);
+      bytes += tables.get_total() - tables.get_bytes("operators", shared);
+    }
+    registry.set("operators", "cached time steps", bytes);
+  }
+
+  /**
+   * @brief Calls func(dt, ops) for every cached set, e.g. to register their
+   * memory.
+   */
+  template <typename Func> void for_each(Func &&func) const {
+    for (const auto &entry : m_entries) func(entry.first, entry.second);
+  }
+};
+
+} // namespace pfc
+
+#endif
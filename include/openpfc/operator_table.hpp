@@ -0,0 +1,300 @@
+#ifndef PFC_OPERATOR_TABLE_HPP
+#define PFC_OPERATOR_TABLE_HPP
+
+#include "decomposition.hpp"
+#include "operators.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace pfc {
+
+/**
+ * @brief Storage for constant spectral operators, with a configurable storage
+ * precision.
+ *
+ * Operators like the exponential integrator factors opL and opN and the
+ * mean-field filter are computed once, on the outbox, and then streamed from
+ * memory in every step. With complex double fields, each double operator adds
+ * half of the bytes of a field to the traffic of the spectral update loop,
+ * and the tables take as much memory as the fields themselves. Storing them
+ * in float halves both. Values are converted to double when read, so the
+ * update itself is evaluated in double precision, only the operator values
+ * are rounded to float precision once.
+ *
+ * One table can hold several operators (channels) which are used in the
+ * same loop. The values of a mode are stored next to each other, so the loop
+ * streams one shared table instead of several separate ones:
+ *
+ * @code
+ * OperatorTable<float, 2> opLN(fft.size_outbox());
+ * for_each_wavenumber(decomp, [&](size_t idx, double, double, double, double k2) {
+ *   opLN.set(idx, std::exp(-k2 * dt), -k2 * dt);
+ * });
+ * fft.backward(psi, [&](size_t idx) {
+ *   return opLN.get<0>(idx) * psi_F[idx] + opLN.get<1>(idx) * psiN_F[idx];
+ * }, psi_F);
+ * @endcode
+ *
+ * A channel can store its values relative to a constant offset, i.e. the
+ * value is derived as offset + stored value when read. Operators which are
+ * close to a constant for most modes keep their full relative precision
+ * this way, e.g. opL = exp(-k^2 c dt) is close to 1 for small k, and rounding
+ * it to float would destroy the slow decay rates of long wavelength modes.
+ * Storing opL - 1 instead keeps them, see set_offset().
+ *
+ * @tparam T Storage type, float or double.
+ * @tparam N Number of channels.
+ */
+template <typename T, size_t N = 1> class OperatorTable {
+  static_assert(std::is_floating_point<T>::value, "OperatorTable: storage type must be a floating point type");
+  static_assert(N > 0, "OperatorTable: there must be at least one channel");
+
+private:
+  std::vector<T> m_data;
+  std::array<double, N> m_offset{};
+
+public:
+  using value_type = T;
+  static constexpr size_t channels = N;
+
+  OperatorTable() = default;
+
+  /**
+   * @brief Constructs a table of size modes, with all values zero.
+   */
+  explicit OperatorTable(size_t size) : m_data(size * N) {}
+
+  /**
+   * @brief Resizes the table to size modes.
+   */
+  void resize(size_t size) { m_data.resize(size * N); }
+
+  /**
+   * @brief Returns the number of modes.
+   */
+  size_t size() const { return m_data.size() / N; }
+
+  /**
+   * @brief Returns the size of the table in bytes.
+   */
+  size_t memory_size() const { return m_data.size() * sizeof(T); }
+
+  /**
+   * @brief Sets the offset of a channel. Must be called before the values are
+   * set, as the stored values are relative to it.
+   *
+   * @param channel Channel index.
+   * @param offset Offset added to the stored values of the channel.
+   * @throws std::invalid_argument if the channel is out of range.
+   */
+  void set_offset(size_t channel, double offset) {
+    if (channel >= N) {
+      throw std::invalid_argument("OperatorTable: channel " + std::to_string(channel) + " out of range, table has " +
+                                  std::to_string(N) + " channels.");
+    }
+    m_offset[channel] = offset;
+  }
+
+  double get_offset(size_t channel) const { return m_offset.at(channel); }
+
+  /**
+   * @brief Sets the values of all channels of a mode.
+   *
+   * @param idx Linear index of the mode in the outbox.
+   * @param values Values of the channels, in double precision.
+   */
+  template <typename... V> void set(size_t idx, V... values) {
+    static_assert(sizeof...(V) == N, "OperatorTable: number of values must match the number of channels");
+    const double v[N] = {static_cast<double>(values)...};
+    T *data = &m_data[idx * N];
+    for (size_t c = 0; c < N; c++) data[c] = static_cast<T>(v[c] - m_offset[c]);
+  }
+
+  /**
+   * @brief Returns the value of channel C of a mode, in double precision.
+   */
+  template <size_t C> double get(size_t idx) const {
+    static_assert(C < N, "OperatorTable: channel out of range");
+    return m_offset[C] + static_cast<double>(m_data[idx * N + C]);
+  }
+
+  /**
+   * @brief Returns the value of a mode of a single channel table.
+   */
+  double operator[](size_t idx) const {
+    static_assert(N == 1, "OperatorTable: operator[] requires a single channel table, use get<C>()");
+    return get<0>(idx);
+  }
+
+  /**
+   * @brief Returns the stored values, e.g. for NaN checks.
+   */
+  const std::vector<T> &get_data() const { return m_data; }
+};
+
+/**
+ * @brief The distinct values of k^2 (shells) of the local outbox, and the
+ * shell of each mode.
+ *
+ * Operators of isotropic models are functions of k^2 only. The modes of a
+ * grid fall on relatively few shells, e.g. at most 3 N^2 / 4 for an N^3 grid
+ * with equal spacing, so such an operator can be stored as one value per
+ * shell, see RadialOperatorTable. The only per-mode storage left is the shell
+ * index of 4 bytes, which is shared by all radial operators of a model.
+ *
+ * Shells are the distinct values of k^2 exactly as calculated by
+ * for_each_wavenumber(), so a radial operator gives bitwise the same values
+ * as a full table filled from the same function.
+ */
+class RadialShells {
+private:
+  std::vector<std::uint32_t> m_index;
+  std::vector<double> m_k2;
+
+public:
+  /**
+   * @brief Finds the shells of the outbox of a decomposition.
+   *
+   * @throws std::invalid_argument if the outbox has more shells than can be
+   * indexed with 32 bits.
+   */
+  explicit RadialShells(const Decomposition &decomp) {
+    std::vector<double> k2;
+    for_each_wavenumber(decomp, [&k2](size_t, double, double, double, double kSq) { k2.push_back(kSq); });
+    m_k2 = k2;
+    std::sort(m_k2.begin(), m_k2.end());
+    m_k2.erase(std::unique(m_k2.begin(), m_k2.end()), m_k2.end());
+    m_k2.shrink_to_fit();
+    if (m_k2.size() > std::numeric_limits<std::uint32_t>::max()) {
+      throw std::invalid_argument("RadialShells: too many shells (" + std::to_string(m_k2.size()) + ").");
+    }
+    m_index.resize(k2.size());
+    for (size_t idx = 0; idx < k2.size(); idx++) {
+      m_index[idx] = static_cast<std::uint32_t>(std::lower_bound(m_k2.begin(), m_k2.end(), k2[idx]) - m_k2.begin());
+    }
+  }
+
+  /**
+   * @brief Returns the number of modes.
+   */
+  size_t size() const { return m_index.size(); }
+
+  /**
+   * @brief Returns the number of shells.
+   */
+  size_t num_shells() const { return m_k2.size(); }
+
+  /**
+   * @brief Returns the shell of a mode.
+   */
+  std::uint32_t get_shell(size_t idx) const { return m_index[idx]; }
+
+  const std::vector<std::uint32_t> &get_shell_index() const { return m_index; }
+
+  /**
+   * @brief Returns k^2 of a shell. Shells are in increasing order of k^2.
+   */
+  double get_k2(size_t shell) const { return m_k2[shell]; }
+
+  /**
+   * @brief Returns the size of the shell indices and values in bytes.
+   */
+  size_t memory_size() const { return m_index.size() * sizeof(std::uint32_t) + m_k2.size() * sizeof(double); }
+};
+
+/**
+ * @brief Storage for operators which depend on k^2 only, with one value per
+ * shell instead of one per mode.
+ *
+ * Has the same read interface as OperatorTable, so the spectral update loops
+ * are the same for both. Values are set per shell instead of per mode:
+ *
+ * @code
+ * auto shells = std::make_shared<const RadialShells>(decomp);
+ * RadialOperatorTable<double, 2> opLN(shells);
+ * for (size_t s = 0; s < opLN.num_shells(); s++) {
+ *   double k2 = opLN.get_k2(s);
+ *   opLN.set_shell(s, std::exp(-k2 * dt), -k2 * dt);
+ * }
+ * fft.backward(psi, [&](size_t idx) {
+ *   return opLN.get<0>(idx) * psi_F[idx] + opLN.get<1>(idx) * psiN_F[idx];
+ * }, psi_F);
+ * @endcode
+ *
+ * Reading a value is an indexed load from the shell values, which are small
+ * compared to the outbox and mostly stay in cache.
+ *
+ * @tparam T Storage type of the shell values, float or double.
+ * @tparam N Number of channels.
+ */
+template <typename T = double, size_t N = 1> class RadialOperatorTable {
+private:
+  std::shared_ptr<const RadialShells> m_shells;
+  const std::uint32_t *m_index = nullptr;
+  OperatorTable<T, N> m_values;
+
+public:
+  using value_type = T;
+  static constexpr size_t channels = N;
+
+  RadialOperatorTable() = default;
+
+  /**
+   * @brief Constructs a table on the given shells, with all values zero.
+   * Several tables can share the same shells.
+   */
+  explicit RadialOperatorTable(std::shared_ptr<const RadialShells> shells)
+      : m_shells(std::move(shells)), m_index(m_shells->get_shell_index().data()), m_values(m_shells->num_shells()) {}
+
+  /**
+   * @brief Returns the number of modes.
+   */
+  size_t size() const { return m_shells ? m_shells->size() : 0; }
+
+  size_t num_shells() const { return m_values.size(); }
+
+  double get_k2(size_t shell) const { return m_shells->get_k2(shell); }
+
+  /**
+   * @brief Returns the size of the shell values in bytes. The shells
+   * themselves are shared and not included, see RadialShells::memory_size().
+   */
+  size_t memory_size() const { return m_values.memory_size(); }
+
+  void set_offset(size_t channel, double offset) { m_values.set_offset(channel, offset); }
+
+  double get_offset(size_t channel) const { return m_values.get_offset(channel); }
+
+  /**
+   * @brief Sets the values of all channels of a shell.
+   */
+  template <typename... V> void set_shell(size_t shell, V... values) { m_values.set(shell, values...); }
+
+  /**
+   * @brief Returns the value of channel C of a mode, in double precision.
+   */
+  template <size_t C> double get(size_t idx) const { return m_values.template get<C>(m_index[idx]); }
+
+  double operator[](size_t idx) const {
+    static_assert(N == 1, "RadialOperatorTable: operator[] requires a single channel table, use get<C>()");
+    return get<0>(idx);
+  }
+
+  /**
+   * @brief Returns the values of the shells, e.g. for NaN checks.
+   */
+  const std::vector<T> &get_data() const { return m_values.get_data(); }
+};
+
+} // namespace pfc
+
+#endif
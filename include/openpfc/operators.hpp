@@ -0,0 +1,78 @@
+#ifndef PFC_OPERATORS_HPP
+#define PFC_OPERATORS_HPP
+
+#include "decomposition.hpp"
+
+#include <array>
+#include <stdexcept>
+#include <vector>
+
+namespace pfc {
+
+/**
+ * @brief Calls a function for every mode of the local outbox, in memory order.
+ *
+ * The function is called as `func(idx, kx, ky, kz, k2)`, where idx is the
+ * linear index of the mode in the outbox, kx, ky, kz are the wavenumbers and
+ * k2 = kx^2 + ky^2 + kz^2. Wavenumbers come from the tables cached in the
+ * Decomposition instead of being recalculated for every mode, and the
+ * innermost loop runs over the contiguous axis of the outbox as a plain
+ * indexed loop, which the compiler can vectorize when the function is inlined.
+ *
+ * @code
+ * for_each_wavenumber(decomp, [&](size_t idx, double, double, double, double k2) {
+ *   opL[idx] = std::exp(-k2 * dt);
+ *   opN[idx] = -k2 * dt;
+ * });
+ * @endcode
+ *
+ * @param decomp Decomposition defining the outbox.
+ * @param func Function to call.
+ */
+template <typename Func> void for_each_wavenumber(const Decomposition &decomp, Func &&func) {
+  const std::array<int, 3> &order = decomp.outbox.order;
+  const std::vector<double> &k_inner = decomp.get_wavenumbers(order[0]);
+  const std::vector<double> &k_middle = decomp.get_wavenumbers(order[1]);
+  const std::vector<double> &k_outer = decomp.get_wavenumbers(order[2]);
+  const size_t n = k_inner.size();
+  std::array<double, 3> k;
+  size_t idx = 0;
+  for (size_t c2 = 0; c2 < k_outer.size(); c2++) {
+    k[order[2]] = k_outer[c2];
+    for (size_t c1 = 0; c1 < k_middle.size(); c1++) {
+      k[order[1]] = k_middle[c1];
+      for (size_t c0 = 0; c0 < n; c0++) {
+        k[order[0]] = k_inner[c0];
+        func(idx + c0, k[0], k[1], k[2], k[0] * k[0] + k[1] * k[1] + k[2] * k[2]);
+      }
+      idx += n;
+    }
+  }
+}
+
+/**
+ * @brief Fills an operator on the local outbox from a function of the
+ * wavenumbers.
+ *
+ * @code
+ * fill_operator(decomp, opL, [&](double, double, double, double k2) { return std::exp(-k2 * dt); });
+ * @endcode
+ *
+ * @param decomp Decomposition defining the outbox.
+ * @param op Operator to fill, resized to the size of the outbox if needed.
+ * @param func Function called as `func(kx, ky, kz, k2)`, returning the value
+ * of the operator at the mode.
+ */
+template <typename T, typename A, typename Func>
+void fill_operator(const Decomposition &decomp, std::vector<T, A> &op, Func &&func) {
+  const auto &size = decomp.get_outbox_size();
+  const size_t n = static_cast<size_t>(size[0]) * size[1] * size[2];
+  if (op.size() != n) op.resize(n);
+  for_each_wavenumber(decomp, [&op, &func](size_t idx, double kx, double ky, double kz, double k2) {
+    op[idx] = static_cast<T>(func(kx, ky, kz, k2));
+  });
+}
+
+} // namespace pfc
+
+#endif
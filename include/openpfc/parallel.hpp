@@ -0,0 +1,124 @@
+#ifndef PFC_PARALLEL_HPP
+#define PFC_PARALLEL_HPP
+
+#include <cstddef>
+#include <utility>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef OpenPFC_FFTW_THREADS
+#include <fftw3.h>
+#endif
+
+namespace pfc {
+
+/**
+ * @brief Thread-parallel loops for the hybrid MPI + threads execution mode.
+ *
+ * With OpenMP enabled (CMake option `OpenPFC_ENABLE_OPENMP`), each MPI rank
+ * runs the pointwise loops of models and field modifiers with several threads.
+ * Running e.g. 4-8 threads per rank instead of one rank per core divides the
+ * number of ranks, and with that the number of messages in the FFT reshapes,
+ * by the same factor. The number of threads is taken from OMP_NUM_THREADS or
+ * set with set_num_threads(). Without OpenMP, the loops run serially.
+ *
+ * Only the thread doing the MPI calls may call MPI (MPI_THREAD_FUNNELED, see
+ * MPI_Worker), so functions passed to the loops must not communicate.
+ */
+namespace parallel {
+
+/**
+ * @brief Returns true if the library was compiled with OpenMP.
+ */
+constexpr bool is_enabled() {
+#ifdef _OPENMP
+  return true;
+#else
+  return false;
+#endif
+}
+
+/**
+ * @brief Returns the number of threads used by the parallel loops.
+ */
+inline int get_num_threads() {
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+/**
+ * @brief Sets the number of threads used by the parallel loops. Ignored
+ * without OpenMP.
+ */
+inline void set_num_threads(int num_threads) {
+#ifdef _OPENMP
+  if (num_threads > 0) omp_set_num_threads(num_threads);
+#else
+  (void)num_threads;
+#endif
+}
+
+/**
+ * @brief Lets FFTW use threads inside the local transforms of HeFFTe.
+ *
+ * Must be called before the FFT objects are constructed, as the number of
+ * threads is fixed when the FFTW plans are created. Requires the FFTW thread
+ * library (CMake option `OpenPFC_ENABLE_FFTW_THREADS`).
+ *
+ * @param num_threads Number of threads per FFTW plan.
+ * @return true if FFTW was set up to use threads.
+ */
+inline bool init_fftw_threads(int num_threads) {
+#ifdef OpenPFC_FFTW_THREADS
+  static bool initialized = fftw_init_threads() != 0 && fftwf_init_threads() != 0;
+  if (!initialized) return false;
+  fftw_plan_with_nthreads(num_threads);
+  fftwf_plan_with_nthreads(num_threads);
+  return true;
+#else
+  (void)num_threads;
+  return false;
+#endif
+}
+
+} // namespace parallel
+
+/**
+ * @brief Calls func(i) for i in [begin, end), distributing the iterations
+ * statically over the threads.
+ *
+ * The iterations must be independent of each other. Static scheduling gives
+ * each thread the same contiguous range in every loop over the same array, so
+ * data first touched by one thread stays local to it.
+ *
+ * @code
+ * parallel_for(0, psiN.size(), [&](size_t idx) { psiN[idx] -= stabP * psi[idx]; });
+ * @endcode
+ *
+ * @param begin First index.
+ * @param end One past the last index.
+ * @param func Function to call for every index.
+ */
+template <typename Func> void parallel_for(size_t begin, size_t end, Func &&func) {
+#ifdef _OPENMP
+  const long long first = static_cast<long long>(begin), last = static_cast<long long>(end);
+#pragma omp parallel for schedule(static)
+  for (long long i = first; i < last; i++) func(static_cast<size_t>(i));
+#else
+  for (size_t i = begin; i < end; i++) func(i);
+#endif
+}
+
+/**
+ * @brief Calls func(i) for i in [0, n).
+ */
+template <typename Func> void parallel_for(size_t n, Func &&func) { parallel_for(0, n, std::forward<Func>(func)); }
+
+} // namespace pfc
+
+#endif
@@ -17,14 +17,24 @@ public:
   virtual void set_domain(const std::array<int, 3> &arr_global, const std::array<int, 3> &arr_local,
                           const std::array<int, 3> &arr_offset) = 0;
 
+  /**
+   * @brief Sets the communicator used to open the files. All processes of the
+   * communicator take part in writing. Simulator sets this to the
+   * communicator of the model when the writer is added.
+   */
+  void set_comm(MPI_Comm comm) { m_comm = comm; }
+
+  MPI_Comm get_comm() const { return m_comm; }
+
   virtual MPI_Status write(int increment, const RealField &data) = 0;
 
   virtual MPI_Status write(int increment, const ComplexField &data) = 0;
 
-  template <typename T> MPI_Status write(const std::vector<T> &data) { return write(0, data); }
+  template <typename T, typename A> MPI_Status write(const std::vector<T, A> &data) { return write(0, data); }
 
 protected:
   std::string m_filename;
+  MPI_Comm m_comm = MPI_COMM_WORLD;
 };
 
 class BinaryWriter : public ResultsWriter {
@@ -33,8 +43,8 @@ class BinaryWriter : public ResultsWriter {
 private:
   MPI_Datatype m_filetype;
 
-  static MPI_Datatype get_type(RealField) { return MPI_DOUBLE; }
-  static MPI_Datatype get_type(ComplexField) { return MPI_DOUBLE_COMPLEX; }
+  static MPI_Datatype get_type(const RealField &) { return MPI_DOUBLE; }
+  static MPI_Datatype get_type(const ComplexField &) { return MPI_DOUBLE_COMPLEX; }
 
 public:
   void set_domain(const std::array<int, 3> &arr_global, const std::array<int, 3> &arr_local,
@@ -48,10 +58,10 @@ public:
 
   MPI_Status write(int increment, const ComplexField &data) { return write_(increment, data); }
 
-  template <typename T> MPI_Status write_(int increment, const std::vector<T> &data) {
+  template <typename T, typename A> MPI_Status write_(int increment, const std::vector<T, A> &data) {
     MPI_File fh;
     std::string filename2 = utils::format_with_number(m_filename, increment);
-    MPI_File_open(MPI_COMM_WORLD, filename2.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh);
+    MPI_File_open(m_comm, filename2.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh);
     MPI_Offset filesize = 0;
     MPI_Status status;
     const unsigned int disp = 0;
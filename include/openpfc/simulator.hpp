@@ -4,6 +4,7 @@
 #include "model.hpp"
 #include "results_writer.hpp"
 #include "time.hpp"
+#include "time_step_controller.hpp"
 #include "world.hpp"
 #include <iostream>
 #include <memory>
@@ -25,6 +26,8 @@ private:
   std::vector<std::unique_ptr<FieldModifier>> m_initial_conditions;
   std::vector<std::unique_ptr<FieldModifier>> m_boundary_conditions;
   int m_result_counter = 0;
+  double m_model_dt; // time step the model was last given
+  std::unique_ptr<TimeStepController> m_time_step_controller;
 
 public:
   /**
@@ -33,7 +36,7 @@ public:
    * @param model The model to simulate.
    * @param time The time object to use for simulation.
    */
-  Simulator(Model &model, Time &time) : m_model(model), m_time(time) {}
+  Simulator(Model &model, Time &time) : m_model(model), m_time(time), m_model_dt(time.get_dt()) {}
 
   /**
    * @brief Get the model object
@@ -86,6 +89,7 @@ public:
   bool add_results_writer(const std::string &field_name, std::unique_ptr<ResultsWriter> writer) {
     const Decomposition &d = get_decomposition();
     writer->set_domain(d.get_world().get_size(), d.inbox.size, d.inbox.low);
+    writer->set_comm(get_fft().get_comm());
     Model &model = get_model();
     if (model.has_field(field_name)) {
       m_result_writers.insert({field_name, std::move(writer)});
@@ -224,6 +228,40 @@ public:
     }
   }
 
+  /**
+   * @brief Sets a controller which adapts the time step after every step.
+   * The model must support variable time steps, see Model::set_dt().
+   */
+  void set_time_step_controller(std::unique_ptr<TimeStepController> controller) {
+    m_time_step_controller = std::move(controller);
+  }
+
+  /**
+   * @brief Returns the time step controller, or nullptr if there is none.
+   */
+  TimeStepController *get_time_step_controller() { return m_time_step_controller.get(); }
+
+  /**
+   * @brief Advances the time by one step. If the size of the step differs
+   * from the previous one, the model is given the new size first: with
+   * Model::set_dt() if it is the time step of Time, e.g. after the time step
+   * was adapted, and with Model::set_transient_dt() if the step is shortened
+   * to end at a save time or t1.
+   */
+  void advance_time() {
+    Time &time = get_time();
+    const double dt = time.get_step_dt();
+    if (dt != m_model_dt) {
+      if (dt == time.get_dt()) {
+        get_model().set_dt(dt);
+      } else {
+        get_model().set_transient_dt(dt);
+      }
+      m_model_dt = dt;
+    }
+    time.next();
+  }
+
   void step() {
     Time &time = get_time();
     Model &model = get_model();
@@ -234,9 +272,11 @@ public:
         write_results();
       }
     }
-    time.next();
+    advance_time();
     apply_boundary_conditions();
+    if (m_time_step_controller) m_time_step_controller->before_step(model);
     model.step(time.get_current());
+    if (m_time_step_controller) m_time_step_controller->after_step(model, time);
     if (time.do_save()) {
       write_results();
     }
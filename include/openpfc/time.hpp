@@ -1,9 +1,12 @@
 #ifndef PFC_TIME_HPP
 #define PFC_TIME_HPP
 
+#include <algorithm>
 #include <array>
 #include <cmath>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 
 namespace pfc {
 
@@ -14,14 +17,63 @@ namespace pfc {
  * parameters related to time increments in simulations. It provides methods to
  * query and update the current time and check if the time interval is
  * completed.
+ *
+ * By default the time step is constant and the current time is
+ * `t0 + increment * dt`. Changing the time step with set_dt() switches to
+ * variable steps: the current time is then accumulated step by step, and
+ * steps are shortened so that they end exactly at the save times and at t1,
+ * see get_step_dt(). A model whose operators depend on the time step must be
+ * told the size of every step, see Simulator::advance_time().
  */
 class Time {
 private:
-  double m_t0;     ///< Start time
-  double m_t1;     ///< End time
-  double m_dt;     ///< Time step
-  int m_increment; ///< Current time increment
-  double m_saveat; ///< Time interval for saving data
+  double m_t0;             ///< Start time
+  double m_t1;             ///< End time
+  double m_dt;             ///< Time step
+  int m_increment;         ///< Current time increment
+  double m_saveat;         ///< Time interval for saving data
+  bool m_variable = false; ///< Time step has been changed with set_dt()
+  double m_t = 0.0;        ///< Current time with variable time steps
+  bool m_at_save = false;  ///< Last step ended at a save time, with variable time steps
+  double m_step = 0.0;     ///< Size of the last step, with variable time steps
+
+  /**
+   * @brief Returns the first save time after the current time, with variable
+   * time steps.
+   */
+  double get_next_save_time() const {
+    const double n = std::floor((m_t - m_t0) / m_saveat + 1.0e-9);
+    return m_t0 + (n + 1.0) * m_saveat;
+  }
+
+  /**
+   * @brief Returns the size of the next step, with variable time steps, and
+   * sets end to the time where it ends. The step ends at the next save time or
+   * t1 if it would reach them, otherwise it is dt. Steps which would end
+   * shortly before them are split in two equal halves, so that no tiny steps
+   * are taken.
+   *
+   * Steps which differ from dt or from the previous step only by rounding
+   * are given exactly that size, so that the model is not told of step sizes
+   * which differ only in the last digits, see Simulator::advance_time().
+   */
+  double get_step(double &end, bool &at_save) const {
+    const double save = get_next_save_time();
+    const double stop = std::min(save, m_t1);
+    const double remaining = stop - m_t;
+    double step;
+    if (remaining <= m_dt * (1.0 + 1.0e-6)) {
+      at_save = stop == save;
+      end = stop;
+      step = remaining >= m_dt * (1.0 - 1.0e-6) ? m_dt : remaining;
+    } else {
+      at_save = false;
+      step = remaining < 2.0 * m_dt ? 0.5 * remaining : m_dt;
+      end = m_t + step;
+    }
+    if (step != m_dt && std::abs(step - m_step) <= 1.0e-9 * m_step) step = m_step;
+    return step;
+  }
 
 public:
   /**
@@ -63,6 +115,41 @@ public:
    */
   double get_dt() const { return m_dt; }
 
+  /**
+   * @brief Set the time step of the following steps and switch to variable
+   * time steps.
+   *
+   * @param dt The time step
+   * @throws std::invalid_argument if dt is not positive.
+   */
+  void set_dt(double dt) {
+    if (!(dt > 0.0)) throw std::invalid_argument("Time: time step must be positive, got " + std::to_string(dt));
+    if (!m_variable) {
+      m_t = get_current();
+      m_variable = true;
+    }
+    m_dt = dt;
+  }
+
+  /**
+   * @brief Check if the time step has been changed with set_dt().
+   */
+  bool is_variable() const { return m_variable; }
+
+  /**
+   * @brief Get the size of the next step. Equals get_dt() with constant time
+   * steps. With variable time steps, the step is shortened to end at the next
+   * save time or t1.
+   *
+   * @return The size of the next step
+   */
+  double get_step_dt() const {
+    if (!m_variable) return m_dt;
+    double end;
+    bool at_save;
+    return get_step(end, at_save);
+  }
+
   /**
    * @brief Get the current time increment.
    *
@@ -75,7 +162,7 @@ public:
    *
    * @return The current time
    */
-  double get_current() const { return m_t0 + m_increment * m_dt; }
+  double get_current() const { return m_variable ? m_t : m_t0 + m_increment * m_dt; }
 
   /**
    * @brief Get the time interval for saving data.
@@ -108,17 +195,29 @@ public:
   /**
    * @brief Move to the next time increment.
    */
-  void next() { m_increment += 1; }
+  void next() {
+    if (m_variable) {
+      double end;
+      m_step = get_step(end, m_at_save);
+      m_t = end;
+    }
+    m_increment += 1;
+  }
 
   /**
    * @brief Check if data should be saved at the current time.
    *
    * Data should be saved if the current time is within the save interval,
    * or if the time interval is completed, or if it is the first increment.
+   * With variable time steps, steps end exactly at the save times, and data
+   * is saved after those steps.
    *
    * @return True if data should be saved, False otherwise
    */
-  bool do_save() const { return (std::fmod(get_current() + 1.0e-9, m_saveat) < 1.e-6) || done() || (m_increment == 0); }
+  bool do_save() const {
+    if (m_variable) return m_at_save || done() || (m_increment == 0);
+    return (std::fmod(get_current() + 1.0e-9, m_saveat) < 1.e-6) || done() || (m_increment == 0);
+  }
 
   /**
    * @brief Conversion operator to retrieve the current time as a double value.
@@ -0,0 +1,224 @@
+#ifndef PFC_TIME_STEP_CONTROLLER_HPP
+#define PFC_TIME_STEP_CONTROLLER_HPP
+
+#include "model.hpp"
+#include "time.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <mpi.h>
+
+namespace pfc {
+
+/**
+ * @brief Adaptive time step control with a small set of time step levels.
+ *
+ * The time step is one of the levels dt0 * factor^k between dt_min and dt_max,
+ * where dt0 is the initial time step. Restricting the steps to a few levels
+ * lets models keep the operators of each level in an OperatorCache instead of
+ * recalculating them at every change.
+ *
+ * After every step, the error of the step is estimated and divided by the
+ * tolerance. If the result is above 1, the next step is one level smaller.
+ * If it stays below increase_threshold / factor for `patience` consecutive
+ * steps, i.e. the error would stay below the threshold with a larger step
+ * even if it grows linearly with dt, the next step is one level larger. The
+ * step with the too large error is not repeated, so the tolerance should be
+ * chosen with some margin.
+ *
+ * The error estimate is, in order of precedence:
+ * - a user supplied criterion, see set_criterion()
+ * - Model::get_step_error(), if use_model_error is set
+ * - the largest change of a real field during the step, over all ranks
+ *
+ * @code
+ * TimeStepController controller(time.get_dt(), 1.0e-3, 1.0, 0.05);
+ * controller.set_field_name("psi");
+ * simulator.set_time_step_controller(std::make_unique<TimeStepController>(controller));
+ * @endcode
+ */
+class TimeStepController {
+private:
+  double m_dt0;
+  double m_dt_min;
+  double m_dt_max;
+  double m_tolerance;
+  double m_factor = 2.0;
+  double m_increase_threshold = 0.5;
+  int m_patience = 10;
+  int m_level = 0;
+  int m_min_level = 0;
+  int m_max_level = 0;
+  int m_calm_steps = 0;
+  double m_last_error = 0.0;
+  bool m_use_model_error = false;
+  std::string m_field_name = "default";
+  std::function<double(Model &)> m_criterion;
+  RealField m_previous;
+
+  void update_levels() {
+    const double log_factor = std::log(m_factor);
+    m_min_level = static_cast<int>(std::ceil(std::log(m_dt_min / m_dt0) / log_factor - 1.0e-9));
+    m_max_level = static_cast<int>(std::floor(std::log(m_dt_max / m_dt0) / log_factor + 1.0e-9));
+    m_level = std::clamp(m_level, m_min_level, m_max_level);
+  }
+
+public:
+  /**
+   * @brief Constructs a controller.
+   *
+   * @param dt0 Initial time step, the level 0.
+   * @param dt_min Smallest allowed time step.
+   * @param dt_max Largest allowed time step.
+   * @param tolerance Tolerance of the error estimate.
+   * @throws std::invalid_argument if the limits do not contain dt0 or the
+   * tolerance is not positive.
+   */
+  TimeStepController(double dt0, double dt_min, double dt_max, double tolerance)
+      : m_dt0(dt0), m_dt_min(dt_min), m_dt_max(dt_max), m_tolerance(tolerance) {
+    if (!(dt0 > 0.0 && dt_min > 0.0 && dt_min <= dt0 && dt0 <= dt_max)) {
+      throw std::invalid_argument("TimeStepController: time step limits must satisfy 0 < dt_min <= dt <= dt_max.");
+    }
+    if (!(tolerance > 0.0)) throw std::invalid_argument("TimeStepController: tolerance must be positive.");
+    update_levels();
+  }
+
+  /**
+   * @brief Sets the ratio of consecutive time step levels (default 2).
+   *
+   * @throws std::invalid_argument if factor is not larger than 1.
+   */
+  void set_factor(double factor) {
+    if (!(factor > 1.0)) throw std::invalid_argument("TimeStepController: factor must be larger than 1.");
+    m_factor = factor;
+    update_levels();
+  }
+
+  double get_factor() const { return m_factor; }
+
+  /**
+   * @brief Sets the number of consecutive steps with a small error before the
+   * time step is increased (default 10).
+   */
+  void set_patience(int patience) { m_patience = std::max(patience, 1); }
+
+  int get_patience() const { return m_patience; }
+
+  /**
+   * @brief Sets the error relative to the tolerance which the next larger
+   * level is expected to stay below for the time step to be increased
+   * (default 0.5).
+   */
+  void set_increase_threshold(double threshold) { m_increase_threshold = threshold; }
+
+  /**
+   * @brief Sets the real field whose change is used as the error estimate
+   * (default "default").
+   */
+  void set_field_name(const std::string &name) { m_field_name = name; }
+
+  const std::string &get_field_name() const { return m_field_name; }
+
+  /**
+   * @brief Uses Model::get_step_error() as the error estimate.
+   */
+  void set_use_model_error(bool use_model_error) { m_use_model_error = use_model_error; }
+
+  /**
+   * @brief Sets a user supplied error estimate, called after every step.
+   * Must return the same value on all ranks.
+   */
+  void set_criterion(std::function<double(Model &)> criterion) { m_criterion = std::move(criterion); }
+
+  /**
+   * @brief Returns the time step of a level.
+   */
+  double get_level_dt(int level) const { return m_dt0 * std::pow(m_factor, level); }
+
+  int get_level() const { return m_level; }
+
+  /**
+   * @brief Returns the current time step.
+   */
+  double get_dt() const { return get_level_dt(m_level); }
+
+  /**
+   * @brief Returns the error estimate of the last step.
+   */
+  double get_last_error() const { return m_last_error; }
+
+  /**
+   * @brief Updates the level from the error estimate of a step.
+   *
+   * @param error Error estimate of the step.
+   * @return The time step of the next step.
+   */
+  double propose(double error) {
+    m_last_error = error;
+    const double relative = error / m_tolerance;
+    if (relative > 1.0) {
+      m_calm_steps = 0;
+      m_level = std::max(m_level - 1, m_min_level);
+    } else if (relative * m_factor < m_increase_threshold) {
+      if (++m_calm_steps >= m_patience) {
+        m_calm_steps = 0;
+        m_level = std::min(m_level + 1, m_max_level);
+      }
+    } else {
+      m_calm_steps = 0;
+    }
+    return get_dt();
+  }
+
+  /**
+   * @brief Returns the largest absolute difference of two fields over all
+   * ranks of comm.
+   */
+  static double max_change(const RealField &before, const RealField &after, MPI_Comm comm) {
+    if (before.size() != after.size()) throw std::invalid_argument("TimeStepController: field sizes differ.");
+    double local = 0.0, global = 0.0;
+    for (size_t i = 0; i < after.size(); i++) local = std::max(local, std::abs(after[i] - before[i]));
+    MPI_Allreduce(&local, &global, 1, MPI_DOUBLE, MPI_MAX, comm);
+    return global;
+  }
+
+  /**
+   * @brief Called before a step, stores the field used for the error
+   * estimate.
+   */
+  void before_step(Model &model) {
+    if (m_criterion || m_use_model_error) return;
+    if (!model.has_real_field(m_field_name)) {
+      throw std::invalid_argument("TimeStepController: model has no real field '" + m_field_name + "'.");
+    }
+    m_previous = model.get_real_field(m_field_name);
+  }
+
+  /**
+   * @brief Called after a step, estimates its error and sets the time step
+   * of the following steps.
+   */
+  void after_step(Model &model, Time &time) {
+    double error;
+    if (m_criterion) {
+      error = m_criterion(model);
+    } else if (m_use_model_error) {
+      error = model.get_step_error();
+    } else {
+      error = max_change(m_previous, model.get_real_field(m_field_name), model.get_comm());
+    }
+    const double dt = propose(error);
+    if (dt != time.get_dt()) time.set_dt(dt);
+  }
+};
+
+} // namespace pfc
+
+#endif
@@ -0,0 +1,360 @@
+#ifndef PFC_TRANSPOSE_HPP
+#define PFC_TRANSPOSE_HPP
+
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <complex>
+#include <heffte.h>
+#include <map>
+#include <mpi.h>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace pfc {
+
+/**
+ * @brief MPI calls used to redistribute data in Transpose.
+ */
+enum class TransposeMethod {
+  alltoallw, /**< MPI_Alltoallw over the whole communicator. */
+  neighbor   /**< MPI_Neighbor_alltoallw over the ranks whose boxes overlap. */
+};
+
+/**
+ * @brief Returns the name of the transpose method.
+ */
+inline std::string to_string(TransposeMethod method) {
+  switch (method) {
+  case TransposeMethod::alltoallw: return "alltoallw";
+  case TransposeMethod::neighbor: return "neighbor";
+  }
+  throw std::invalid_argument("Unknown transpose method");
+}
+
+/**
+ * @brief Returns the transpose method with the given name.
+ *
+ * @throws std::invalid_argument if the name is not "alltoallw" or "neighbor".
+ */
+inline TransposeMethod transpose_method_from_string(const std::string &name) {
+  if (name == "alltoallw") return TransposeMethod::alltoallw;
+  if (name == "neighbor") return TransposeMethod::neighbor;
+  throw std::invalid_argument("Unknown transpose method " + name);
+}
+
+/**
+ * @brief Options of the OpenPFC transpose engine, see Transpose.
+ */
+struct TransposeOptions {
+  TransposeMethod method = TransposeMethod::alltoallw; /**< MPI calls used in the exchange. */
+  bool float_on_wire = false; /**< Send double precision data as single precision. */
+};
+
+namespace detail {
+
+/**
+ * @brief MPI description of the element types of Transpose.
+ */
+template <typename E> struct transpose_element;
+
+template <> struct transpose_element<float> {
+  using reduced_type = float;
+  static MPI_Datatype base_type() { return MPI_FLOAT; }
+  static constexpr int components = 1;
+};
+
+template <> struct transpose_element<double> {
+  using reduced_type = float;
+  static MPI_Datatype base_type() { return MPI_DOUBLE; }
+  static constexpr int components = 1;
+};
+
+template <> struct transpose_element<std::complex<float>> {
+  using reduced_type = std::complex<float>;
+  static MPI_Datatype base_type() { return MPI_FLOAT; }
+  static constexpr int components = 2;
+};
+
+template <> struct transpose_element<std::complex<double>> {
+  using reduced_type = std::complex<float>;
+  static MPI_Datatype base_type() { return MPI_DOUBLE; }
+  static constexpr int components = 2;
+};
+
+} // namespace detail
+
+/**
+ * @brief Redistribution of a distributed 3D array from one set of boxes to
+ * another, e.g. from bricks to pencils or between pencils of two directions.
+ *
+ * This is the OpenPFC counterpart of the reshapes done inside HeFFTe. Each
+ * rank describes the overlaps of its box with the boxes of the other ranks as
+ * MPI subarray datatypes, so data is packed and unpacked by MPI directly from
+ * and to the arrays, without separate pack buffers. The datatypes (and the
+ * neighbour graph of TransposeMethod::neighbor) are built once and reused in
+ * every exchange. With float_on_wire, double precision data is converted to
+ * single precision for the exchange, halving the bytes on the interconnect.
+ *
+ * Boxes are in the default HeFFTe order, x fastest, as given by
+ * heffte::split_world(). A batch of fields packed one after another is
+ * exchanged in a single call.
+ *
+ * @code
+ * Transpose<double> to_pencils(real_boxes, pencil_boxes, MPI_COMM_WORLD);
+ * to_pencils.execute(1, u.data(), u_pencil.data());
+ * @endcode
+ *
+ * @tparam E Element type: float, double, std::complex<float> or
+ * std::complex<double>.
+ */
+template <typename E> class Transpose {
+public:
+  using element_type = E;                                                   /**< Type of the data. */
+  using reduced_type = typename detail::transpose_element<E>::reduced_type; /**< Type on the wire with float_on_wire. */
+
+private:
+  /**
+   * @brief Datatypes and counts of the exchange of a batch of fields.
+   */
+  struct Exchange {
+    std::vector<int> send_counts, recv_counts, displs;
+    std::vector<MPI_Aint> neighbor_displs;
+    std::vector<MPI_Datatype> send_types, recv_types;
+  };
+
+  const MPI_Comm m_comm;                        /**< The MPI communicator. */
+  const TransposeMethod m_method;               /**< MPI calls used in the exchange. */
+  const bool m_reduced;                         /**< Convert to reduced_type for the exchange. */
+  const int m_num_ranks;                        /**< Size of the communicator. */
+  const heffte::box3d<int> m_in, m_out;         /**< Local input and output boxes. */
+  std::vector<int> m_send_ranks, m_recv_ranks;  /**< Ranks with non-empty overlaps. */
+  std::vector<heffte::box3d<int>> m_send_boxes; /**< Overlaps of the local input box with the outputs of others. */
+  std::vector<heffte::box3d<int>> m_recv_boxes; /**< Overlaps of the local output box with the inputs of others. */
+  size_t m_send_bytes = 0;                      /**< Bytes sent to other ranks per field. */
+  MPI_Comm m_graph = MPI_COMM_NULL;             /**< Neighbour graph for TransposeMethod::neighbor. */
+  mutable std::map<int, Exchange> m_exchanges;  /**< Datatypes by batch size. */
+  mutable std::vector<reduced_type> m_send_buffer, m_recv_buffer; /**< Wire buffers for float_on_wire. */
+
+  static int get_comm_rank(MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    return rank;
+  }
+
+  static int get_comm_size(MPI_Comm comm) {
+    int size;
+    MPI_Comm_size(comm, &size);
+    return size;
+  }
+
+  /**
+   * @brief Returns the boxes of the local rank, checking that there is one
+   * box per rank in the default order.
+   */
+  static const heffte::box3d<int> &get_local_box(const std::vector<heffte::box3d<int>> &boxes, MPI_Comm comm) {
+    if (boxes.size() != static_cast<size_t>(get_comm_size(comm))) {
+      throw std::invalid_argument("Transpose: number of boxes does not match the size of the communicator");
+    }
+    for (const auto &box : boxes) {
+      if (box.order != std::array<int, 3>{0, 1, 2}) {
+        throw std::invalid_argument("Transpose: boxes must be in the default order");
+      }
+    }
+    return boxes[get_comm_rank(comm)];
+  }
+
+  /**
+   * @brief Adds the intersection of the boxes to the list if it is not empty.
+   * @return true if the intersection is not empty.
+   */
+  static bool add_overlap(const heffte::box3d<int> &a, const heffte::box3d<int> &b,
+                          std::vector<heffte::box3d<int>> &overlaps) {
+    std::array<int, 3> low, high;
+    for (int axis = 0; axis < 3; axis++) {
+      low[axis] = std::max(a.low[axis], b.low[axis]);
+      high[axis] = std::min(a.high[axis], b.high[axis]);
+      if (high[axis] < low[axis]) return false;
+    }
+    overlaps.emplace_back(low, high);
+    return true;
+  }
+
+  /**
+   * @brief Creates the datatype of a sub-box of a box, for a batch of fields.
+   */
+  static MPI_Datatype make_subarray(const heffte::box3d<int> &box, const heffte::box3d<int> &sub, int batch_size,
+                                    MPI_Datatype element) {
+    int sizes[4] = {batch_size, box.size[2], box.size[1], box.size[0]};
+    int subsizes[4] = {batch_size, sub.size[2], sub.size[1], sub.size[0]};
+    int starts[4] = {0, sub.low[2] - box.low[2], sub.low[1] - box.low[1], sub.low[0] - box.low[0]};
+    MPI_Datatype type;
+    MPI_Type_create_subarray(4, sizes, subsizes, starts, MPI_ORDER_C, element, &type);
+    MPI_Type_commit(&type);
+    return type;
+  }
+
+  /**
+   * @brief Returns the datatypes of a batch, creating them on first use.
+   */
+  const Exchange &get_exchange(int batch_size) const {
+    auto it = m_exchanges.find(batch_size);
+    if (it != m_exchanges.end()) return it->second;
+    using traits = detail::transpose_element<E>;
+    MPI_Datatype element;
+    MPI_Type_contiguous(traits::components, m_reduced ? MPI_FLOAT : traits::base_type(), &element);
+    MPI_Type_commit(&element);
+    Exchange x;
+    if (m_method == TransposeMethod::alltoallw) {
+      x.send_counts.assign(m_num_ranks, 0);
+      x.recv_counts.assign(m_num_ranks, 0);
+      x.displs.assign(m_num_ranks, 0);
+      x.send_types.assign(m_num_ranks, MPI_BYTE);
+      x.recv_types.assign(m_num_ranks, MPI_BYTE);
+      for (size_t i = 0; i < m_send_ranks.size(); i++) {
+        x.send_counts[m_send_ranks[i]] = 1;
+        x.send_types[m_send_ranks[i]] = make_subarray(m_in, m_send_boxes[i], batch_size, element);
+      }
+      for (size_t i = 0; i < m_recv_ranks.size(); i++) {
+        x.recv_counts[m_recv_ranks[i]] = 1;
+        x.recv_types[m_recv_ranks[i]] = make_subarray(m_out, m_recv_boxes[i], batch_size, element);
+      }
+    } else {
+      x.send_counts.assign(m_send_ranks.size(), 1);
+      x.recv_counts.assign(m_recv_ranks.size(), 1);
+      x.neighbor_displs.assign(std::max(m_send_ranks.size(), m_recv_ranks.size()), 0);
+      for (const auto &box : m_send_boxes) x.send_types.push_back(make_subarray(m_in, box, batch_size, element));
+      for (const auto &box : m_recv_boxes) x.recv_types.push_back(make_subarray(m_out, box, batch_size, element));
+    }
+    MPI_Type_free(&element);
+    return m_exchanges.emplace(batch_size, std::move(x)).first->second;
+  }
+
+public:
+  /**
+   * @brief Constructs the transpose from the boxes of all ranks.
+   *
+   * @param in_boxes Input boxes, indexed by rank.
+   * @param out_boxes Output boxes, indexed by rank.
+   * @param comm The MPI communicator.
+   * @param options Transpose method and wire precision.
+   * @throws std::invalid_argument if the number of boxes does not match the
+   * size of the communicator or the boxes are not in the default order.
+   */
+  Transpose(const std::vector<heffte::box3d<int>> &in_boxes, const std::vector<heffte::box3d<int>> &out_boxes,
+            MPI_Comm comm, const TransposeOptions &options = TransposeOptions())
+      : m_comm(comm), m_method(options.method),
+        m_reduced(options.float_on_wire && !std::is_same_v<E, reduced_type>), m_num_ranks(get_comm_size(comm)),
+        m_in(get_local_box(in_boxes, comm)), m_out(get_local_box(out_boxes, comm)) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    const size_t wire_size = m_reduced ? sizeof(reduced_type) : sizeof(E);
+    for (int r = 0; r < m_num_ranks; r++) {
+      if (add_overlap(m_in, out_boxes[r], m_send_boxes)) {
+        m_send_ranks.push_back(r);
+        if (r != rank) m_send_bytes += static_cast<size_t>(m_send_boxes.back().count()) * wire_size;
+      }
+      if (add_overlap(m_out, in_boxes[r], m_recv_boxes)) m_recv_ranks.push_back(r);
+    }
+    if (m_method == TransposeMethod::neighbor) {
+      MPI_Dist_graph_create_adjacent(comm, static_cast<int>(m_recv_ranks.size()), m_recv_ranks.data(), MPI_UNWEIGHTED,
+                                     static_cast<int>(m_send_ranks.size()), m_send_ranks.data(), MPI_UNWEIGHTED,
+                                     MPI_INFO_NULL, 0, &m_graph);
+    }
+    get_exchange(1);
+  }
+
+  Transpose(const Transpose &) = delete;
+  Transpose &operator=(const Transpose &) = delete;
+
+  ~Transpose() {
+    for (auto &[batch_size, x] : m_exchanges) {
+      for (auto *types : {&x.send_types, &x.recv_types}) {
+        for (MPI_Datatype &type : *types) {
+          if (type != MPI_BYTE) MPI_Type_free(&type);
+        }
+      }
+    }
+    if (m_graph != MPI_COMM_NULL) MPI_Comm_free(&m_graph);
+  }
+
+  /**
+   * @brief Redistributes a batch of fields.
+   *
+   * @param batch_size Number of fields packed one after another.
+   * @param in Input data of batch_size * size_in() elements in the local
+   * input box.
+   * @param out Output data of batch_size * size_out() elements in the local
+   * output box.
+   */
+  void execute(int batch_size, const E *in, E *out) const {
+    const Exchange &x = get_exchange(batch_size);
+    const void *send = in;
+    void *recv = out;
+    if (m_reduced) {
+      m_send_buffer.resize(batch_size * size_in());
+      m_recv_buffer.resize(batch_size * size_out());
+      reduced_type *buffer = m_send_buffer.data();
+      parallel_for(m_send_buffer.size(), [buffer, in](size_t i) { buffer[i] = static_cast<reduced_type>(in[i]); });
+      send = m_send_buffer.data();
+      recv = m_recv_buffer.data();
+    }
+    if (m_method == TransposeMethod::alltoallw) {
+      MPI_Alltoallw(send, x.send_counts.data(), x.displs.data(), x.send_types.data(), recv, x.recv_counts.data(),
+                    x.displs.data(), x.recv_types.data(), m_comm);
+    } else {
+      MPI_Neighbor_alltoallw(send, x.send_counts.data(), x.neighbor_displs.data(), x.send_types.data(), recv,
+                             x.recv_counts.data(), x.neighbor_displs.data(), x.recv_types.data(), m_graph);
+    }
+    if (m_reduced) {
+      const reduced_type *buffer = m_recv_buffer.data();
+      parallel_for(m_recv_buffer.size(), [buffer, out](size_t i) { out[i] = static_cast<E>(buffer[i]); });
+    }
+  }
+
+  /**
+   * @brief Returns the number of elements in the local input box.
+   */
+  size_t size_in() const { return static_cast<size_t>(m_in.count()); }
+
+  /**
+   * @brief Returns the number of elements in the local output box.
+   */
+  size_t size_out() const { return static_cast<size_t>(m_out.count()); }
+
+  /**
+   * @brief Returns the number of ranks data is sent to, including this one.
+   */
+  size_t get_num_send_ranks() const { return m_send_ranks.size(); }
+
+  /**
+   * @brief Returns the number of bytes sent to other ranks per field, in the
+   * precision on the wire.
+   */
+  size_t get_send_bytes() const { return m_send_bytes; }
+
+  /**
+   * @brief Returns true if the exchange is done in single precision.
+   */
+  bool is_reduced_precision() const { return m_reduced; }
+
+  /**
+   * @brief Returns true if the input and output boxes are the same on all
+   * ranks, i.e. the transpose would only copy data.
+   */
+  static bool is_identity(const std::vector<heffte::box3d<int>> &in_boxes,
+                          const std::vector<heffte::box3d<int>> &out_boxes) {
+    if (in_boxes.size() != out_boxes.size()) return false;
+    for (size_t i = 0; i < in_boxes.size(); i++) {
+      if (in_boxes[i].low != out_boxes[i].low || in_boxes[i].high != out_boxes[i].high) return false;
+    }
+    return true;
+  }
+};
+
+} // namespace pfc
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef PFC_TYPES_HPP
 #define PFC_TYPES_HPP
 
+#include "allocator.hpp"
+
 #include <array>
 #include <complex>
 #include <unordered_map>
@@ -10,10 +12,17 @@ namespace pfc {
 
 template <class T> using Vec3 = std::array<T, 3>;
 
+#ifdef OpenPFC_ALIGNED_FIELDS
+// aligned and first-touched fields, see FieldAllocator
+using Field = FieldVector<double>;
+using RealField = FieldVector<double>;
+using ComplexField = FieldVector<std::complex<double>>;
+#else
 using Field = std::vector<double>;
 using RealField = std::vector<double>;
-using RealFieldSet = std::unordered_map<std::string, RealField &>;
 using ComplexField = std::vector<std::complex<double>>;
+#endif
+using RealFieldSet = std::unordered_map<std::string, RealField &>;
 using ComplexFieldSet = std::unordered_map<std::string, ComplexField &>;
 
 // template <class T> using Field = std::vector<T>;
@@ -9,15 +9,19 @@
 
 #include "boundary_conditions/fixed_bc.hpp"
 #include "boundary_conditions/moving_bc.hpp"
+#include "fft_autotune.hpp"
+#include "fftw_wisdom.hpp"
 #include "field_modifier.hpp"
 #include "initial_conditions/constant.hpp"
 #include "initial_conditions/file_reader.hpp"
 #include "initial_conditions/random_seeds.hpp"
 #include "initial_conditions/seed_grid.hpp"
 #include "initial_conditions/single_seed.hpp"
+#include "memory_registry.hpp"
 #include "mpi.hpp"
 #include "simulator.hpp"
 #include "time.hpp"
+#include "time_step_controller.hpp"
 #include "utils/timeleft.hpp"
 #include "world.hpp"
 
@@ -440,6 +444,32 @@ static FieldModifierInitializer fieldModifierInitializer; /**< Static instance o
                                                              to trigger field modifier registration during
                                                              static initialization. */
 
+/**
+ * @brief Reads settings from the file given as the first command line
+ * argument, or from standard input if there is none. Aborts the communicator
+ * if the file does not exist.
+ */
+inline json read_settings(int argc, char *argv[], MPI_Comm comm = MPI_COMM_WORLD) {
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  const bool rank0 = (rank == 0);
+  json settings;
+  if (argc > 1) {
+    if (rank0) std::cout << "Reading input from file " << argv[1] << "\n\n";
+    std::filesystem::path file(argv[1]);
+    if (!std::filesystem::exists(file)) {
+      if (rank0) std::cerr << "File " << file << " does not exist!\n";
+      MPI_Abort(comm, 1);
+    }
+    std::ifstream input_file(file);
+    input_file >> settings;
+  } else {
+    if (rank0) std::cout << "Reading simulation settings from stdin\n\n";
+    std::cin >> settings;
+  }
+  return settings;
+}
+
 /**
  * @brief The main json-based application
  *
@@ -463,30 +493,14 @@ private:
   bool m_detailed_timing_print = false;
   bool m_detailed_timing_write = false;
   std::string m_detailed_timing_filename = "timing.bin";
-
-  // read settings from file if or standard input
-  json read_settings(int argc, char *argv[]) {
-    json settings;
-    if (argc > 1) {
-      if (rank0) std::cout << "Reading input from file " << argv[1] << "\n\n";
-      std::filesystem::path file(argv[1]);
-      if (!std::filesystem::exists(file)) {
-        if (rank0) std::cerr << "File " << file << " does not exist!\n";
-        MPI_Abort(MPI_COMM_WORLD, 1);
-      }
-      std::ifstream input_file(file);
-      input_file >> settings;
-    } else {
-      if (rank0) std::cout << "Reading simulation settings from stdin\n\n";
-      std::cin >> settings;
-    }
-    return settings;
-  }
+  std::string m_fftw_wisdom_import;
+  std::string m_fftw_wisdom_export;
+  MemoryRegistry m_memory; // buffers of the model and the FFT, for the memory reports
 
 public:
   App(int argc, char *argv[], MPI_Comm comm = MPI_COMM_WORLD)
       : m_comm(comm), m_worker(MPI_Worker(argc, argv, comm)), rank0(m_worker.get_rank() == 0),
-        m_settings(read_settings(argc, argv)) {}
+        m_settings(read_settings(argc, argv, comm)) {}
 
   App(const json &settings, MPI_Comm comm = MPI_COMM_WORLD)
       : m_comm(comm), m_worker(MPI_Worker(0, nullptr, comm)), rank0(m_worker.get_rank() == 0), m_settings(settings) {}
@@ -514,6 +528,181 @@ public:
     }
   }
 
+  /**
+   * @brief Sets up adaptive time stepping from optional setting
+   * "adaptive_dt", an object with keys "dt_min", "dt_max" and "tolerance"
+   * (required), "factor", "patience", "field" and "criterion" ("field_change"
+   * or "model"), see TimeStepController. The time step "dt" is the initial
+   * level, and the model must support variable time steps.
+   *
+   * @throws std::invalid_argument if the settings are invalid.
+   */
+  void setup_adaptive_dt(Simulator &simulator, const Time &time) {
+    if (!m_settings.contains("adaptive_dt")) return;
+    const json &j = m_settings["adaptive_dt"];
+    for (const char *key : {"dt_min", "dt_max", "tolerance"}) {
+      if (!j.contains(key) || !j[key].is_number()) {
+        throw std::invalid_argument(std::string("Invalid JSON input: missing or invalid 'adaptive_dt.") + key + "'.");
+      }
+    }
+    auto controller = std::make_unique<TimeStepController>(time.get_dt(), j["dt_min"], j["dt_max"], j["tolerance"]);
+    if (j.contains("factor")) controller->set_factor(j["factor"]);
+    if (j.contains("patience")) controller->set_patience(j["patience"]);
+    if (j.contains("field")) controller->set_field_name(j["field"]);
+    if (j.contains("criterion")) {
+      const std::string criterion = j["criterion"];
+      if (criterion != "field_change" && criterion != "model") {
+        throw std::invalid_argument("Invalid JSON input: unknown 'adaptive_dt.criterion' " + criterion + ".");
+      }
+      controller->set_use_model_error(criterion == "model");
+    }
+    std::cout << "Adaptive time step: dt = " << time.get_dt() << ", levels " << controller->get_factor()
+              << "^k between " << j["dt_min"] << " and " << j["dt_max"] << ", tolerance " << j["tolerance"] << "\n";
+    simulator.set_time_step_controller(std::move(controller));
+  }
+
+  /**
+   * @brief Reads FFTW wisdom files from settings. "fftw_wisdom" can be a single
+   * file name, used both for import and export, or an object with keys
+   * "import" and "export".
+   */
+  void read_fftw_wisdom_configuration() {
+    if (!m_settings.contains("fftw_wisdom")) return;
+    const json &j = m_settings["fftw_wisdom"];
+    if (j.is_string()) {
+      m_fftw_wisdom_import = j;
+      m_fftw_wisdom_export = j;
+      return;
+    }
+    if (j.contains("import")) m_fftw_wisdom_import = j["import"];
+    if (j.contains("export")) m_fftw_wisdom_export = j["export"];
+  }
+
+  /**
+   * @brief Creates the domain decomposition. Optional setting "decomposition"
+   * overrides the processor grid with key "proc_grid" ([px, py, pz]) and the
+   * real-to-complex direction with key "r2c_direction" (0, 1, 2 or "x", "y",
+   * "z"). With "transposed_out": true, the complex space is kept in the layout
+   * of the last transform. Prints the resulting processor grid and box shapes.
+   *
+   * @throws std::invalid_argument if the settings are invalid.
+   */
+  Decomposition make_decomposition(const World &world) {
+    std::array<int, 3> grid = {0, 0, 0};
+    int r2c_direction = 0;
+    bool transposed = false;
+    if (m_settings.contains("decomposition")) {
+      const json &j = m_settings["decomposition"];
+      if (j.contains("proc_grid")) {
+        const json &g = j["proc_grid"];
+        if (!g.is_array() || g.size() != 3 || !g[0].is_number_integer() || !g[1].is_number_integer() ||
+            !g[2].is_number_integer()) {
+          throw std::invalid_argument("Invalid 'proc_grid' field in 'decomposition': expected three integers.");
+        }
+        grid = {g[0], g[1], g[2]};
+      }
+      if (j.contains("r2c_direction")) {
+        const json &r2c = j["r2c_direction"];
+        if (r2c == "x" || r2c == 0) {
+          r2c_direction = 0;
+        } else if (r2c == "y" || r2c == 1) {
+          r2c_direction = 1;
+        } else if (r2c == "z" || r2c == 2) {
+          r2c_direction = 2;
+        } else {
+          throw std::invalid_argument("Invalid 'r2c_direction' field in 'decomposition': expected 0, 1, 2, x, y or z.");
+        }
+      }
+      if (j.contains("transposed_out")) {
+        if (!j["transposed_out"].is_boolean()) {
+          throw std::invalid_argument("Invalid 'transposed_out' field in 'decomposition': expected a boolean.");
+        }
+        transposed = j["transposed_out"];
+      }
+    }
+    Decomposition decomp(world, m_comm, grid, r2c_direction, transposed);
+    decomp.print_summary(std::cout);
+    std::cout << "\n";
+    return decomp;
+  }
+
+  /**
+   * @brief Sets the number of threads per MPI process from setting "threads",
+   * defaulting to OMP_NUM_THREADS, and lets FFTW use the same number of
+   * threads if it was built with thread support. Must be called before the FFT
+   * is constructed.
+   */
+  void setup_threads() {
+    if (m_settings.contains("threads")) parallel::set_num_threads(m_settings["threads"]);
+    const int num_threads = parallel::get_num_threads();
+    std::cout << "Threads per process: " << num_threads;
+    if (!parallel::is_enabled()) std::cout << " (compiled without OpenMP)";
+    std::cout << "\n";
+    if (num_threads > 1 && !parallel::init_fftw_threads(num_threads)) {
+      std::cout << "FFTW thread support not available, local FFTs run on one thread\n";
+    }
+  }
+
+  /**
+   * @brief Sets up the allocation of fields from settings "huge_pages" and
+   * "first_touch", see memory::set_huge_pages() and memory::set_first_touch().
+   * They apply to the fields allocated with FieldAllocator, which RealField and
+   * ComplexField are when built with OpenPFC_ENABLE_ALIGNED_FIELDS. Must be
+   * called before the model is initialized.
+   */
+  void setup_memory() {
+    if (m_settings.contains("huge_pages")) memory::set_huge_pages(m_settings["huge_pages"]);
+    if (m_settings.contains("first_touch")) memory::set_first_touch(m_settings["first_touch"]);
+#ifdef OpenPFC_ALIGNED_FIELDS
+    std::cout << "Field memory: " << memory::alignment << " byte alignment, huge pages "
+              << (memory::get_huge_pages() ? "on" : "off") << ", parallel first touch "
+              << (memory::get_first_touch() ? "on" : "off") << "\n";
+#else
+    std::cout << "Field memory: std::allocator, settings huge_pages and first_touch need aligned fields\n";
+#endif
+  }
+
+  /**
+   * @brief Registers the memory of the model and the FFT and prints the usage
+   * per rank. Collective over the communicator of the app.
+   */
+  void report_memory(const Model &model, const FFT &fft, const std::string &title) {
+    model.register_memory(m_memory);
+    fft.register_memory(m_memory);
+    m_memory.print_report(std::cout, m_comm, title);
+    std::cout << std::endl;
+  }
+
+  /**
+   * @brief Prints the FFT counters, reduced over all MPI processes, to rank 0.
+   */
+  void print_fft_stats(const FFTStats &stats) {
+    const char *names[] = {"forward", "backward", "scaling", "compute", "reshape"};
+    double local[] = {stats.forward_time, stats.backward_time, stats.scaling_time, stats.compute_time,
+                      stats.reshape_time};
+    double min[5], max[5], sum[5];
+    MPI_Reduce(local, min, 5, MPI_DOUBLE, MPI_MIN, 0, m_comm);
+    MPI_Reduce(local, max, 5, MPI_DOUBLE, MPI_MAX, 0, m_comm);
+    MPI_Reduce(local, sum, 5, MPI_DOUBLE, MPI_SUM, 0, m_comm);
+    unsigned long long local_bytes[] = {stats.field_bytes, stats.reshape_bytes}, bytes[2];
+    MPI_Reduce(local_bytes, bytes, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, m_comm);
+    if (!rank0) return;
+    const int num_ranks = m_worker.get_num_ranks();
+    std::cout << "\nFFT breakdown (" << stats.forward_fields << " forward and " << stats.backward_fields
+              << " backward fields, " << bytes[0] << " field bytes in total), min / avg / max over ranks:" << std::endl;
+    // the phases are only measured by the native backend
+    const int num_times = stats.phases_measured ? 5 : 3;
+    for (int i = 0; i < num_times; i++) {
+      std::cout << "  " << names[i] << ": " << min[i] << " / " << sum[i] / num_ranks << " / " << max[i] << " s"
+                << std::endl;
+    }
+    if (stats.phases_measured) {
+      std::cout << "  bytes sent in reshapes: " << bytes[1] << std::endl;
+    } else {
+      std::cout << "  compute / reshape split not measured, available with the native backend" << std::endl;
+    }
+  }
+
   void add_result_writers(Simulator &sim) {
     std::cout << "Adding results writers" << std::endl;
     if (m_settings.contains("saveat") && m_settings.contains("fields") && m_settings["saveat"] > 0) {
@@ -587,9 +776,42 @@ public:
     World world(ui::from_json<World>(m_settings));
     std::cout << "World: " << world << std::endl;
 
-    Decomposition decomp(world, m_comm);
+    Decomposition decomp(make_decomposition(world));
+    setup_threads();
+    setup_memory();
+    read_fftw_wisdom_configuration();
+    if (!m_fftw_wisdom_import.empty()) fftw_wisdom::import_wisdom(m_fftw_wisdom_import, m_comm);
     auto plan_options = ui::from_json<heffte::plan_options>(m_settings["plan_options"]);
-    FFT fft(decomp, m_comm, plan_options);
+    FFTBackend backend = FFTBackend::fftw;
+    if (m_settings["plan_options"].contains("backend")) {
+      backend = fft_backend_from_string(m_settings["plan_options"]["backend"]);
+    }
+    TransposeOptions transpose_options;
+    if (m_settings["plan_options"].contains("transpose_method")) {
+      transpose_options.method = transpose_method_from_string(m_settings["plan_options"]["transpose_method"]);
+    }
+    if (m_settings["plan_options"].contains("float_on_wire")) {
+      transpose_options.float_on_wire = m_settings["plan_options"]["float_on_wire"];
+    }
+    std::cout << "FFT backend: " << to_string(backend);
+    if (backend == FFTBackend::native) {
+      std::cout << " (transpose method: " << to_string(transpose_options.method)
+                << (transpose_options.float_on_wire ? ", single precision on the wire)" : ")");
+    }
+    std::cout << "\n\n";
+    if (m_settings["plan_options"].contains("autotune") && m_settings["plan_options"]["autotune"]) {
+      const json &j = m_settings["plan_options"];
+      FFTAutotuner tuner(decomp, m_comm);
+      tuner.set_backend(backend);
+      if (j.contains("autotune_cache")) tuner.set_cache_file(j["autotune_cache"]);
+      if (j.contains("autotune_repetitions")) tuner.set_repetitions(j["autotune_repetitions"]);
+      plan_options = tuner.tune(plan_options);
+    }
+    FFT fft(decomp, m_comm, plan_options, backend, transpose_options);
+    if (m_settings["plan_options"].contains("normalize_backward")) {
+      // models must fold FFT::get_operator_scale() into their operators
+      fft.set_normalize_backward(m_settings["plan_options"]["normalize_backward"]);
+    }
     Time time(ui::from_json<Time>(m_settings));
     ConcreteModel model;
     model.set_fft(fft);
@@ -599,9 +821,13 @@ public:
       from_json(m_settings["model"]["params"], model);
     }
     read_detailed_timing_configuration();
+    setup_adaptive_dt(simulator, time);
 
     std::cout << "Initializing model... " << std::endl;
     model.initialize(time.get_dt());
+    report_memory(model, fft, "Memory after initialization");
+    // after the model has created its own FFT plans, e.g. in single precision
+    if (!m_fftw_wisdom_export.empty()) fftw_wisdom::export_wisdom(m_fftw_wisdom_export, m_comm);
 
     add_result_writers(simulator);
     add_initial_conditions(simulator);
@@ -634,17 +860,21 @@ public:
     }
 
     while (!time.done()) {
-      time.next(); // increase increment counter by 1
+      simulator.advance_time(); // increase increment counter by 1
       simulator.apply_boundary_conditions();
+      TimeStepController *controller = simulator.get_time_step_controller();
+      if (controller) controller->before_step(model);
 
       double l_steptime = 0.0; // l = local for this mpi process
       double l_fft_time = 0.0;
+      fft.reset_fft_time();
       MPI_Barrier(m_comm);
       l_steptime = -MPI_Wtime();
       model.step(time.get_current());
       MPI_Barrier(m_comm);
       l_steptime += MPI_Wtime();
       l_fft_time = fft.get_fft_time();
+      if (controller) controller->after_step(model, time);
 
       if (m_detailed_timing) {
         double timing[2] = {l_steptime, l_fft_time};
@@ -699,6 +929,7 @@ public:
       std::cout << "(" << m_fft_time << " s FFT, " << other_time << " s other). ";
       std::cout << "Simulation time: " << t << " / " << t1;
       std::cout << " (" << (t / t1 * 100) << " % done). ";
+      if (controller) std::cout << "Time step: " << time.get_dt() << ". ";
       std::cout << "ETA: " << pfc::utils::TimeLeft(eta_t) << std::endl;
 
       m_total_steptime += m_steptime;
@@ -715,6 +946,11 @@ public:
     std::cout << "Step time:  " << avg_steptime << " s" << std::endl;
     std::cout << "FFT time:   " << avg_fft_time << " s / " << p_fft << " %" << std::endl;
     std::cout << "Other time: " << avg_oth_time << " s / " << p_oth << " %" << std::endl;
+    print_fft_stats(fft.get_stats());
+    std::cout << "FFT workspace pool peak: " << fft.get_workspace_pool().get_peak() / (1024.0 * 1024.0) << " MiB"
+              << std::endl;
+    std::cout << std::endl;
+    report_memory(model, fft, "Memory at exit");
 
     return 0;
   }
@@ -30,7 +30,7 @@ std::string format_with_number(const std::string &filename, int increment) {
   }
 }
 
-template <typename T> size_t sizeof_vec(std::vector<T> &V) {
+template <typename T, typename A> size_t sizeof_vec(std::vector<T, A> &V) {
   return V.size() * sizeof(T);
 }
 
@@ -30,6 +30,15 @@
  */
 #define CHECK_AND_ABORT_IF_NAN(value) abortIfNaN(value, __FILE__, __LINE__)
 
+/**
+ * @def CHECK_AND_ABORT_IF_NAN_COMM(value, comm)
+ *
+ * Same as CHECK_AND_ABORT_IF_NAN, but reports the rank in and aborts the
+ * given communicator instead of MPI_COMM_WORLD. Use this when the simulation
+ * runs on a sub-communicator, e.g. as a member of an ensemble.
+ */
+#define CHECK_AND_ABORT_IF_NAN_COMM(value, comm) abortIfNaN(value, __FILE__, __LINE__, comm)
+
 /**
  * @def CHECK_AND_ABORT_IF_NANS(vec)
  *
@@ -53,9 +62,19 @@
  * performance.
  */
 #define CHECK_AND_ABORT_IF_NANS(vec) abortIfNaNs(vec, __FILE__, __LINE__)
+
+/**
+ * @def CHECK_AND_ABORT_IF_NANS_COMM(vec, comm)
+ *
+ * Same as CHECK_AND_ABORT_IF_NANS, but reports the rank in and aborts the
+ * given communicator instead of MPI_COMM_WORLD.
+ */
+#define CHECK_AND_ABORT_IF_NANS_COMM(vec, comm) abortIfNaNs(vec, __FILE__, __LINE__, comm)
 #else
 #define CHECK_AND_ABORT_IF_NAN(value)
 #define CHECK_AND_ABORT_IF_NANS(vec)
+#define CHECK_AND_ABORT_IF_NAN_COMM(value, comm)
+#define CHECK_AND_ABORT_IF_NANS_COMM(vec, comm)
 #endif
 
 namespace pfc {
@@ -67,7 +86,7 @@ namespace utils {
  * @param vec The vector of floats to check.
  * @return True if NaNs are found, false otherwise.
  */
-template <typename T> bool hasNaNs(const std::vector<T> &vec) {
+template <typename T, typename A> bool hasNaNs(const std::vector<T, A> &vec) {
   for (float value : vec) {
     if (std::isnan(value)) {
       return true;
@@ -76,13 +95,13 @@ template <typename T> bool hasNaNs(const std::vector<T> &vec) {
   return false;
 }
 
-template <typename T> void abortIfNaN(T value, const char *filename, int line) {
+template <typename T> void abortIfNaN(T value, const char *filename, int line, MPI_Comm comm = MPI_COMM_WORLD) {
   if (std::isnan(value)) {
     int rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_rank(comm, &rank);
     std::cerr << "NaN detected on process " << rank << " at " << filename << ":" << line
               << ". Aborting MPI application." << std::endl;
-    MPI_Abort(MPI_COMM_WORLD, 1);
+    MPI_Abort(comm, 1);
   }
 }
 
@@ -92,14 +111,16 @@ template <typename T> void abortIfNaN(T value, const char *filename, int line) {
  * process rank where NaNs were found before aborting.
  *
  * @param vec The vector of floats to check.
+ * @param comm The communicator whose rank is reported and which is aborted.
  */
-template <typename T> void abortIfNaNs(const std::vector<T> &vec, const char *filename, int line) {
+template <typename T, typename A>
+void abortIfNaNs(const std::vector<T, A> &vec, const char *filename, int line, MPI_Comm comm = MPI_COMM_WORLD) {
   if (hasNaNs(vec)) {
     int rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_rank(comm, &rank);
     std::cerr << "NaNs detected on process " << rank << " at " << filename << ":" << line
               << ". Aborting MPI application." << std::endl;
-    MPI_Abort(MPI_COMM_WORLD, 1);
+    MPI_Abort(comm, 1);
   }
 }
 
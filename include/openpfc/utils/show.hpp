@@ -11,8 +11,8 @@
 namespace pfc {
 namespace utils {
 
-template <typename T>
-void show(const std::vector<T> &data, const std::array<int, 3> &size, const std::array<int, 3> &offsets) {
+template <typename T, typename A>
+void show(const std::vector<T, A> &data, const std::array<int, 3> &size, const std::array<int, 3> &offsets) {
   std::cout << size[0] << "×" << size[1] << "×" << size[2] << " Array<3, " << pfc::TypeName<T>::get()
             << ">:" << std::endl;
   for (int k = 0; k < size[2]; ++k) {
@@ -28,8 +28,8 @@ void show(const std::vector<T> &data, const std::array<int, 3> &size, const std:
   }
 }
 
-template <typename T>
-void show(const std::vector<T> &data, const std::array<int, 2> &size, const std::array<int, 2> &offsets) {
+template <typename T, typename A>
+void show(const std::vector<T, A> &data, const std::array<int, 2> &size, const std::array<int, 2> &offsets) {
   std::cout << size[0] << "×" << size[1] << " Array<2, " << pfc::TypeName<T>::get() << ">:" << std::endl;
   for (int i = 0; i < size[0]; ++i) {
     for (int j = 0; j < size[1]; ++j) {
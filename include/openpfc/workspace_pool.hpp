@@ -0,0 +1,205 @@
+#ifndef PFC_WORKSPACE_POOL_HPP
+#define PFC_WORKSPACE_POOL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+namespace pfc {
+
+class WorkspacePool;
+
+/**
+ * @brief Scratch memory borrowed from a WorkspacePool, returned to the pool
+ * when the lease goes out of scope.
+ *
+ * The memory is not initialized.
+ *
+ * @tparam T Element type.
+ */
+template <typename T> class WorkspaceLease {
+private:
+  WorkspacePool *m_pool = nullptr; /**< Pool the memory is borrowed from. */
+  T *m_data = nullptr;             /**< Borrowed memory. */
+  size_t m_size = 0;               /**< Number of elements. */
+  size_t m_bytes = 0;              /**< Number of bytes reserved from the pool. */
+  bool m_overflow = false;         /**< Memory is a separate allocation, not from the arena. */
+
+  friend class WorkspacePool;
+
+  WorkspaceLease(WorkspacePool *pool, T *data, size_t size, size_t bytes, bool overflow)
+      : m_pool(pool), m_data(data), m_size(size), m_bytes(bytes), m_overflow(overflow) {}
+
+public:
+  WorkspaceLease() = default;
+  WorkspaceLease(const WorkspaceLease &) = delete;
+  WorkspaceLease &operator=(const WorkspaceLease &) = delete;
+
+  WorkspaceLease(WorkspaceLease &&other) noexcept
+      : m_pool(std::exchange(other.m_pool, nullptr)), m_data(std::exchange(other.m_data, nullptr)),
+        m_size(std::exchange(other.m_size, 0)), m_bytes(std::exchange(other.m_bytes, 0)),
+        m_overflow(std::exchange(other.m_overflow, false)) {}
+
+  WorkspaceLease &operator=(WorkspaceLease &&other) noexcept {
+    if (this != &other) {
+      release();
+      m_pool = std::exchange(other.m_pool, nullptr);
+      m_data = std::exchange(other.m_data, nullptr);
+      m_size = std::exchange(other.m_size, 0);
+      m_bytes = std::exchange(other.m_bytes, 0);
+      m_overflow = std::exchange(other.m_overflow, false);
+    }
+    return *this;
+  }
+
+  ~WorkspaceLease() { release(); }
+
+  /**
+   * @brief Returns the memory to the pool before the lease goes out of scope.
+   */
+  void release();
+
+  T *data() const { return m_data; }
+  size_t size() const { return m_size; }
+  T &operator[](size_t i) const { return m_data[i]; }
+};
+
+/**
+ * @brief Arena of scratch memory shared by FFT objects and models.
+ *
+ * Instead of every FFT object keeping its own workspace for the whole
+ * lifetime, the workspace and other scratch buffers are borrowed from a pool
+ * for the duration of a call, so that several FFT objects (e.g. double and
+ * single precision transforms) need only one buffer, sized by the largest
+ * simultaneous use:
+ *
+ * @code
+ * auto wrk = WorkspacePool::get_default().borrow<std::complex<double>>(n);
+ * // use wrk.data() ... memory is returned when wrk goes out of scope
+ * @endcode
+ *
+ * Memory is handed out stack-wise from one contiguous arena. If the arena is
+ * too small while other leases are active, the lease gets a separate
+ * allocation, and the arena is grown to the observed peak the next time it is
+ * empty. After the first few calls, borrowing does no allocations at all.
+ *
+ * The pool is not thread-safe: borrow only from the thread doing the FFTs.
+ */
+class WorkspacePool {
+private:
+  static constexpr size_t alignment = 64; /**< Alignment of the borrowed memory in bytes. */
+
+  std::byte *m_buffer = nullptr; /**< The arena. */
+  size_t m_capacity = 0;         /**< Size of the arena in bytes. */
+  size_t m_used = 0;             /**< Bytes in use from the top of the arena. */
+  size_t m_overflow = 0;         /**< Bytes in use in separate allocations. */
+  size_t m_peak = 0;             /**< Largest number of bytes in use simultaneously. */
+  size_t m_leases = 0;           /**< Number of active leases. */
+
+  template <typename T> friend class WorkspaceLease;
+
+  static std::byte *allocate(size_t bytes) {
+    return static_cast<std::byte *>(::operator new(bytes, std::align_val_t(alignment)));
+  }
+
+  static void deallocate(std::byte *ptr) {
+    if (ptr != nullptr) ::operator delete(ptr, std::align_val_t(alignment));
+  }
+
+  void give_back(std::byte *ptr, size_t bytes, bool overflow) {
+    if (overflow) {
+      deallocate(ptr);
+      m_overflow -= bytes;
+    } else if (ptr + bytes == m_buffer + m_used) {
+      m_used -= bytes; // leases are normally released in reverse order
+    }
+    if (--m_leases == 0) m_used = 0;
+  }
+
+public:
+  WorkspacePool() = default;
+  WorkspacePool(const WorkspacePool &) = delete;
+  WorkspacePool &operator=(const WorkspacePool &) = delete;
+
+  ~WorkspacePool() { deallocate(m_buffer); }
+
+  /**
+   * @brief Returns the pool shared by all FFT objects by default.
+   */
+  static WorkspacePool &get_default() {
+    static WorkspacePool pool;
+    return pool;
+  }
+
+  /**
+   * @brief Borrows uninitialized memory for n elements of type T.
+   *
+   * @param n Number of elements.
+   * @return Lease holding the memory until it goes out of scope.
+   */
+  template <typename T> WorkspaceLease<T> borrow(size_t n) {
+    static_assert(alignof(T) <= alignment, "WorkspacePool: type has too large alignment");
+    const size_t bytes = (n * sizeof(T) + alignment - 1) / alignment * alignment;
+    const size_t capacity = std::max(bytes, m_peak);
+    if (m_leases == 0 && capacity > m_capacity) {
+      // grow to the peak seen so far, so that nested borrows fit from now on
+      release_memory();
+      m_buffer = allocate(capacity);
+      m_capacity = capacity;
+    }
+    std::byte *ptr;
+    bool overflow = m_used + bytes > m_capacity;
+    if (overflow) {
+      ptr = allocate(bytes);
+      m_overflow += bytes;
+    } else {
+      ptr = m_buffer + m_used;
+      m_used += bytes;
+    }
+    m_leases++;
+    m_peak = std::max(m_peak, m_used + m_overflow);
+    return WorkspaceLease<T>(this, reinterpret_cast<T *>(ptr), n, bytes, overflow);
+  }
+
+  /**
+   * @brief Returns the size of the arena in bytes.
+   */
+  size_t get_capacity() const { return m_capacity; }
+
+  /**
+   * @brief Returns the largest number of bytes borrowed simultaneously.
+   */
+  size_t get_peak() const { return m_peak; }
+
+  /**
+   * @brief Returns the number of bytes currently borrowed.
+   */
+  size_t get_used() const { return m_used + m_overflow; }
+
+  /**
+   * @brief Frees the arena. The next borrow allocates it again.
+   *
+   * @throws std::logic_error if there are active leases.
+   */
+  void release_memory() {
+    if (m_leases > 0) throw std::logic_error("WorkspacePool: cannot release memory with active leases");
+    deallocate(m_buffer);
+    m_buffer = nullptr;
+    m_capacity = 0;
+  }
+};
+
+template <typename T> void WorkspaceLease<T>::release() {
+  if (m_pool != nullptr) {
+    m_pool->give_back(reinterpret_cast<std::byte *>(m_data), m_bytes, m_overflow);
+    m_pool = nullptr;
+    m_data = nullptr;
+    m_size = 0;
+  }
+}
+
+} // namespace pfc
+
+#endif
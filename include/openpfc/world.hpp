@@ -93,6 +93,13 @@ public:
    */
   std::array<int, 3> get_size() const { return {Lx, Ly, Lz}; }
 
+  /**
+   * @brief Check if the world is two-dimensional, i.e. Lz == 1.
+   *
+   * @return true if Lz == 1.
+   */
+  bool is_2d() const { return Lz == 1; }
+
   /**
    * @brief Get the origin of the coordinate system
    *
@@ -0,0 +1,55 @@
+#include <catch2/catch_test_macros.hpp>
+#include <complex>
+#include <cstdint>
+#include <openpfc/allocator.hpp>
+
+using namespace pfc;
+
+namespace {
+template <typename T> size_t misalignment(const T *p, size_t alignment) {
+  return reinterpret_cast<std::uintptr_t>(p) % alignment;
+}
+} // namespace
+
+TEST_CASE("Field allocator", "[allocator]") {
+  SECTION("Fields are aligned") {
+    FieldVector<double> small(3);
+    FieldVector<std::complex<double>> large(memory::huge_page_size / sizeof(std::complex<double>));
+    REQUIRE(misalignment(small.data(), memory::alignment) == 0);
+    REQUIRE(misalignment(large.data(), memory::huge_page_size) == 0);
+    REQUIRE(memory::get_alignment(8) == memory::alignment);
+    REQUIRE(memory::get_alignment(memory::huge_page_size) == memory::huge_page_size);
+  }
+
+  SECTION("Fields are zero initialized with and without parallel first touch") {
+    for (bool first_touch : {true, false}) {
+      memory::set_first_touch(first_touch);
+      FieldVector<double> psi(1000);
+      for (double x : psi) REQUIRE(x == 0.0);
+      FieldVector<double> phi(1000, 2.0);
+      for (double x : phi) REQUIRE(x == 2.0);
+    }
+    memory::set_first_touch(true);
+  }
+
+  SECTION("Huge pages are only a hint") {
+    memory::set_huge_pages(true);
+    REQUIRE(memory::get_huge_pages());
+    FieldVector<double> psi(memory::huge_page_size / sizeof(double) + 1, 1.0);
+    REQUIRE(psi.back() == 1.0);
+    memory::set_huge_pages(false);
+  }
+
+  SECTION("Fields behave like std::vector") {
+    FieldVector<double> a(10, 1.0);
+    a.push_back(2.0);
+    FieldVector<double> b = a;
+    REQUIRE(b.size() == 11);
+    REQUIRE(b.back() == 2.0);
+    FieldVector<double> c = std::move(a);
+    REQUIRE(c.size() == 11);
+    c.swap(b);
+    REQUIRE(misalignment(c.data(), memory::alignment) == 0);
+    REQUIRE(FieldAllocator<double>() == FieldAllocator<float>());
+  }
+}
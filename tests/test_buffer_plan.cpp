@@ -0,0 +1,76 @@
+#include <catch2/catch_test_macros.hpp>
+#include <complex>
+#include <openpfc/buffer_plan.hpp>
+#include <openpfc/model.hpp>
+#include <stdexcept>
+
+using namespace pfc;
+
+TEST_CASE("Buffer plan", "[buffer_plan]") {
+  SECTION("Arrays with disjoint lifetimes share buffers") {
+    BufferPlan<double> plan;
+    plan.declare("a", 10, 1, 2);
+    plan.declare("b", 10, 2, 3);
+    plan.declare("c", 10, 3, 4);
+    plan.declare("d", 10, 4, 4);
+    plan.declare("e", 20, 4, 4); // different size, never shared
+    plan.allocate();
+    REQUIRE(plan.num_arrays() == 5);
+    REQUIRE(plan.num_buffers() == 3);
+    REQUIRE(plan.get_buffer_index("a") == plan.get_buffer_index("c"));
+    REQUIRE(plan.get_buffer_index("b") == plan.get_buffer_index("d"));
+    REQUIRE(plan.get_buffer_index("a") != plan.get_buffer_index("b"));
+    REQUIRE(&plan.get("a") == &plan.get("c"));
+    REQUIRE(plan.get("a").size() == 10);
+    REQUIRE(plan.get("e").size() == 20);
+    REQUIRE(plan.get_requested_bytes() == 60 * sizeof(double));
+    REQUIRE(plan.get_allocated_bytes() == 40 * sizeof(double));
+  }
+
+  SECTION("Declaration order does not matter") {
+    BufferPlan<double> plan;
+    plan.declare("late", 8, 5, 6);
+    plan.declare("early", 8, 1, 2);
+    plan.declare("middle", 8, 3, 4);
+    plan.allocate();
+    REQUIRE(plan.num_buffers() == 1);
+  }
+
+  SECTION("Invalid declarations") {
+    BufferPlan<double> plan;
+    REQUIRE_THROWS_AS(plan.declare("a", 10, 3, 2), std::invalid_argument);
+    plan.declare("a", 10, 1, 2);
+    REQUIRE_THROWS_AS(plan.declare("a", 10, 1, 2), std::invalid_argument);
+    REQUIRE_THROWS_AS(plan.get("a"), std::runtime_error);
+    plan.allocate();
+    REQUIRE_THROWS_AS(plan.get("b"), std::invalid_argument);
+    REQUIRE_THROWS_AS(plan.declare("b", 10, 1, 2), std::runtime_error);
+  }
+}
+
+namespace {
+class WorkArrayModel : public Model {
+public:
+  void step(double) override {}
+  void initialize(double) override {
+    add_real_work_array("psiN", 2, 3);
+    add_complex_work_array("psiMF_F", 1, 1);
+    add_complex_work_array("psiN_F", 3, 3);
+    add_real_work_array("batch", 1, 1, 3);
+    allocate_work_arrays();
+  }
+};
+} // namespace
+
+TEST_CASE("Model work arrays", "[buffer_plan]") {
+  World world({8, 8, 1});
+  Decomposition decomp(world, MPI_COMM_SELF);
+  FFT fft(decomp, MPI_COMM_SELF);
+  WorkArrayModel model;
+  model.set_fft(fft);
+  model.initialize(1.0);
+  REQUIRE(model.get_real_work_array("psiN").size() == fft.size_inbox());
+  REQUIRE(model.get_complex_work_array("psiN_F").size() == fft.size_outbox());
+  REQUIRE(&model.get_complex_work_array("psiMF_F") == &model.get_complex_work_array("psiN_F"));
+  REQUIRE(model.get_real_work_array("batch").size() == 3 * fft.size_inbox());
+}
@@ -16,6 +16,100 @@ TEST_CASE("Decomposition class tests", "[Decomposition]") {
     REQUIRE(decomposition.get_rank() == 0);
   }
 
+  SECTION("Slab decomposition for 2D problems") {
+    Decomposition d2(World({512, 512, 1}), 1, 4);
+    REQUIRE(d2.is_slab());
+    REQUIRE(d2.get_proc_grid() == std::array<int, 3>{1, 4, 1});
+    REQUIRE(d2.inbox.size == std::array<int, 3>{512, 128, 1});
+    REQUIRE(d2.outbox.size == std::array<int, 3>{257, 128, 1});
+
+    // explicit slab decomposition for quasi-2D problem
+    Decomposition d3(World({64, 64, 4}), 0, 8, true);
+    REQUIRE(d3.is_slab());
+    REQUIRE(d3.get_proc_grid() == std::array<int, 3>{1, 8, 1});
+
+    // 3D problems keep minimum surface decomposition
+    REQUIRE_FALSE(Decomposition(World({64, 64, 64}), 0, 8).is_slab());
+
+    // more domains than points in y-direction falls back to minimum surface
+    REQUIRE_FALSE(Decomposition(World({64, 4, 1}), 0, 8).is_slab());
+  }
+
+  SECTION("User-defined processor grid and r2c direction") {
+    const World aniso({1024, 2048, 256});
+    Decomposition d1(aniso, 3, 8, {1, 8, 1});
+    REQUIRE(d1.is_user_grid());
+    REQUIRE(d1.is_slab());
+    REQUIRE(d1.inbox.size == std::array<int, 3>{1024, 256, 256});
+    REQUIRE(d1.outbox.size == std::array<int, 3>{513, 256, 256});
+
+    Decomposition d2(aniso, 0, 8, {1, 4, 2}, 1);
+    REQUIRE_FALSE(d2.is_slab());
+    REQUIRE(d2.r2c_direction == 1);
+    REQUIRE(d2.inbox.size == std::array<int, 3>{1024, 512, 128});
+    REQUIRE(d2.outbox.size[0] == 1024);
+    REQUIRE(d2.outbox.size[2] == 128);
+    REQUIRE(d2.get_wavenumbers(1).size() == static_cast<size_t>(d2.outbox.size[1]));
+
+    // automatic grid with r2c in z-direction
+    Decomposition d3(World({16, 16, 16}), 0, 1, {0, 0, 0}, 2);
+    REQUIRE_FALSE(d3.is_user_grid());
+    REQUIRE(d3.outbox.size == std::array<int, 3>{16, 16, 9});
+
+    std::ostringstream oss;
+    d2.print_summary(oss);
+    REQUIRE(oss.str().find("r2c direction = y") != std::string::npos);
+    REQUIRE(oss.str().find("user-defined processor grid: [1, 4, 2]") != std::string::npos);
+    REQUIRE(oss.str().find("Box shapes in real space: 8 x [1024, 512, 128]") != std::string::npos);
+
+    // invalid grids and directions
+    REQUIRE_THROWS_AS(Decomposition(aniso, 0, 8, {2, 2, 1}), std::invalid_argument);
+    REQUIRE_THROWS_AS(Decomposition(World({8, 8, 1}), 0, 2, {1, 1, 2}), std::invalid_argument);
+    REQUIRE_THROWS_AS(Decomposition(World({4, 8, 8}), 0, 4, {4, 1, 1}), std::invalid_argument);
+    REQUIRE_THROWS_AS(Decomposition(aniso, 0, 8, {1, 8, 1}, 3), std::invalid_argument);
+  }
+
+  SECTION("Complex space in the layout of the last transform") {
+    // pencils in z-direction, cross-section split as evenly as possible
+    Decomposition d1(World({256, 256, 256}), 0, 8, {0, 0, 0}, 0, true);
+    REQUIRE(d1.is_transposed());
+    REQUIRE(d1.get_proc_grid() == std::array<int, 3>{2, 2, 2});
+    REQUIRE(d1.get_out_proc_grid() == std::array<int, 3>{2, 4, 1});
+    REQUIRE(d1.inbox.size == std::array<int, 3>{128, 128, 128});
+    REQUIRE(d1.outbox.size[1] == 64);
+    REQUIRE(d1.outbox.size[2] == 256);
+    REQUIRE(d1.get_wavenumbers(2).size() == 256);
+
+    // 2D: last transform is in y-direction
+    Decomposition d2(World({16, 8, 1}), 1, 2, {0, 0, 0}, 0, true);
+    REQUIRE(d2.get_out_proc_grid() == std::array<int, 3>{2, 1, 1});
+    REQUIRE(d2.inbox.size == std::array<int, 3>{16, 4, 1});
+    REQUIRE(d2.outbox.size == std::array<int, 3>{4, 8, 1});
+
+    REQUIRE_FALSE(Decomposition(World({16, 8, 1}), 0, 2).is_transposed());
+    REQUIRE_THROWS_AS(Decomposition(World({2, 2, 8}), 0, 8, {1, 1, 8}, 0, true), std::invalid_argument);
+  }
+
+  SECTION("Wavenumbers of the outbox") {
+    Decomposition decomposition(World({8, 4, 2}, {0.0, 0.0, 0.0}, {0.5, 1.0, 1.0}), 1, 2);
+    const double pi = std::atan(1.0) * 4.0;
+    const auto &kx = decomposition.get_wavenumbers(0);
+    const auto &ky = decomposition.get_wavenumbers(1);
+    const auto &kz = decomposition.get_wavenumbers(2);
+    REQUIRE(kx.size() == static_cast<size_t>(decomposition.outbox.size[0]));
+    REQUIRE(ky.size() == static_cast<size_t>(decomposition.outbox.size[1]));
+    REQUIRE(kz.size() == static_cast<size_t>(decomposition.outbox.size[2]));
+    for (size_t i = 0; i < kx.size(); i++) {
+      int n = decomposition.outbox.low[0] + i;
+      REQUIRE_THAT(kx[i], WithinAbs(2.0 * pi * n / (0.5 * 8), 1.0e-12));
+    }
+    for (size_t j = 0; j < ky.size(); j++) {
+      int n = decomposition.outbox.low[1] + j;
+      if (n > 2) n -= 4; // negative frequencies above Nyquist index
+      REQUIRE_THAT(ky[j], WithinAbs(2.0 * pi * n / 4.0, 1.0e-12));
+    }
+  }
+
   SECTION("Domain decomposition status") {
     Decomposition decomposition(world, 0, 1);
 
@@ -27,6 +121,8 @@ Real-to-complex symmetry is used (r2c direction = x)
 Domain is split into 1 parts (minimum surface processor grid: [1, 1, 1])
 Domain in real space: [128, 128, 128] (2097152 indexes)
 Domain in complex space: [65, 128, 128] (1064960 indexes)
+Box shapes in real space: 1 x [128, 128, 128]
+Box shapes in complex space: 1 x [65, 128, 128]
 Domain 1/1: [0, 0, 0] x [127, 127, 127] (2097152 indexes) => [0, 0, 0] x [64, 127, 127] (1064960 indexes)
 )EXPECTED";
 
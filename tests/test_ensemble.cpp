@@ -0,0 +1,86 @@
+#include <catch2/catch_test_macros.hpp>
+#include <openpfc/ensemble.hpp>
+#include <openpfc/simulator.hpp>
+#include <stdexcept>
+
+using namespace pfc;
+using json = nlohmann::json;
+
+namespace {
+class EnsembleModel : public Model {
+public:
+  void step(double) override {}
+  void initialize(double) override {}
+};
+} // namespace
+
+TEST_CASE("Ensemble member settings", "[ensemble]") {
+  json settings = {{"Lx", 16},
+                   {"model", {{"name", "tungsten"}, {"params", {{"n0", -0.1}, {"T", 1.0}}}}},
+                   {"saveat", 1.0},
+                   {"fields", {{{"name", "default"}, {"data", "results/psi_%d.bin"}}}},
+                   {"ensemble",
+                    {{"ranks_per_member", 2},
+                     {"members",
+                      {{{"model", {{"params", {{"T", 2.0}}}}},
+                        {"fields", {{{"name", "default"}, {"data", "T2/psi_%d.bin"}}}}},
+                       {{"model", {{"params", {{"T", 3.0}}}}},
+                        {"fields", {{{"name", "default"}, {"data", "T3/psi_%d.bin"}}}}}}}}}};
+
+  SECTION("Members are merge patches of the base settings") {
+    auto members = ui::Ensemble<EnsembleModel>::make_member_settings(settings);
+    REQUIRE(members.size() == 2);
+    for (const json &member : members) {
+      REQUIRE_FALSE(member.contains("ensemble"));
+      REQUIRE(member["Lx"] == 16);
+      REQUIRE(member["model"]["name"] == "tungsten");
+      REQUIRE(member["model"]["params"]["n0"] == -0.1);
+    }
+    REQUIRE(members[0]["model"]["params"]["T"] == 2.0);
+    REQUIRE(members[1]["model"]["params"]["T"] == 3.0);
+    REQUIRE(members[1]["fields"][0]["data"] == "T3/psi_%d.bin");
+  }
+
+  SECTION("Members must not write to the same files") {
+    settings["ensemble"]["members"][1].erase("fields");
+    settings["ensemble"]["members"][0].erase("fields");
+    REQUIRE_THROWS_AS(ui::Ensemble<EnsembleModel>::make_member_settings(settings), std::invalid_argument);
+    settings["saveat"] = -1.0;
+    REQUIRE(ui::Ensemble<EnsembleModel>::make_member_settings(settings).size() == 2);
+  }
+
+  SECTION("Members must be a non-empty array of objects") {
+    settings["ensemble"]["members"] = json::array();
+    REQUIRE_THROWS_AS(ui::Ensemble<EnsembleModel>::make_member_settings(settings), std::invalid_argument);
+    settings["ensemble"]["members"] = {1, 2};
+    REQUIRE_THROWS_AS(ui::Ensemble<EnsembleModel>::make_member_settings(settings), std::invalid_argument);
+  }
+
+  SECTION("Ranks are divided into groups") {
+    REQUIRE(ui::Ensemble<EnsembleModel>::get_ranks_per_member(settings, 8, 2) == 2);
+    REQUIRE_THROWS_AS(ui::Ensemble<EnsembleModel>::get_ranks_per_member(settings, 7, 2), std::invalid_argument);
+    settings["ensemble"].erase("ranks_per_member");
+    REQUIRE(ui::Ensemble<EnsembleModel>::get_ranks_per_member(settings, 8, 2) == 4);
+    REQUIRE(ui::Ensemble<EnsembleModel>::get_ranks_per_member(settings, 2, 5) == 1);
+    settings["ensemble"]["ranks_per_member"] = 0;
+    REQUIRE_THROWS_AS(ui::Ensemble<EnsembleModel>::get_ranks_per_member(settings, 8, 2), std::invalid_argument);
+  }
+}
+
+TEST_CASE("Results writers use the communicator of the model", "[ensemble]") {
+  World world({8, 8, 1});
+  Decomposition decomp(world, MPI_COMM_SELF);
+  FFT fft(decomp, MPI_COMM_SELF);
+  EnsembleModel model;
+  model.set_fft(fft);
+  REQUIRE(model.get_comm() == MPI_COMM_SELF);
+  std::vector<double> psi(fft.size_inbox());
+  model.add_real_field("default", psi);
+  Time time({0.0, 1.0, 1.0}, 1.0);
+  Simulator simulator(model, time);
+  auto writer = std::make_unique<BinaryWriter>("psi_%d.bin");
+  BinaryWriter *ptr = writer.get();
+  REQUIRE(ptr->get_comm() == MPI_COMM_WORLD);
+  REQUIRE(simulator.add_results_writer("default", std::move(writer)));
+  REQUIRE(ptr->get_comm() == MPI_COMM_SELF);
+}
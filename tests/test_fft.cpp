@@ -1,6 +1,12 @@
+#include <algorithm>
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <memory>
+#include <numeric>
+#include <openpfc/allocator.hpp>
 #include <openpfc/fft.hpp>
+#include <stdexcept>
+#include <thread>
 #include <vector>
 
 using namespace Catch::Matchers;
@@ -43,3 +49,383 @@ TEST_CASE("FFT backward transformation", "[FFT]") {
   // Add more assertions as needed
   MPI_Finalize();
 }
+
+TEST_CASE("FFT batched transformations", "[FFT]") {
+  MPI_Init(0, nullptr);
+
+  FFT fft(Decomposition(World({8, 4, 2})));
+  std::vector<double> a(fft.size_inbox()), b(fft.size_inbox());
+  for (size_t i = 0; i < a.size(); i++) {
+    a[i] = std::sin(0.1 * i);
+    b[i] = std::cos(0.3 * i) + 1.0;
+  }
+
+  // Batched result must equal the result of two separate transformations
+  std::vector<std::complex<double>> a_F(fft.size_outbox()), b_F(fft.size_outbox());
+  std::vector<std::complex<double>> a_ref(fft.size_outbox()), b_ref(fft.size_outbox());
+  fft.forward_batch({a, b}, {a_F, b_F});
+  fft.forward(a, a_ref);
+  fft.forward(b, b_ref);
+  for (size_t i = 0; i < a_F.size(); i++) {
+    REQUIRE_THAT(std::abs(a_F[i] - a_ref[i]), WithinAbs(0.0, 1.0e-12));
+    REQUIRE_THAT(std::abs(b_F[i] - b_ref[i]), WithinAbs(0.0, 1.0e-12));
+  }
+
+  // Round trip returns the original data
+  std::vector<double> a2(fft.size_inbox()), b2(fft.size_inbox());
+  fft.backward_batch({a_F, b_F}, {a2, b2});
+  for (size_t i = 0; i < a.size(); i++) {
+    REQUIRE_THAT(a2[i], WithinAbs(a[i], 1.0e-12));
+    REQUIRE_THAT(b2[i], WithinAbs(b[i], 1.0e-12));
+  }
+
+  REQUIRE_THROWS(fft.forward_batch({a, b}, {a_F}));
+  MPI_Finalize();
+}
+
+TEST_CASE("FFT batched transformations of aligned fields", "[FFT]") {
+  MPI_Init(0, nullptr);
+
+  FFT fft(Decomposition(World({8, 4, 2})));
+  FieldVector<double> a(fft.size_inbox());
+  std::vector<double> b(fft.size_inbox());
+  for (size_t i = 0; i < a.size(); i++) {
+    a[i] = std::sin(0.1 * i);
+    b[i] = std::cos(0.3 * i) + 1.0;
+  }
+
+  // fields with different allocators can be mixed in one batch
+  FieldVector<std::complex<double>> a_F(fft.size_outbox());
+  std::vector<std::complex<double>> b_F(fft.size_outbox()), a_ref(fft.size_outbox());
+  fft.forward_batch({a, b}, {a_F, b_F});
+  fft.forward(a, a_ref);
+  for (size_t i = 0; i < a_F.size(); i++) REQUIRE_THAT(std::abs(a_F[i] - a_ref[i]), WithinAbs(0.0, 1.0e-12));
+
+  FieldVector<double> a2(fft.size_inbox()), b2(fft.size_inbox());
+  fft.backward_pipelined({a_F, b_F}, {a2, b2}, [](size_t) {});
+  for (size_t i = 0; i < a.size(); i++) {
+    REQUIRE_THAT(a2[i], WithinAbs(a[i], 1.0e-12));
+    REQUIRE_THAT(b2[i], WithinAbs(b[i], 1.0e-12));
+  }
+  MPI_Finalize();
+}
+
+TEST_CASE("FFT batched transformations of packed fields", "[FFT]") {
+  MPI_Init(0, nullptr);
+
+  FFT fft(Decomposition(World({8, 4, 2})));
+  const size_t n_in = fft.size_inbox(), n_out = fft.size_outbox();
+  std::vector<double> u(2 * n_in);
+  for (size_t i = 0; i < u.size(); i++) u[i] = std::sin(0.1 * i);
+
+  // packed batch must equal the transformations of the single fields
+  std::vector<std::complex<double>> U(2 * n_out), ref(n_out);
+  fft.forward_batch(2, u, U);
+  for (size_t f = 0; f < 2; f++) {
+    std::vector<double> field(u.begin() + f * n_in, u.begin() + (f + 1) * n_in);
+    fft.forward(field, ref);
+    for (size_t k = 0; k < n_out; k++) REQUIRE_THAT(std::abs(U[f * n_out + k] - ref[k]), WithinAbs(0.0, 1.0e-12));
+  }
+
+  std::vector<double> v(2 * n_in);
+  fft.backward_batch(2, U, v);
+  for (size_t i = 0; i < u.size(); i++) REQUIRE_THAT(v[i], WithinAbs(u[i], 1.0e-12));
+
+  // packed spectra to separate fields
+  std::vector<double> a(n_in), b(n_in);
+  fft.backward_batch({{U.data(), n_out}, {U.data() + n_out, n_out}}, {a, b});
+  for (size_t i = 0; i < n_in; i++) {
+    REQUIRE_THAT(a[i], WithinAbs(u[i], 1.0e-12));
+    REQUIRE_THAT(b[i], WithinAbs(u[n_in + i], 1.0e-12));
+  }
+
+  REQUIRE_THROWS_AS(fft.forward_batch(3, u, U), std::invalid_argument);
+  REQUIRE_THROWS_AS(fft.backward_batch(3, U, v), std::invalid_argument);
+  MPI_Finalize();
+}
+
+TEST_CASE("FFT pipelined transformations", "[FFT]") {
+  MPI_Init(0, nullptr);
+
+  FFT fft(Decomposition(World({8, 4, 2})));
+  std::vector<std::vector<double>> u(3, std::vector<double>(fft.size_inbox()));
+  std::vector<std::vector<std::complex<double>>> U(3, std::vector<std::complex<double>>(fft.size_outbox()));
+  for (size_t f = 0; f < u.size(); f++) {
+    for (size_t i = 0; i < u[f].size(); i++) u[f][i] = std::sin(0.1 * (f + 1) * i);
+  }
+
+  // Callback of each field is called exactly once, in order, after the field is ready
+  std::vector<size_t> order;
+  std::vector<std::complex<double>> ref(fft.size_outbox());
+  fft.forward_pipelined(
+      {u[0], u[1], u[2]}, {U[0], U[1], U[2]},
+      [&](size_t i) {
+        order.push_back(i);
+        for (auto &z : U[i]) z *= 2.0;
+      },
+      2);
+  REQUIRE(order == std::vector<size_t>{0, 1, 2});
+  for (size_t f = 0; f < u.size(); f++) {
+    fft.forward(u[f], ref);
+    for (size_t k = 0; k < ref.size(); k++) REQUIRE_THAT(std::abs(U[f][k] - 2.0 * ref[k]), WithinAbs(0.0, 1.0e-12));
+  }
+
+  std::vector<std::vector<double>> v(3, std::vector<double>(fft.size_inbox()));
+  fft.backward_pipelined({U[0], U[1], U[2]}, {v[0], v[1], v[2]}, [&](size_t i) {
+    for (auto &x : v[i]) x *= 0.5;
+  });
+  for (size_t f = 0; f < u.size(); f++) {
+    for (size_t i = 0; i < u[f].size(); i++) REQUIRE_THAT(v[f][i], WithinAbs(u[f][i], 1.0e-12));
+  }
+
+  // All callbacks run on one helper thread, and their exceptions are rethrown
+  std::vector<std::thread::id> threads;
+  fft.forward_pipelined({u[0], u[1], u[2]}, {U[0], U[1], U[2]}, [&](size_t) {
+    threads.push_back(std::this_thread::get_id());
+  });
+  REQUIRE(threads.size() == 3);
+  REQUIRE(threads[0] != std::this_thread::get_id());
+  REQUIRE(std::count(threads.begin(), threads.end(), threads[0]) == 3);
+  REQUIRE_THROWS_AS(fft.forward_pipelined({u[0], u[1]}, {U[0], U[1]},
+                                          [](size_t i) {
+                                            if (i == 0) throw std::runtime_error("callback failed");
+                                          }),
+                    std::runtime_error);
+
+  REQUIRE_THROWS(fft.forward_pipelined({u[0]}, {U[0]}, [](size_t) {}, 0));
+  REQUIRE_THROWS(fft.forward_pipelined({u[0], u[1]}, {U[0]}, [](size_t) {}));
+  MPI_Finalize();
+}
+
+TEST_CASE("FFT timing counters", "[FFT]") {
+  MPI_Init(0, nullptr);
+
+  FFT fft(Decomposition(World({8, 4, 2})));
+  std::vector<double> a(fft.size_inbox(), 1.0), b(fft.size_inbox(), 2.0);
+  std::vector<std::complex<double>> a_F(fft.size_outbox()), b_F(fft.size_outbox());
+  fft.forward(a, a_F);
+  fft.forward_batch({a, b}, {a_F, b_F});
+  fft.backward(a_F, a);
+
+  FFTStats stats = fft.get_stats();
+  REQUIRE(stats.forward_calls == 2);
+  REQUIRE(stats.forward_fields == 3);
+  REQUIRE(stats.backward_calls == 1);
+  REQUIRE(stats.backward_fields == 1);
+  size_t field_bytes = fft.size_inbox() * sizeof(double) + fft.size_outbox() * sizeof(std::complex<double>);
+  REQUIRE(stats.field_bytes == 4 * field_bytes);
+  // HeFFTe does not report its phases
+  REQUIRE_FALSE(stats.phases_measured);
+  REQUIRE(stats.compute_time == 0.0);
+  REQUIRE(stats.reshape_bytes == 0);
+  REQUIRE_THAT(fft.get_fft_time(), WithinAbs(stats.total_time(), 1.0e-12));
+
+  // Resetting the step time keeps the cumulative counters
+  fft.reset_fft_time();
+  REQUIRE(fft.get_fft_time() == 0.0);
+  REQUIRE(fft.get_stats().forward_fields == 3);
+  fft.reset_stats();
+  REQUIRE(fft.get_stats().forward_fields == 0);
+  MPI_Finalize();
+}
+
+TEST_CASE("FFT companion of other precision", "[FFT]") {
+  MPI_Init(0, nullptr);
+
+  Decomposition decomp(World({8, 4, 2}));
+  heffte::plan_options options = heffte::default_options<heffte::backend::fftw>();
+  options.algorithm = heffte::reshape_algorithm::p2p;
+  FFT fft(decomp, MPI_COMM_WORLD, options);
+  fft.set_normalize_backward(false);
+  std::unique_ptr<FFTf> fft_sp = fft.make_companion<float>();
+  REQUIRE(fft_sp->get_backend() == fft.get_backend());
+  REQUIRE(fft_sp->get_plan_options().algorithm == heffte::reshape_algorithm::p2p);
+  REQUIRE_FALSE(fft_sp->is_backward_normalized());
+  REQUIRE(&fft_sp->get_workspace_pool() == &fft.get_workspace_pool());
+
+  // transformations of the companion are counted in the primary FFT
+  std::vector<double> u(fft.size_inbox(), 1.0);
+  std::vector<std::complex<double>> U(fft.size_outbox());
+  fft.forward(u, U);
+  fft_sp->forward(u, U);
+  fft_sp->backward(U, u);
+  FFTStats stats = fft.get_stats();
+  REQUIRE(stats.forward_fields == 2);
+  REQUIRE(stats.backward_fields == 1);
+  REQUIRE_THAT(fft.get_fft_time(), WithinAbs(stats.total_time(), 1.0e-12));
+  REQUIRE(fft_sp->get_stats().forward_fields == 2);
+  fft_sp->reset_stats();
+  REQUIRE(fft.get_stats().forward_fields == 0);
+  MPI_Finalize();
+}
+
+TEST_CASE("FFT backends", "[FFT]") {
+  MPI_Init(0, nullptr);
+
+  REQUIRE(fft_backend_from_string("fftw") == FFTBackend::fftw);
+  REQUIRE(fft_backend_from_string(to_string(FFTBackend::stock)) == FFTBackend::stock);
+  REQUIRE(fft_backend_from_string(to_string(FFTBackend::mkl)) == FFTBackend::mkl);
+  REQUIRE(fft_backend_from_string(to_string(FFTBackend::native)) == FFTBackend::native);
+  REQUIRE_THROWS_AS(fft_backend_from_string("fftx"), std::invalid_argument);
+  REQUIRE(is_enabled(FFTBackend::fftw));
+
+  // All enabled backends must give the same result as FFTW
+  Decomposition decomp(World({8, 4, 2}));
+  FFT fft(decomp);
+  std::vector<double> in(fft.size_inbox()), out(fft.size_inbox());
+  for (size_t i = 0; i < in.size(); i++) in[i] = std::sin(0.1 * i);
+  std::vector<std::complex<double>> ref(fft.size_outbox()), res(fft.size_outbox());
+  fft.forward(in, ref);
+  for (auto backend : {FFTBackend::stock, FFTBackend::mkl, FFTBackend::native}) {
+    if (!is_enabled(backend)) {
+      REQUIRE_THROWS_AS(FFT(decomp, MPI_COMM_WORLD, heffte::default_options<heffte::backend::fftw>(), backend),
+                        std::invalid_argument);
+      continue;
+    }
+    FFT fft2(decomp, MPI_COMM_WORLD, heffte::default_options<heffte::backend::fftw>(), backend);
+    REQUIRE(fft2.get_backend() == backend);
+    fft2.forward(in, res);
+    for (size_t k = 0; k < res.size(); k++) REQUIRE_THAT(std::abs(res[k] - ref[k]), WithinAbs(0.0, 1.0e-10));
+    fft2.backward(res, out);
+    for (size_t i = 0; i < in.size(); i++) REQUIRE_THAT(out[i], WithinAbs(in[i], 1.0e-10));
+    if (backend == FFTBackend::native) {
+      // the native backend measures its stages; a single rank sends nothing
+      FFTStats stats = fft2.get_stats();
+      REQUIRE(stats.phases_measured);
+      REQUIRE(stats.compute_time > 0.0);
+      REQUIRE(stats.compute_time + stats.reshape_time <= stats.forward_time + stats.backward_time);
+      REQUIRE(stats.reshape_bytes == 0);
+    }
+  }
+  MPI_Finalize();
+}
+
+TEST_CASE("FFT in 2D", "[FFT]") {
+  MPI_Init(0, nullptr);
+
+  Decomposition decomp(World({16, 8, 1}));
+  REQUIRE(decomp.is_slab());
+  FFT fft(decomp);
+  REQUIRE(fft.size_inbox() == 16 * 8);
+  REQUIRE(fft.size_outbox() == 9 * 8);
+
+  // Single mode cos(2 pi (x / 16 + 2 y / 8)) has amplitude N / 2 at (1, 2)
+  const double pi = std::atan(1.0) * 4.0;
+  std::vector<double> u(fft.size_inbox()), v(fft.size_inbox());
+  for (int j = 0; j < 8; j++) {
+    for (int i = 0; i < 16; i++) u[i + 16 * j] = std::cos(2.0 * pi * (i / 16.0 + 2.0 * j / 8.0));
+  }
+  std::vector<std::complex<double>> U(fft.size_outbox());
+  fft.forward(u, U);
+  REQUIRE_THAT(std::real(U[1 + 9 * 2]), WithinAbs(64.0, 1.0e-9));
+  REQUIRE_THAT(std::abs(U[0]), WithinAbs(0.0, 1.0e-9));
+  fft.backward(U, v);
+  for (size_t i = 0; i < u.size(); i++) REQUIRE_THAT(v[i], WithinAbs(u[i], 1.0e-12));
+  MPI_Finalize();
+}
+
+TEST_CASE("FFT with transposed complex space", "[FFT]") {
+  MPI_Init(0, nullptr);
+
+  Decomposition decomp(World({16, 8, 4}), MPI_COMM_WORLD, {0, 0, 0}, 0, true);
+  REQUIRE(decomp.is_transposed());
+  FFT fft(decomp);
+  REQUIRE(fft.size_outbox() == static_cast<size_t>(decomp.outbox.count()));
+
+  std::vector<double> u(fft.size_inbox()), v(fft.size_inbox());
+  for (size_t i = 0; i < u.size(); i++) u[i] = std::sin(0.1 * i) + 0.5;
+  std::vector<std::complex<double>> U(fft.size_outbox());
+  fft.forward(u, U);
+  REQUIRE_THAT(std::real(U[0]), WithinAbs(std::accumulate(u.begin(), u.end(), 0.0), 1.0e-9));
+  fft.backward(U, v);
+  for (size_t i = 0; i < u.size(); i++) REQUIRE_THAT(v[i], WithinAbs(u[i], 1.0e-12));
+  MPI_Finalize();
+}
+
+TEST_CASE("FFT without backward normalization", "[FFT]") {
+  MPI_Init(0, nullptr);
+
+  FFT fft(Decomposition(World({8, 4, 2})));
+  REQUIRE(fft.is_backward_normalized());
+  REQUIRE(fft.get_operator_scale() == 1.0);
+  fft.set_normalize_backward(false);
+  REQUIRE(fft.get_operator_scale() == fft.normalization());
+
+  std::vector<double> u(fft.size_inbox()), v(fft.size_inbox()), w(fft.size_inbox());
+  for (size_t i = 0; i < u.size(); i++) u[i] = std::sin(0.1 * i);
+  std::vector<std::complex<double>> U(fft.size_outbox());
+  fft.forward(u, U);
+
+  // Plain backward returns N times the inverse
+  fft.backward(U, v);
+  for (size_t i = 0; i < u.size(); i++) REQUIRE_THAT(v[i], WithinAbs(64.0 * u[i], 1.0e-10));
+
+  // Operator with the scale folded in gives the normalized result
+  const double s = fft.get_operator_scale();
+  fft.backward(w, [&](size_t k) { return s * U[k]; });
+  for (size_t i = 0; i < u.size(); i++) REQUIRE_THAT(w[i], WithinAbs(u[i], 1.0e-12));
+  MPI_Finalize();
+}
+
+TEST_CASE("FFT backward transformation with kernel", "[FFT]") {
+  MPI_Init(0, nullptr);
+
+  FFT fft(Decomposition(World({8, 4, 2})));
+  std::vector<double> in(fft.size_inbox());
+  for (size_t i = 0; i < in.size(); i++) in[i] = std::sin(0.1 * i);
+  std::vector<std::complex<double>> in_F(fft.size_outbox()), tmp_F(fft.size_outbox());
+  fft.forward(in, in_F);
+
+  // Reference: separate update loop followed by a normal backward transform
+  std::vector<double> ref(fft.size_inbox()), out(fft.size_inbox());
+  for (size_t k = 0; k < in_F.size(); k++) tmp_F[k] = 0.5 * in_F[k];
+  fft.backward(tmp_F, ref);
+
+  // Kernel values in a scratch buffer, the spectral data is left untouched
+  const std::vector<std::complex<double>> saved_F = in_F;
+  fft.backward(out, [&](size_t k) { return 0.5 * in_F[k]; });
+  for (size_t i = 0; i < out.size(); i++) {
+    REQUIRE_THAT(out[i], WithinAbs(ref[i], 1.0e-12));
+  }
+  REQUIRE(in_F == saved_F);
+
+  // Kernel values written in place to the spectral data the kernel reads
+  std::fill(out.begin(), out.end(), 0.0);
+  fft.backward(out, [&](size_t k) { return 0.5 * in_F[k]; }, in_F);
+  for (size_t i = 0; i < out.size(); i++) {
+    REQUIRE_THAT(out[i], WithinAbs(ref[i], 1.0e-12));
+  }
+  MPI_Finalize();
+}
+
+TEST_CASE("FFT in single and mixed precision", "[FFT]") {
+  MPI_Init(0, nullptr);
+
+  Decomposition decomp(World({8, 4, 2}));
+  FFT fft(decomp);
+  FFTf fft_sp(decomp);
+  std::vector<double> in(fft.size_inbox());
+  for (size_t i = 0; i < in.size(); i++) in[i] = std::sin(0.1 * i);
+
+  {
+    // Single precision data
+    std::vector<float> in_sp(in.begin(), in.end()), out_sp(fft_sp.size_inbox());
+    std::vector<std::complex<float>> in_sp_F(fft_sp.size_outbox());
+    fft_sp.forward(in_sp, in_sp_F);
+    fft_sp.backward(in_sp_F, out_sp);
+    for (size_t i = 0; i < in.size(); i++) REQUIRE_THAT(out_sp[i], WithinAbs(in_sp[i], 1.0e-5));
+  }
+
+  {
+    // Double precision data transformed in single precision
+    std::vector<std::complex<double>> ref_F(fft.size_outbox()), in_F(fft.size_outbox());
+    fft.forward(in, ref_F);
+    fft_sp.forward(in, in_F);
+    for (size_t k = 0; k < in_F.size(); k++) REQUIRE_THAT(std::abs(in_F[k] - ref_F[k]), WithinAbs(0.0, 1.0e-5));
+    std::vector<double> out(fft.size_inbox());
+    fft_sp.backward(out, [&](size_t k) { return 2.0 * ref_F[k]; });
+    for (size_t i = 0; i < in.size(); i++) REQUIRE_THAT(out[i], WithinAbs(2.0 * in[i], 1.0e-5));
+  }
+
+  MPI_Finalize();
+}
@@ -0,0 +1,69 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <openpfc/fft_autotune.hpp>
+
+using namespace pfc;
+
+TEST_CASE("FFT autotune candidates", "[FFTAutotuner]") {
+  auto candidates = FFTAutotuner::get_candidates();
+  REQUIRE(candidates.size() == 16);
+  // pencil reshapes are turned off for slab decompositions anyway
+  auto slab_candidates = FFTAutotuner::get_candidates(true);
+  REQUIRE(slab_candidates.size() == 8);
+  for (const auto &candidate : slab_candidates) REQUIRE_FALSE(candidate.use_pencils);
+  for (const auto &candidate : candidates) {
+    auto name = FFTAutotuner::algorithm_to_string(candidate.algorithm);
+    REQUIRE(FFTAutotuner::algorithm_from_string(name) == candidate.algorithm);
+  }
+  REQUIRE_THROWS_AS(FFTAutotuner::algorithm_from_string("carrier_pigeon"), std::invalid_argument);
+}
+
+TEST_CASE("FFT autotune with cache file", "[FFTAutotuner]") {
+  MPI_Init(0, nullptr);
+
+  std::string cache_file = (std::filesystem::temp_directory_path() / "openpfc_test_fft_autotune.txt").string();
+  std::remove(cache_file.c_str());
+
+  Decomposition decomp(World({8, 4, 2}));
+  FFTAutotuner tuner(decomp);
+  tuner.set_cache_file(cache_file);
+  tuner.set_repetitions(1);
+  tuner.set_verbose(false);
+  REQUIRE(tuner.get_key() == "8 4 2 1 1 1 1 0 0 fftw double");
+  REQUIRE(FFTAutotunerf(decomp).get_key() == "8 4 2 1 1 1 1 0 0 fftw float");
+  REQUIRE_THROWS_AS(tuner.set_repetitions(0), std::invalid_argument);
+
+  // First call times all candidates and writes the winner to the cache
+  heffte::plan_options best = tuner.tune();
+  {
+    std::ifstream file(cache_file);
+    std::string line;
+    REQUIRE(std::getline(file, line));
+    REQUIRE(line.rfind(tuner.get_key() + " " + FFTAutotuner::algorithm_to_string(best.algorithm), 0) == 0);
+  }
+
+  // Second call must read the result from the cache instead
+  {
+    std::ofstream file(cache_file, std::ios::app);
+    file << tuner.get_key() << " p2p_plined 0 0 0.0\n";
+  }
+  heffte::plan_options cached = tuner.tune();
+  REQUIRE(cached.algorithm == heffte::reshape_algorithm::p2p_plined);
+  REQUIRE(cached.use_pencils == false);
+  REQUIRE(cached.use_reorder == false);
+
+  // a different backend is a different setup
+  tuner.set_backend(FFTBackend::stock);
+  REQUIRE(tuner.get_key() == "8 4 2 1 1 1 1 0 0 stock double");
+
+  // nothing to tune for the native backend, base options are returned as is
+  tuner.set_backend(FFTBackend::native);
+  heffte::plan_options base = heffte::default_options<heffte::backend::fftw>();
+  base.algorithm = heffte::reshape_algorithm::alltoall;
+  REQUIRE(tuner.tune(base).algorithm == heffte::reshape_algorithm::alltoall);
+
+  std::remove(cache_file.c_str());
+  MPI_Finalize();
+}
@@ -0,0 +1,44 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <openpfc/fft.hpp>
+#include <openpfc/fftw_wisdom.hpp>
+
+using namespace pfc;
+
+TEST_CASE("FFTW wisdom export and import", "[fftw_wisdom]") {
+  MPI_Init(0, nullptr);
+
+  std::string filename = (std::filesystem::temp_directory_path() / "openpfc_test_wisdom.fftw").string();
+  std::remove(filename.c_str());
+
+  // Missing file is not an error, just nothing to import
+  REQUIRE_FALSE(fftw_wisdom::import_wisdom(filename));
+
+  FFT fft(Decomposition(World({8, 4, 2})));
+  FFTf fftf(Decomposition(World({8, 4, 2})));
+  REQUIRE(fftw_wisdom::export_wisdom(filename));
+  REQUIRE(std::filesystem::file_size(filename) > 0);
+
+  // the file holds the wisdom of both precisions
+  std::ifstream file(filename);
+  std::ostringstream content;
+  content << file.rdbuf();
+  REQUIRE(content.str().find("fftw_wisdom") != std::string::npos);
+  REQUIRE(content.str().find("fftwf_wisdom") != std::string::npos);
+  REQUIRE(fftw_wisdom::import_wisdom(filename));
+
+  // wisdom of one precision is rejected by the other one
+  REQUIRE(fftw_wisdom::import_from_string<double>(fftw_wisdom::export_to_string<double>()));
+  REQUIRE(fftw_wisdom::import_from_string<float>(fftw_wisdom::export_to_string<float>()));
+  REQUIRE_FALSE(fftw_wisdom::import_from_string<float>(fftw_wisdom::export_to_string<double>()));
+
+  // a file without any wisdom is an error
+  std::ofstream(filename) << "not wisdom";
+  REQUIRE_FALSE(fftw_wisdom::import_wisdom(filename));
+
+  std::remove(filename.c_str());
+  MPI_Finalize();
+}
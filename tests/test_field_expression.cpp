@@ -0,0 +1,62 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <cmath>
+#include <complex>
+#include <openpfc/field_expression.hpp>
+#include <stdexcept>
+#include <vector>
+
+using namespace pfc;
+using namespace Catch::Matchers;
+
+TEST_CASE("Field expressions", "[field_expression]") {
+  const size_t n = 100;
+  std::vector<double> psi(n), psiMF(n), psiN(n);
+  for (size_t i = 0; i < n; i++) {
+    psi[i] = 0.01 * i - 0.5;
+    psiMF[i] = std::sin(0.1 * i);
+  }
+
+  SECTION("Polynomial nonlinearity in one sweep") {
+    const double p3 = -0.5, p4 = 0.3, q3 = 0.2, q4 = -0.1, stabP = 0.25;
+    auto u = expr::ref(psi), v = expr::ref(psiMF);
+    expr::assign(psiN, p3 * u * u + p4 * u * u * u + q3 * v * v + q4 * v * v * v - stabP * u);
+    for (size_t i = 0; i < n; i++) {
+      double a = psi[i], b = psiMF[i];
+      double expected = p3 * a * a + p4 * a * a * a + q3 * b * b + q4 * b * b * b - stabP * a;
+      REQUIRE_THAT(psiN[i], WithinAbs(expected, 1e-14));
+    }
+  }
+
+  SECTION("Scalars on both sides, division, negation and map") {
+    auto u = expr::ref(psi), v = expr::ref(psiMF);
+    expr::assign(psiN, -(2.0 - u) / 4 + expr::map([](double x) { return std::exp(x); }, v * 0.5));
+    for (size_t i = 0; i < n; i++) {
+      REQUIRE_THAT(psiN[i], WithinAbs(-(2.0 - psi[i]) / 4 + std::exp(psiMF[i] * 0.5), 1e-14));
+    }
+  }
+
+  SECTION("Output may appear in the expression") {
+    std::vector<double> copy = psi;
+    auto u = expr::ref(psi);
+    expr::assign(psi, u * u - u);
+    for (size_t i = 0; i < n; i++) REQUIRE_THAT(psi[i], WithinAbs(copy[i] * copy[i] - copy[i], 1e-14));
+  }
+
+  SECTION("Complex fields and mixed precision") {
+    std::vector<std::complex<double>> a(n, {1.0, 2.0}), b(n);
+    expr::assign(b, std::complex<double>(0.0, 1.0) * expr::ref(a) + 1.0);
+    REQUIRE(b[7] == std::complex<double>(-1.0, 1.0));
+    std::vector<float> f(n);
+    expr::assign(f, 2.0 * expr::ref(psi));
+    REQUIRE_THAT(f[10], WithinAbs(2.0 * psi[10], 1e-6));
+  }
+
+  SECTION("Sizes must match") {
+    std::vector<double> small(n - 1);
+    REQUIRE_THROWS_AS(expr::ref(psi) + expr::ref(small), std::invalid_argument);
+    REQUIRE_THROWS_AS(expr::assign(small, expr::ref(psi) * 2.0), std::invalid_argument);
+    expr::assign(small, expr::Scalar<double>(3.0));
+    REQUIRE(small[0] == 3.0);
+  }
+}
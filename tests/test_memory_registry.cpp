@@ -0,0 +1,97 @@
+#include <catch2/catch_test_macros.hpp>
+#include <openpfc/memory_registry.hpp>
+#include <openpfc/model.hpp>
+#include <sstream>
+#include <string>
+
+using namespace pfc;
+
+TEST_CASE("Memory registry", "[memory_registry]") {
+  SECTION("Entries are set, updated and removed by category and name") {
+    MemoryRegistry registry;
+    registry.set("fields", "psi", 100);
+    registry.set("fields", "psiMF", 50);
+    registry.set("operators", "opL", 30);
+    registry.set("fields", "psi", 200);
+    REQUIRE(registry.get_entries().size() == 3);
+    REQUIRE(registry.get_bytes("fields", "psi") == 200);
+    REQUIRE(registry.get_total("fields") == 250);
+    REQUIRE(registry.get_total() == 280);
+    registry.remove("fields", "psiMF");
+    registry.remove("fields", "none");
+    REQUIRE(registry.get_total() == 230);
+    REQUIRE(registry.get_bytes("fields", "psiMF") == 0);
+  }
+
+  SECTION("Vectors are registered with their capacity") {
+    MemoryRegistry registry;
+    RealField psi;
+    psi.reserve(10);
+    registry.set("fields", "psi", psi);
+    REQUIRE(registry.get_bytes("fields", "psi") == 10 * sizeof(double));
+  }
+
+  SECTION("Field allocations are counted") {
+    const size_t before = memory::get_allocated_bytes();
+    {
+      RealField psi(1000);
+      REQUIRE(memory::get_allocated_bytes() == before + 1000 * sizeof(double));
+      REQUIRE(memory::get_peak_allocated_bytes() >= before + 1000 * sizeof(double));
+    }
+    REQUIRE(memory::get_allocated_bytes() == before);
+  }
+
+  SECTION("Resident set size is read from /proc") {
+#if defined(__linux__)
+    REQUIRE(memory::get_rss() > 0);
+    REQUIRE(memory::get_peak_rss() >= memory::get_rss());
+#endif
+  }
+
+  SECTION("Report lists the entries") {
+    MemoryRegistry registry;
+    registry.set("fields", "psi", 3 * 1024 * 1024);
+    std::ostringstream os;
+    registry.print_report(os, MPI_COMM_SELF, "Memory");
+    const std::string report = os.str();
+    REQUIRE(report.find("Memory (MiB per rank)") != std::string::npos);
+    REQUIRE(report.find("fields: psi") != std::string::npos);
+    REQUIRE(report.find("3.0") != std::string::npos);
+    REQUIRE(report.find("resident set size") != std::string::npos);
+  }
+}
+
+namespace {
+class MemoryModel : public Model {
+public:
+  RealField psi;
+  ComplexField psi_F;
+  void step(double) override {}
+  void initialize(double) override {
+    psi.resize(get_fft().size_inbox());
+    psi_F.resize(get_fft().size_outbox());
+    add_real_field("psi", psi);
+    add_real_field("default", psi);
+    add_complex_field("psi_F", psi_F);
+    add_complex_work_array("psiMF_F", 1, 1);
+    add_complex_work_array("psiN_F", 2, 2);
+    allocate_work_arrays();
+  }
+};
+} // namespace
+
+TEST_CASE("Model registers its memory", "[memory_registry]") {
+  World world({8, 8, 1});
+  Decomposition decomp(world, MPI_COMM_SELF);
+  FFT fft(decomp, MPI_COMM_SELF);
+  MemoryModel model;
+  model.set_fft(fft);
+  model.initialize(1.0);
+  MemoryRegistry registry;
+  model.register_memory(registry);
+  fft.register_memory(registry);
+  REQUIRE(registry.get_bytes("fields", "default/psi") == model.psi.capacity() * sizeof(double));
+  REQUIRE(registry.get_bytes("fields", "psi_F") == model.psi_F.capacity() * sizeof(std::complex<double>));
+  REQUIRE(registry.get_bytes("work arrays", "psiMF_F/psiN_F") == fft.size_outbox() * sizeof(std::complex<double>));
+  REQUIRE(registry.get_entries().size() == 4);
+}
@@ -1,5 +1,6 @@
 #include <catch2/catch_test_macros.hpp>
 #include <openpfc/model.hpp>
+#include <stdexcept>
 
 using namespace pfc;
 
@@ -46,6 +47,7 @@ TEST_CASE("Model functionality", "[Model]") {
     // Get the field from the model
     RealField &retrieved_field = model.get_real_field("field1");
     REQUIRE(&retrieved_field == &field);
+    REQUIRE_THROWS_AS(model.get_real_field("field2"), std::invalid_argument);
   }
 
   SECTION("Complex field operations") {
@@ -63,5 +65,6 @@ TEST_CASE("Model functionality", "[Model]") {
     // Get the field from the model
     ComplexField &retrieved_field = model.get_complex_field("field2");
     REQUIRE(&retrieved_field == &field);
+    REQUIRE_THROWS_AS(model.get_complex_field("field1"), std::invalid_argument);
   }
 }
@@ -0,0 +1,93 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <cmath>
+#include <memory>
+#include <openpfc/operator_table.hpp>
+#include <openpfc/operators.hpp>
+#include <stdexcept>
+
+using namespace Catch::Matchers;
+using namespace pfc;
+
+TEST_CASE("Operator tables", "[operator_table]") {
+  const World world({8, 6, 4});
+  Decomposition decomp(world, 0, 1);
+  const auto &size = decomp.get_outbox_size();
+  const size_t n = static_cast<size_t>(size[0]) * size[1] * size[2];
+  const double dt = 1.0e-3, scale = 1.0 / (8 * 6 * 4);
+
+  SECTION("Double storage is exact") {
+    OperatorTable<double, 2> opLN(n);
+    REQUIRE(opLN.size() == n);
+    REQUIRE(opLN.memory_size() == 2 * n * sizeof(double));
+    std::vector<double> opL, opN;
+    fill_operator(decomp, opL, [&](double, double, double, double k2) { return std::exp(-k2 * dt); });
+    fill_operator(decomp, opN, [&](double, double, double, double k2) { return -k2 * dt; });
+    for_each_wavenumber(decomp, [&](size_t idx, double, double, double, double k2) {
+      opLN.set(idx, std::exp(-k2 * dt), -k2 * dt);
+    });
+    for (size_t idx = 0; idx < n; idx++) {
+      REQUIRE(opLN.get<0>(idx) == opL[idx]);
+      REQUIRE(opLN.get<1>(idx) == opN[idx]);
+    }
+  }
+
+  SECTION("Float storage halves the memory and rounds the values once") {
+    OperatorTable<float> filter(n);
+    REQUIRE(filter.memory_size() == n * sizeof(float));
+    for_each_wavenumber(decomp, [&](size_t idx, double, double, double, double k2) {
+      filter.set(idx, scale * std::exp(-k2 / 10.0));
+    });
+    for_each_wavenumber(decomp, [&](size_t idx, double, double, double, double k2) {
+      REQUIRE_THAT(filter[idx], WithinRel(scale * std::exp(-k2 / 10.0), 1e-7));
+    });
+  }
+
+  SECTION("Offset keeps the precision of values close to a constant") {
+    OperatorTable<float, 2> plain(n), shifted(n);
+    shifted.set_offset(0, scale);
+    REQUIRE(shifted.get_offset(0) == scale);
+    REQUIRE(shifted.get_offset(1) == 0.0);
+    double err_plain = 0.0, err_shifted = 0.0;
+    for_each_wavenumber(decomp, [&](size_t idx, double, double, double, double k2) {
+      double L = scale * std::exp(-1.0e-6 * k2 * dt);
+      plain.set(idx, L, 0.0);
+      shifted.set(idx, L, 0.0);
+      // relative error of the decay L - scale, which float storage of L loses
+      if (k2 > 0.0) {
+        err_plain = std::max(err_plain, std::abs((plain.get<0>(idx) - L) / (L - scale)));
+        err_shifted = std::max(err_shifted, std::abs((shifted.get<0>(idx) - L) / (L - scale)));
+      }
+    });
+    REQUIRE(err_shifted < 1e-6);
+    REQUIRE(err_plain > 1e-2);
+    REQUIRE_THROWS_AS(shifted.set_offset(2, 1.0), std::invalid_argument);
+  }
+
+  SECTION("Radial tables store one value per shell of k^2") {
+    auto shells = std::make_shared<const RadialShells>(decomp);
+    REQUIRE(shells->size() == n);
+    REQUIRE(shells->num_shells() < n);
+    for (size_t s = 1; s < shells->num_shells(); s++) REQUIRE(shells->get_k2(s) > shells->get_k2(s - 1));
+
+    RadialOperatorTable<double, 2> radial(shells);
+    RadialOperatorTable<double> filter(shells);
+    REQUIRE(radial.size() == n);
+    REQUIRE(radial.num_shells() == shells->num_shells());
+    REQUIRE(radial.memory_size() == 2 * shells->num_shells() * sizeof(double));
+    for (size_t s = 0; s < radial.num_shells(); s++) {
+      double k2 = radial.get_k2(s);
+      radial.set_shell(s, std::exp(-k2 * dt), -k2 * dt);
+      filter.set_shell(s, std::exp(-k2 / 10.0));
+    }
+    OperatorTable<double, 2> full(n);
+    for_each_wavenumber(decomp, [&](size_t idx, double, double, double, double k2) {
+      full.set(idx, std::exp(-k2 * dt), -k2 * dt);
+      REQUIRE(filter[idx] == std::exp(-k2 / 10.0));
+    });
+    for (size_t idx = 0; idx < n; idx++) {
+      REQUIRE(radial.get<0>(idx) == full.get<0>(idx));
+      REQUIRE(radial.get<1>(idx) == full.get<1>(idx));
+    }
+  }
+}
@@ -0,0 +1,46 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <openpfc/operators.hpp>
+
+using namespace Catch::Matchers;
+using namespace pfc;
+
+TEST_CASE("Operators from wavenumbers", "[operators]") {
+  const World world({8, 6, 4});
+  Decomposition decomp(world, 0, 1);
+  const double pi = std::atan(1.0) * 4.0;
+
+  // Reference: the triple loop over the outbox used in models
+  std::vector<double> ref;
+  const auto &low = decomp.outbox.low, &high = decomp.outbox.high;
+  const double fx = 2.0 * pi / (world.dx * world.Lx);
+  const double fy = 2.0 * pi / (world.dy * world.Ly);
+  const double fz = 2.0 * pi / (world.dz * world.Lz);
+  for (int k = low[2]; k <= high[2]; k++) {
+    for (int j = low[1]; j <= high[1]; j++) {
+      for (int i = low[0]; i <= high[0]; i++) {
+        double ki = (i <= world.Lx / 2) ? i * fx : (i - world.Lx) * fx;
+        double kj = (j <= world.Ly / 2) ? j * fy : (j - world.Ly) * fy;
+        double kk = (k <= world.Lz / 2) ? k * fz : (k - world.Lz) * fz;
+        ref.push_back(-(ki * ki + kj * kj + kk * kk) + 0.1 * ki - 0.2 * kj + 0.3 * kk);
+      }
+    }
+  }
+
+  std::vector<double> op;
+  fill_operator(decomp, op, [](double kx, double ky, double kz, double k2) {
+    return -k2 + 0.1 * kx - 0.2 * ky + 0.3 * kz;
+  });
+  REQUIRE(op.size() == ref.size());
+  for (size_t idx = 0; idx < op.size(); idx++) REQUIRE(op[idx] == ref[idx]);
+
+  // for_each_wavenumber visits every mode exactly once, in memory order
+  size_t count = 0;
+  for_each_wavenumber(decomp, [&](size_t idx, double, double, double, double) { REQUIRE(idx == count++); });
+  REQUIRE(count == ref.size());
+
+  // Operators of other precision
+  std::vector<float> opf;
+  fill_operator(decomp, opf, [](double, double, double, double k2) { return -k2; });
+  REQUIRE_THAT(opf[1], WithinAbs(-fx * fx, 1.0e-5));
+}
@@ -0,0 +1,70 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <cmath>
+#include <openpfc/boundary_conditions/fixed_bc.hpp>
+#include <openpfc/fft.hpp>
+#include <openpfc/initial_conditions/constant.hpp>
+#include <openpfc/model.hpp>
+#include <openpfc/parallel.hpp>
+#include <vector>
+
+using namespace pfc;
+using namespace Catch::Matchers;
+
+TEST_CASE("Parallel for", "[parallel]") {
+  REQUIRE(parallel::get_num_threads() >= 1);
+
+  // every index is visited exactly once
+  std::vector<int> count(1000, 0);
+  parallel_for(count.size(), [&](size_t i) { count[i]++; });
+  for (int c : count) REQUIRE(c == 1);
+
+  std::vector<double> u(1000, 0.0);
+  parallel_for(100, 200, [&](size_t i) { u[i] = static_cast<double>(i); });
+  for (size_t i = 0; i < u.size(); i++) REQUIRE(u[i] == ((i >= 100 && i < 200) ? static_cast<double>(i) : 0.0));
+
+  // empty range does nothing
+  parallel_for(10, 10, [&](size_t i) { u[i] = -1.0; });
+  REQUIRE(u[10] == 0.0);
+}
+
+namespace {
+class EmptyModel : public Model {
+public:
+  std::vector<double> psi;
+  void initialize(double) override {
+    psi.resize(get_fft().size_inbox());
+    add_real_field("default", psi);
+  }
+  void step(double) override {}
+};
+} // namespace
+
+TEST_CASE("Parallel field modifiers", "[parallel]") {
+  MPI_Init(0, nullptr);
+  Decomposition decomp(World({64, 4, 2}));
+  FFT fft(decomp);
+  EmptyModel model;
+  model.set_fft(fft);
+  model.initialize(1.0);
+
+  Constant ic(0.5);
+  ic.apply(model, 0.0);
+  for (double v : model.psi) REQUIRE(v == 0.5);
+
+  // FixedBC sets a profile depending on x only, same on every (y, z) line
+  FixedBC bc(-1.0, 1.0);
+  bc.apply(model, 0.0);
+  const World &w = decomp.get_world();
+  const double xpos = w.Lx * w.dx - 20.0;
+  for (size_t idx = 0; idx < model.psi.size(); idx++) {
+    const double x = w.x0 + static_cast<double>(idx % 64) * w.dx;
+    if (std::abs(x - xpos) < 20.0) {
+      const double S = 1.0 / (1.0 + std::exp(-(x - xpos)));
+      REQUIRE_THAT(model.psi[idx], WithinAbs(-S + (1.0 - S), 1.0e-14));
+    } else {
+      REQUIRE(model.psi[idx] == 0.5);
+    }
+  }
+  MPI_Finalize();
+}
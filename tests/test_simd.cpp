@@ -0,0 +1,45 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <cmath>
+#include <limits>
+#include <openpfc/simd.hpp>
+#include <vector>
+
+using namespace pfc;
+using namespace Catch::Matchers;
+
+TEST_CASE("Vectorizable exp", "[simd]") {
+  REQUIRE(simd::exp(0.0) == 1.0);
+  for (double x = -700.0; x <= 700.0; x += 0.731) {
+    REQUIRE_THAT(simd::exp(x), WithinRel(std::exp(x), 1e-14));
+  }
+
+  // overflow, underflow and subnormal results as with std::exp
+  REQUIRE(simd::exp(710.0) == std::numeric_limits<double>::infinity());
+  REQUIRE(simd::exp(800.0) == std::numeric_limits<double>::infinity());
+  REQUIRE(simd::exp(std::numeric_limits<double>::infinity()) == std::numeric_limits<double>::infinity());
+  REQUIRE(simd::exp(-746.0) == 0.0);
+  REQUIRE(simd::exp(-800.0) == 0.0);
+  REQUIRE(simd::exp(-std::numeric_limits<double>::infinity()) == 0.0);
+  REQUIRE(std::isnan(simd::exp(std::numeric_limits<double>::quiet_NaN())));
+  REQUIRE_THAT(simd::exp(709.5), WithinRel(std::exp(709.5), 1e-14));
+  for (double x = -745.0; x < -708.0; x += 0.37) {
+    REQUIRE_THAT(simd::exp(x), WithinAbs(std::exp(x), 1e-323));
+  }
+
+  // same results inside a SIMD loop with a reduction
+  std::vector<double> x(1001), y(x.size());
+  for (size_t i = 0; i < x.size(); i++) x[i] = -10.0 + 0.02 * i;
+  double sum = 0.0;
+  PFC_SIMD_REDUCTION(+, sum)
+  for (size_t i = 0; i < x.size(); i++) {
+    y[i] = simd::exp(x[i]);
+    sum += y[i];
+  }
+  double expected = 0.0;
+  for (size_t i = 0; i < x.size(); i++) {
+    REQUIRE_THAT(y[i], WithinRel(std::exp(x[i]), 1e-14));
+    expected += std::exp(x[i]);
+  }
+  REQUIRE_THAT(sum, WithinRel(expected, 1e-12));
+}
@@ -1,6 +1,7 @@
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_floating_point.hpp>
 #include <openpfc/time.hpp>
+#include <stdexcept>
 
 using namespace Catch::Matchers;
 using namespace pfc;
@@ -100,3 +101,72 @@ TEST_CASE("Time save condition", "[Time]") {
     REQUIRE(t.do_save());
   }
 }
+
+TEST_CASE("Time variable steps", "[Time]") {
+  std::array<double, 3> time = {0.0, 10.0, 1.0};
+
+  SECTION("Constant time step is not variable") {
+    Time t(time, 2.0);
+    REQUIRE_FALSE(t.is_variable());
+    REQUIRE(t.get_step_dt() == 1.0);
+  }
+
+  SECTION("Non-positive time step throws") {
+    Time t(time, 2.0);
+    REQUIRE_THROWS_AS(t.set_dt(0.0), std::invalid_argument);
+    REQUIRE_THROWS_AS(t.set_dt(-1.0), std::invalid_argument);
+    REQUIRE_FALSE(t.is_variable());
+  }
+
+  SECTION("Current time is kept when switching") {
+    Time t(time, 2.0);
+    t.next();
+    t.next();
+    t.set_dt(0.5);
+    REQUIRE(t.is_variable());
+    REQUIRE_THAT(t.get_current(), WithinAbs(2.0, 1.0e-12));
+    t.next();
+    REQUIRE_THAT(t.get_current(), WithinAbs(2.5, 1.0e-12));
+    REQUIRE(t.get_increment() == 3);
+  }
+
+  SECTION("Steps end exactly at save times") {
+    Time t(time, 2.0);
+    t.set_dt(2.5);
+    REQUIRE(t.get_dt() == 2.5);
+    REQUIRE(t.get_step_dt() == 2.0);
+    t.next();
+    REQUIRE(t.get_current() == 2.0);
+    REQUIRE(t.do_save());
+    t.set_dt(1.0);
+    t.next();
+    REQUIRE_FALSE(t.do_save());
+    t.next();
+    REQUIRE(t.get_current() == 4.0);
+    REQUIRE(t.do_save());
+  }
+
+  SECTION("Steps shortly before a save time are halved") {
+    Time t(time, 2.0);
+    t.set_dt(1.2);
+    REQUIRE_THAT(t.get_step_dt(), WithinAbs(1.0, 1.0e-12));
+    t.next();
+    REQUIRE_FALSE(t.do_save());
+    t.next();
+    REQUIRE_THAT(t.get_current(), WithinAbs(2.0, 1.0e-12));
+    REQUIRE(t.do_save());
+  }
+
+  SECTION("Last step ends exactly at t1") {
+    Time t(time, 20.0);
+    t.set_dt(3.0);
+    int steps = 0;
+    while (!t.done()) {
+      t.next();
+      steps++;
+    }
+    REQUIRE(t.get_current() == 10.0);
+    REQUIRE(t.do_save());
+    REQUIRE(steps == 4);
+  }
+}
@@ -0,0 +1,218 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <memory>
+#include <openpfc/operator_cache.hpp>
+#include <openpfc/simulator.hpp>
+#include <openpfc/time_step_controller.hpp>
+#include <stdexcept>
+#include <vector>
+
+using namespace Catch::Matchers;
+using namespace pfc;
+
+TEST_CASE("Operator cache", "[time_step_controller]") {
+  SECTION("Sets are moved in and out") {
+    OperatorCache<std::vector<double>> cache(2);
+    cache.put(1.0, std::vector<double>(4, 1.0));
+    REQUIRE(cache.size() == 1);
+    REQUIRE(cache.contains(1.0));
+    std::vector<double> ops;
+    REQUIRE_FALSE(cache.take(2.0, ops));
+    REQUIRE(ops.empty());
+    REQUIRE(cache.take(1.0, ops));
+    REQUIRE(ops == std::vector<double>(4, 1.0));
+    REQUIRE(cache.size() == 0);
+  }
+
+  SECTION("Least recently stored set is dropped") {
+    OperatorCache<std::vector<double>> cache(2);
+    cache.put(1.0, std::vector<double>(1, 1.0));
+    cache.put(2.0, std::vector<double>(1, 2.0));
+    cache.put(1.0, std::vector<double>(1, 1.5)); // replaces and refreshes 1.0
+    cache.put(4.0, std::vector<double>(1, 4.0));
+    REQUIRE(cache.size() == 2);
+    REQUIRE_FALSE(cache.contains(2.0));
+    std::vector<double> ops;
+    REQUIRE(cache.take(1.0, ops));
+    REQUIRE(ops[0] == 1.5);
+    cache.set_capacity(0);
+    REQUIRE(cache.size() == 0);
+    cache.put(8.0, std::vector<double>(1, 8.0));
+    REQUIRE_FALSE(cache.contains(8.0));
+  }
+
+  SECTION("Active set is switched and transient sets are not stored") {
+    OperatorCache<std::vector<double>> cache(2);
+    std::vector<double> ops(1, 1.0);
+    int calculations = 0;
+    auto rebuild = [&](double dt) {
+      ops = std::vector<double>(1, dt);
+      calculations++;
+    };
+    cache.set_active_dt(1.0);
+    cache.switch_to(2.0, false, ops, rebuild);
+    cache.switch_to(0.5, true, ops, rebuild);
+    REQUIRE(cache.get_active_dt() == 0.5);
+    REQUIRE(ops[0] == 0.5);
+    cache.switch_to(1.0, false, ops, rebuild);
+    REQUIRE(ops[0] == 1.0);
+    REQUIRE(calculations == 2);
+    REQUIRE(cache.contains(2.0));
+    REQUIRE_FALSE(cache.contains(0.5));
+  }
+
+  SECTION("Memory of the cached sets without the shared tables") {
+    OperatorCache<std::vector<double>> cache(2);
+    cache.put(1.0, std::vector<double>(4, 1.0));
+    cache.put(2.0, std::vector<double>(4, 2.0));
+    MemoryRegistry registry;
+    auto register_set = [](const std::vector<double> &set, MemoryRegistry &tables) {
+      tables.set("operators", "table", set);
+      tables.set("operators", "shells", 100);
+    };
+    cache.register_memory(registry, register_set, "shells");
+    REQUIRE(registry.get_bytes("operators", "cached time steps") == 8 * sizeof(double));
+  }
+}
+
+TEST_CASE("Time step controller", "[time_step_controller]") {
+  SECTION("Invalid arguments") {
+    REQUIRE_THROWS_AS(TimeStepController(1.0, 2.0, 4.0, 0.1), std::invalid_argument);
+    REQUIRE_THROWS_AS(TimeStepController(1.0, 0.0, 4.0, 0.1), std::invalid_argument);
+    REQUIRE_THROWS_AS(TimeStepController(1.0, 0.5, 4.0, 0.0), std::invalid_argument);
+    TimeStepController controller(1.0, 0.5, 4.0, 0.1);
+    REQUIRE_THROWS_AS(controller.set_factor(1.0), std::invalid_argument);
+  }
+
+  SECTION("Large errors decrease the time step down to dt_min") {
+    TimeStepController controller(1.0, 0.2, 4.0, 0.1);
+    REQUIRE(controller.get_dt() == 1.0);
+    REQUIRE(controller.propose(0.2) == 0.5);
+    REQUIRE(controller.propose(0.2) == 0.25);
+    REQUIRE(controller.propose(0.2) == 0.25);
+    REQUIRE(controller.get_level() == -2);
+    REQUIRE(controller.get_last_error() == 0.2);
+  }
+
+  SECTION("Small errors increase the time step after patience steps") {
+    TimeStepController controller(1.0, 0.5, 3.0, 0.1);
+    controller.set_patience(3);
+    REQUIRE(controller.propose(0.01) == 1.0);
+    REQUIRE(controller.propose(0.01) == 1.0);
+    REQUIRE(controller.propose(0.01) == 2.0);
+    // an error close to the tolerance resets the count
+    controller.propose(0.01);
+    controller.propose(0.08);
+    controller.propose(0.01);
+    REQUIRE(controller.propose(0.01) == 2.0);
+    REQUIRE(controller.propose(0.01) == 2.0); // 4.0 is above dt_max
+  }
+
+  SECTION("Levels follow the factor") {
+    TimeStepController controller(0.1, 0.01, 1.0, 0.1);
+    controller.set_factor(3.0);
+    REQUIRE_THAT(controller.get_level_dt(2), WithinRel(0.9, 1.0e-12));
+    REQUIRE_THAT(controller.get_level_dt(-2), WithinRel(0.1 / 9.0, 1.0e-12));
+  }
+}
+
+namespace {
+class VariableStepModel : public Model {
+public:
+  std::vector<double> dts;
+  void step(double) override {}
+  void initialize(double) override {}
+  void set_dt(double dt) override { dts.push_back(dt); }
+};
+
+// keeps one operator "set" per time step in an OperatorCache, like the apps
+class CachingModel : public Model {
+public:
+  OperatorCache<std::vector<double>> cache;
+  std::vector<double> ops{0.3};
+  int set_dt_calls = 0, transient_calls = 0, calculations = 0;
+  CachingModel() { cache.set_active_dt(0.3); }
+  void step(double) override {}
+  void initialize(double) override {}
+  void set_dt(double dt) override {
+    set_dt_calls++;
+    REQUIRE(dt == 0.3);
+    switch_operators(dt, false);
+  }
+  void set_transient_dt(double dt) override {
+    transient_calls++;
+    switch_operators(dt, true);
+  }
+  void switch_operators(double dt, bool transient) {
+    cache.switch_to(dt, transient, ops, [this](double dt) {
+      ops = std::vector<double>{dt};
+      calculations++;
+    });
+  }
+};
+} // namespace
+
+TEST_CASE("Simulator with variable time steps", "[time_step_controller]") {
+  SECTION("Model is told every change of the step size") {
+    Time time({0.0, 3.0, 1.0}, 3.0);
+    VariableStepModel model;
+    Simulator simulator(model, time);
+    simulator.advance_time();
+    REQUIRE(model.dts.empty());
+    time.set_dt(0.5);
+    simulator.advance_time();
+    simulator.advance_time();
+    time.set_dt(2.0);
+    simulator.advance_time(); // clipped to end at t1
+    REQUIRE(model.dts == std::vector<double>{0.5, 1.0});
+    REQUIRE(time.get_current() == 3.0);
+    REQUIRE(time.done());
+  }
+
+  SECTION("Controller adapts the time step") {
+    Time time({0.0, 8.0, 1.0}, 8.0);
+    VariableStepModel model;
+    Simulator simulator(model, time);
+    auto controller = std::make_unique<TimeStepController>(1.0, 0.25, 2.0, 0.1);
+    controller->set_patience(1);
+    controller->set_criterion([](Model &) { return 0.01; });
+    simulator.set_time_step_controller(std::move(controller));
+    while (!simulator.done()) simulator.step();
+    REQUIRE(time.is_variable());
+    REQUIRE(time.get_dt() == 2.0);
+    REQUIRE(time.get_current() == 8.0);
+    // 1 -> 3 -> 5, then the remaining 3 is split in two halves
+    REQUIRE(model.dts == std::vector<double>{2.0, 1.5});
+    REQUIRE(time.get_increment() == 5);
+  }
+
+  SECTION("Steps shortened to end at save times are not cached") {
+    Time time({0.0, 10.0, 0.3}, 1.0);
+    CachingModel model;
+    Simulator simulator(model, time);
+    time.set_dt(0.3);
+    while (!time.done()) simulator.advance_time();
+    // every save interval is 0.3 + 0.3 + 0.2 + 0.2, the two halves have the
+    // same size, and the model returns to 0.3 in the next interval
+    REQUIRE(time.get_increment() == 40);
+    REQUIRE(time.get_current() == 10.0);
+    REQUIRE(model.transient_calls == 10);
+    REQUIRE(model.set_dt_calls == 9);
+    REQUIRE(model.calculations == 10);
+    REQUIRE(model.cache.size() == 1);
+    REQUIRE(model.cache.contains(0.3));
+  }
+
+  SECTION("Controller does not change a constant time step") {
+    Time time({0.0, 4.0, 1.0}, 4.0);
+    VariableStepModel model;
+    Simulator simulator(model, time);
+    auto controller = std::make_unique<TimeStepController>(1.0, 0.5, 1.0, 0.1);
+    controller->set_criterion([](Model &) { return 0.05; });
+    simulator.set_time_step_controller(std::move(controller));
+    while (!simulator.done()) simulator.step();
+    REQUIRE_FALSE(time.is_variable());
+    REQUIRE(model.dts.empty());
+    REQUIRE(time.get_increment() == 4);
+  }
+}
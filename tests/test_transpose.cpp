@@ -0,0 +1,81 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <complex>
+#include <openpfc/fft.hpp>
+#include <openpfc/transpose.hpp>
+#include <vector>
+
+using namespace Catch::Matchers;
+using namespace pfc;
+
+TEST_CASE("Transpose methods", "[Transpose]") {
+  REQUIRE(transpose_method_from_string("alltoallw") == TransposeMethod::alltoallw);
+  REQUIRE(transpose_method_from_string(to_string(TransposeMethod::neighbor)) == TransposeMethod::neighbor);
+  REQUIRE_THROWS_AS(transpose_method_from_string("alltoallv"), std::invalid_argument);
+}
+
+TEST_CASE("Transpose between boxes", "[Transpose]") {
+  MPI_Init(0, nullptr);
+
+  // on a single rank, the output box is a part of the input box
+  const heffte::box3d<int> world({0, 0, 0}, {7, 3, 1});
+  const heffte::box3d<int> part({2, 1, 0}, {5, 2, 1});
+  REQUIRE(Transpose<double>::is_identity({world}, {world}));
+  REQUIRE_FALSE(Transpose<double>::is_identity({world}, {part}));
+  REQUIRE_THROWS_AS(Transpose<double>({world, world}, {world, world}, MPI_COMM_WORLD), std::invalid_argument);
+
+  for (auto method : {TransposeMethod::alltoallw, TransposeMethod::neighbor}) {
+    for (bool float_on_wire : {false, true}) {
+      Transpose<std::complex<double>> transpose({world}, {part}, MPI_COMM_WORLD, {method, float_on_wire});
+      REQUIRE(transpose.size_in() == 64);
+      REQUIRE(transpose.size_out() == 16);
+      REQUIRE(transpose.get_num_send_ranks() == 1);
+      REQUIRE(transpose.get_send_bytes() == 0); // nothing leaves this rank
+      REQUIRE(transpose.is_reduced_precision() == float_on_wire);
+
+      // batch of two fields, value encodes the field and the global index
+      std::vector<std::complex<double>> in(2 * 64), out(2 * 16);
+      for (size_t i = 0; i < in.size(); i++) in[i] = {static_cast<double>(i), 1.0 / 3.0};
+      transpose.execute(2, in.data(), out.data());
+      const double tol = float_on_wire ? 1.0e-6 : 0.0;
+      size_t idx = 0;
+      for (int f = 0; f < 2; f++) {
+        for (int k = 0; k <= 1; k++) {
+          for (int j = 1; j <= 2; j++) {
+            for (int i = 2; i <= 5; i++) {
+              const auto &expected = in[f * 64 + i + 8 * j + 32 * k];
+              REQUIRE_THAT(std::real(out[idx]), WithinAbs(std::real(expected), tol));
+              REQUIRE_THAT(std::imag(out[idx]), WithinAbs(std::imag(expected), tol));
+              idx++;
+            }
+          }
+        }
+      }
+    }
+  }
+  MPI_Finalize();
+}
+
+TEST_CASE("FFT with native transposes", "[Transpose]") {
+  MPI_Init(0, nullptr);
+
+  if (is_enabled(FFTBackend::native)) {
+    for (bool transposed : {false, true}) {
+      Decomposition decomp(World({8, 6, 4}), MPI_COMM_WORLD, {0, 0, 0}, 1, transposed);
+      FFT fft(decomp);
+      FFT native(decomp, MPI_COMM_WORLD, heffte::default_options<heffte::backend::fftw>(), FFTBackend::native,
+                 {TransposeMethod::neighbor, true});
+      std::vector<double> u(fft.size_inbox()), v(fft.size_inbox());
+      for (size_t i = 0; i < u.size(); i++) u[i] = std::cos(0.2 * i);
+      std::vector<std::complex<double>> ref(fft.size_outbox()), res(native.size_outbox());
+      fft.forward(u, ref);
+      native.forward(u, res);
+      REQUIRE(res.size() == ref.size());
+      // single precision on the wire
+      for (size_t k = 0; k < res.size(); k++) REQUIRE_THAT(std::abs(res[k] - ref[k]), WithinAbs(0.0, 1.0e-4));
+      native.backward(res, v);
+      for (size_t i = 0; i < u.size(); i++) REQUIRE_THAT(v[i], WithinAbs(u[i], 1.0e-5));
+    }
+  }
+  MPI_Finalize();
+}
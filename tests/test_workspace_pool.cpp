@@ -0,0 +1,62 @@
+#include <catch2/catch_test_macros.hpp>
+#include <complex>
+#include <cstdint>
+#include <openpfc/fft.hpp>
+#include <openpfc/workspace_pool.hpp>
+
+using namespace pfc;
+
+TEST_CASE("Workspace pool", "[WorkspacePool]") {
+  WorkspacePool pool;
+  REQUIRE(pool.get_capacity() == 0);
+
+  {
+    auto a = pool.borrow<double>(100);
+    REQUIRE(a.size() == 100);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(a.data()) % 64 == 0);
+    REQUIRE(pool.get_capacity() >= 100 * sizeof(double));
+    // nested borrow that does not fit gets a separate allocation
+    auto b = pool.borrow<std::complex<double>>(1000);
+    REQUIRE(b.size() == 1000);
+    REQUIRE(pool.get_used() >= 100 * sizeof(double) + 1000 * sizeof(std::complex<double>));
+    REQUIRE_THROWS_AS(pool.release_memory(), std::logic_error);
+  }
+  REQUIRE(pool.get_used() == 0);
+  const size_t peak = pool.get_peak();
+  REQUIRE(peak >= 100 * sizeof(double) + 1000 * sizeof(std::complex<double>));
+
+  // next time the arena is grown to the peak, and both leases fit in it
+  {
+    auto a = pool.borrow<double>(100);
+    auto b = pool.borrow<std::complex<double>>(1000);
+    REQUIRE(pool.get_capacity() == peak);
+    REQUIRE(reinterpret_cast<char *>(b.data()) > reinterpret_cast<char *>(a.data()));
+    // memory released from the top is reused by the next borrow
+    void *top = b.data();
+    b.release();
+    auto c = pool.borrow<float>(10);
+    REQUIRE(static_cast<void *>(c.data()) == top);
+  }
+  REQUIRE(pool.get_peak() == peak);
+  pool.release_memory();
+  REQUIRE(pool.get_capacity() == 0);
+}
+
+TEST_CASE("FFT objects share workspace pool", "[WorkspacePool]") {
+  MPI_Init(0, nullptr);
+
+  WorkspacePool pool;
+  Decomposition decomp(World({16, 8, 4}));
+  FFT fft1(decomp), fft2(decomp);
+  fft1.set_workspace_pool(pool);
+  fft2.set_workspace_pool(pool);
+  std::vector<double> u(fft1.size_inbox(), 1.0);
+  std::vector<std::complex<double>> U(fft1.size_outbox());
+  fft1.forward(u, U);
+  fft2.forward(u, U);
+  fft1.backward(U, u);
+  REQUIRE(pool.get_peak() >= fft1.size_workspace() * sizeof(std::complex<double>));
+  REQUIRE(pool.get_peak() < 2 * fft1.size_workspace() * sizeof(std::complex<double>) + 64);
+  REQUIRE(pool.get_used() == 0);
+  MPI_Finalize();
+}